@@ -0,0 +1,371 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// Benchmark.cpp                                                             //
+// ========================================================================= //
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <univer_audio/UAudioEngine.h>
+#include <UAdpcmCodec.h>
+#include <UConvolutionReverb.h>
+#include <UConvolver.h>
+#include <UFaderBank.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Written by benchmarks whose results are otherwise unused, so the timed
+// loops are not optimized away.
+static volatile float benchmarkSink = 0.f;
+
+static double nanosecondsPer( const Clock::duration elapsed, const size_t count )
+{
+	return double( std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count() ) / double( count );
+}
+
+static void benchmarkPlaySounds( univer::audio::UAudioEngine& audioEngine, const int soundId )
+{
+	constexpr int FRAMES = 1000;
+	constexpr int VOICES_PER_FRAME = 32;
+
+	std::vector< univer::audio::UPlayRequest > requests( VOICES_PER_FRAME );
+	for ( int i = 0; i < VOICES_PER_FRAME; ++i )
+	{
+		requests[i] = { soundId, { float( i ), 0, 0 }, 0.0f };
+	}
+
+	// The two paths swap order every frame, whichever runs first after an
+	// update is otherwise favoured.
+	Clock::duration single{};
+	Clock::duration batch{};
+	for ( int frame = 0; frame < FRAMES; ++frame )
+	{
+		for ( int pass = 0; pass < 2; ++pass )
+		{
+			const bool isBatch = ( pass ^ ( frame & 1 ) ) != 0;
+			const auto start = Clock::now();
+			if ( isBatch )
+			{
+				audioEngine.playSounds( requests );
+				batch += Clock::now() - start;
+			}
+			else
+			{
+				for ( const auto& request : requests )
+				{
+					audioEngine.playSound( request.soundId, request.position, request.volumedB );
+				}
+				single += Clock::now() - start;
+			}
+			audioEngine.stopAllChannels();
+			audioEngine.update( 0.f );
+		}
+	}
+
+	const size_t voices = size_t( FRAMES ) * VOICES_PER_FRAME;
+	std::cout << "playSound  : " << nanosecondsPer( single, voices ) << " ns/voice" << std::endl;
+	std::cout << "playSounds : " << nanosecondsPer( batch, voices ) << " ns/voice" << std::endl;
+}
+
+static void benchmarkVirtualLoops( univer::audio::UAudioEngine& audioEngine, const int loopId )
+{
+	constexpr int EMITTERS = 10000;
+	constexpr int FRAMES = 100;
+
+	// Emitters spread over a 2km square, only a handful near the listener.
+	for ( int i = 0; i < EMITTERS; ++i )
+	{
+		float position[3] = { float( ( i % 100 ) * 20 - 1000 ), 0, float( ( i / 100 ) * 20 - 1000 ) };
+		audioEngine.playSound( loopId, position );
+	}
+	audioEngine.update( 0.f );
+
+	auto start = Clock::now();
+	for ( int frame = 0; frame < FRAMES; ++frame )
+	{
+		audioEngine.update( 1.f / 60.f );
+	}
+	const auto elapsed = Clock::now() - start;
+	std::cout << "update with " << EMITTERS << " loops : " << nanosecondsPer( elapsed, FRAMES ) / 1000.0 << " us/frame" << std::endl;
+
+	audioEngine.stopAllChannels();
+	audioEngine.update( 0.f );
+}
+
+static void benchmarkFaderBank( const int fades, const bool allowSimd )
+{
+	constexpr int FRAMES = 1000;
+
+	univer::audio::UFaderBank bank;
+	Clock::duration elapsed{};
+	for ( int frame = 0; frame < FRAMES; ++frame )
+	{
+		// Long fades so the bank stays full, restarted now and then to keep
+		// the slots shuffling like in a real session.
+		if ( frame % 100 == 0 )
+		{
+			for ( int i = 0; i < fades; ++i )
+			{
+				bank.start( i, 1.f, 0.f, 10.f + float( i % 7 ) );
+			}
+		}
+		const auto start = Clock::now();
+		bank.update( 1.f / 60.f, allowSimd );
+		elapsed += Clock::now() - start;
+	}
+	std::cout << "fader bank " << ( allowSimd ? "simd  " : "scalar" ) << " " << fades << " fades : "
+		<< nanosecondsPer( elapsed, size_t( FRAMES ) * fades ) << " ns/fade" << std::endl;
+}
+
+static void benchmarkDecibels( univer::audio::UAudioEngine& audioEngine )
+{
+	constexpr int VALUES = 4096;
+	constexpr int FRAMES = 1000;
+
+	std::vector< float > decibels( VALUES );
+	std::vector< float > volumes( VALUES );
+	for ( int i = 0; i < VALUES; ++i )
+	{
+		decibels[i] = -96.f + 108.f * float( i ) / float( VALUES );
+	}
+
+	auto start = Clock::now();
+	for ( int frame = 0; frame < FRAMES; ++frame )
+	{
+		for ( int i = 0; i < VALUES; ++i )
+		{
+			volumes[i] = std::pow( 10.0f, 0.05f * decibels[i] );
+		}
+	}
+	const auto reference = Clock::now() - start;
+
+	start = Clock::now();
+	for ( int frame = 0; frame < FRAMES; ++frame )
+	{
+		audioEngine.dBToVolume( decibels, volumes );
+	}
+	const auto batch = Clock::now() - start;
+
+	start = Clock::now();
+	for ( int frame = 0; frame < FRAMES; ++frame )
+	{
+		audioEngine.volumeTodB( volumes, decibels );
+	}
+	const auto inverse = Clock::now() - start;
+
+	const size_t values = size_t( FRAMES ) * VALUES;
+	std::cout << "std::pow dB to volume : " << nanosecondsPer( reference, values ) << " ns/value" << std::endl;
+	std::cout << "batch dB to volume    : " << nanosecondsPer( batch, values ) << " ns/value" << std::endl;
+	std::cout << "batch volume to dB    : " << nanosecondsPer( inverse, values ) << " ns/value" << std::endl;
+}
+
+static void benchmarkConvolution( const float impulseSeconds )
+{
+	constexpr int SAMPLE_RATE = 48000;
+	constexpr int SECONDS = 5;
+	constexpr size_t MIXER_BLOCK = 1024;
+
+	std::vector< float > impulse( size_t( impulseSeconds * SAMPLE_RATE ) );
+	for ( size_t i = 0; i < impulse.size(); ++i )
+	{
+		impulse[i] = std::exp( -6.f * float( i ) / float( impulse.size() ) ) * ( float( ( i * 7919 ) % 2001 ) / 1000.f - 1.f );
+	}
+	std::vector< float > input( MIXER_BLOCK );
+	std::vector< float > output( MIXER_BLOCK );
+	for ( size_t i = 0; i < input.size(); ++i )
+	{
+		input[i] = float( ( i * 104729 ) % 2001 ) / 1000.f - 1.f;
+	}
+
+	univer::audio::UConvolver convolver(
+		std::make_shared< univer::audio::UConvolutionKernel >( impulse, univer::audio::UConvolutionReverb::BLOCK_SIZE ) );
+	const size_t blocks = size_t( SECONDS ) * SAMPLE_RATE / MIXER_BLOCK;
+	const auto start = Clock::now();
+	for ( size_t block = 0; block < blocks; ++block )
+	{
+		convolver.process( input.data(), output.data(), MIXER_BLOCK );
+	}
+	const auto elapsed = Clock::now() - start;
+	const double audioSeconds = double( blocks * MIXER_BLOCK ) / SAMPLE_RATE;
+	std::cout << "convolution " << impulseSeconds << "s IR : "
+		<< nanosecondsPer( elapsed, 1 ) / 1.0e6 / audioSeconds << " ms CPU per second of mono audio" << std::endl;
+}
+
+static void benchmarkDirectConvolution( const float impulseSeconds )
+{
+	constexpr int SAMPLE_RATE = 48000;
+	constexpr size_t SAMPLES = 4800;
+
+	std::vector< float > impulse( size_t( impulseSeconds * SAMPLE_RATE ), 0.5f );
+	std::vector< float > input( impulse.size() + SAMPLES, 0.25f );
+	std::vector< float > output( SAMPLES );
+	const auto start = Clock::now();
+	for ( size_t n = 0; n < SAMPLES; ++n )
+	{
+		float sum = 0.f;
+		for ( size_t k = 0; k < impulse.size(); ++k )
+		{
+			sum += impulse[k] * input[n + impulse.size() - k];
+		}
+		output[n] = sum;
+	}
+	const auto elapsed = Clock::now() - start;
+	benchmarkSink = output[SAMPLES - 1];
+	std::cout << "direct convolution " << impulseSeconds << "s IR : "
+		<< nanosecondsPer( elapsed, 1 ) / 1.0e6 / ( double( SAMPLES ) / SAMPLE_RATE ) << " ms CPU per second of mono audio" << std::endl;
+}
+
+static std::vector< uint8_t > encodeTestSignal( const int channels, const int seconds )
+{
+	constexpr int SAMPLE_RATE = 48000;
+	std::vector< int16_t > samples( size_t( SAMPLE_RATE ) * seconds * channels );
+	for ( size_t i = 0; i < samples.size(); ++i )
+	{
+		const float t = float( i / size_t( channels ) );
+		samples[i] = int16_t( 9000.f * std::sin( t * 0.031f ) + 6000.f * std::sin( t * 0.0071f ) * std::sin( t * 0.4f ) +
+							  float( ( i * 7919 ) % 1001 ) - 500.f );
+	}
+	return univer::audio::UAdpcmCodec::encode( samples, channels, SAMPLE_RATE );
+}
+
+static void benchmarkAdpcmDecode( const std::vector< uint8_t >& encoded, const bool allowSimd )
+{
+	using univer::audio::UAdpcmCodec;
+	constexpr int PASSES = 20;
+
+	UAdpcmCodec::Header header;
+	UAdpcmCodec::readHeader( encoded.data(), encoded.size(), header );
+	const size_t blockBytes = UAdpcmCodec::getBlockBytes( header.channels );
+	const size_t blocks = ( encoded.size() - UAdpcmCodec::HEADER_BYTES ) / blockBytes;
+	std::vector< int16_t > decoded( UAdpcmCodec::BLOCK_FRAMES * size_t( header.channels ) );
+	const auto start = Clock::now();
+	for ( int pass = 0; pass < PASSES; ++pass )
+	{
+		for ( size_t block = 0; block < blocks; ++block )
+		{
+			UAdpcmCodec::decodeBlock( encoded.data() + UAdpcmCodec::HEADER_BYTES + block * blockBytes,
+									  header.channels,
+									  decoded.data(),
+									  allowSimd );
+		}
+		benchmarkSink = benchmarkSink + decoded[0];
+	}
+	const auto elapsed = Clock::now() - start;
+	const size_t frames = size_t( PASSES ) * blocks * UAdpcmCodec::BLOCK_FRAMES;
+	const double audioSeconds = double( frames ) / header.sampleRate;
+	std::cout << "adpcm decode " << ( allowSimd ? "simd  " : "scalar" ) << " " << header.channels << "ch : "
+		<< nanosecondsPer( elapsed, frames ) << " ns/frame, "
+		<< audioSeconds / ( nanosecondsPer( elapsed, 1 ) / 1.0e9 ) << "x realtime" << std::endl;
+}
+
+// Decodes the whole file through FMOD, codecs included, like a stream would.
+static void benchmarkSoundDecode( FMOD::System* system, const std::string& path )
+{
+	constexpr int PASSES = 20;
+
+	FMOD::Sound* sound = nullptr;
+	if ( system->createSound( path.c_str(), FMOD_OPENONLY, nullptr, &sound ) != FMOD_OK )
+	{
+		std::cout << path << " : not found" << std::endl;
+		return;
+	}
+	int channels = 0;
+	int bits = 0;
+	float frequency = 0.f;
+	sound->getFormat( nullptr, nullptr, &channels, &bits );
+	sound->getDefaults( &frequency, nullptr );
+	std::vector< char > buffer( 16384 );
+	size_t bytes = 0;
+	const auto start = Clock::now();
+	for ( int pass = 0; pass < PASSES; ++pass )
+	{
+		unsigned int read = 0;
+		sound->seekData( 0 );
+		while ( sound->readData( buffer.data(), unsigned( buffer.size() ), &read ) == FMOD_OK && read > 0 )
+		{
+			bytes += read;
+		}
+		bytes += read;
+	}
+	const auto elapsed = Clock::now() - start;
+	sound->release();
+	const size_t frames = bytes / size_t( std::max( channels * bits / 8, 1 ) );
+	std::cout << "FMOD decode " << path << " : " << nanosecondsPer( elapsed, frames ) << " ns/frame, "
+		<< ( double( frames ) / frequency ) / ( nanosecondsPer( elapsed, 1 ) / 1.0e9 ) << "x realtime" << std::endl;
+}
+
+int main()
+{
+	univer::audio::UAudioEngine audioEngine;
+	audioEngine.init();
+
+	float position[3] = { 0, 0, 0 };
+	float look[3] = { 0, 0, 1 };
+	float up[3] = { 0, 1, 0 };
+	audioEngine.set3dListenerAndOrientation( position, look, up );
+
+	int barkId = audioEngine.registerSound( "assets/deepbark.wav",
+											0.f,
+											1.f,
+											100.f,
+											true,
+											false,
+											false,
+											true );
+
+	int loopId = audioEngine.registerSound( "assets/deepbark.wav",
+											0.f,
+											1.f,
+											50.f,
+											true,
+											true,
+											false,
+											true );
+
+	benchmarkPlaySounds( audioEngine, barkId );
+	benchmarkVirtualLoops( audioEngine, loopId );
+
+	for ( const int fades : { 1000, 10000 } )
+	{
+		benchmarkFaderBank( fades, false );
+		benchmarkFaderBank( fades, true );
+	}
+
+	benchmarkDecibels( audioEngine );
+
+	benchmarkDirectConvolution( 0.5f );
+	for ( const float impulseSeconds : { 0.5f, 1.f, 2.f, 4.f } )
+	{
+		benchmarkConvolution( impulseSeconds );
+	}
+
+	for ( const int channels : { 1, 2 } )
+	{
+		const std::vector< uint8_t > encoded = encodeTestSignal( channels, 10 );
+		benchmarkAdpcmDecode( encoded, false );
+		benchmarkAdpcmDecode( encoded, true );
+	}
+
+	// Through FMOD, codec plugin included, next to reading the PCM source.
+	audioEngine.encodeSound( "assets/deepbark.wav", "deepbark.uad" );
+	FMOD::System* system = nullptr;
+	if ( FMOD::System_Create( &system ) == FMOD_OK && system->setOutput( FMOD_OUTPUTTYPE_NOSOUND ) == FMOD_OK &&
+		 system->init( 1, FMOD_INIT_NORMAL, nullptr ) == FMOD_OK )
+	{
+		unsigned int codec = 0;
+		system->registerCodec( univer::audio::UAdpcmCodec::getDescription(), &codec );
+		for ( const char* path : { "assets/deepbark.wav", "deepbark.uad" } )
+		{
+			benchmarkSoundDecode( system, path );
+		}
+		system->release();
+	}
+
+	audioEngine.shutdown();
+	return 0;
+}
@@ -0,0 +1,48 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// Encoder.cpp                                                               //
+// ========================================================================= //
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+
+#include <univer_audio/UAudioEngine.h>
+
+// Converts sound files to the engine ADPCM format. Every file FMOD can read is
+// accepted, the encoded file is written next to it with the .uad extension.
+//   encoder <file> [<file> ...]
+int main( int argc, char** argv )
+{
+	if ( argc < 2 )
+	{
+		std::cout << "usage: " << argv[0] << " <file> [<file> ...]" << std::endl;
+		return 1;
+	}
+
+	univer::audio::UAudioEngine audioEngine;
+	audioEngine.init( 1 );
+
+	int failures = 0;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const std::filesystem::path source = argv[i];
+		std::filesystem::path encoded = source;
+		encoded.replace_extension( ".uad" );
+		if ( encoded == source || !audioEngine.encodeSound( source.string(), encoded.string() ) )
+		{
+			std::cout << source.string() << " : failed" << std::endl;
+			++failures;
+			continue;
+		}
+		std::error_code error;
+		const auto sourceBytes = std::filesystem::file_size( source, error );
+		const auto encodedBytes = std::filesystem::file_size( encoded, error );
+		std::cout << source.string() << " -> " << encoded.string() << " : " << sourceBytes << " -> " << encodedBytes
+			<< " bytes" << std::endl;
+	}
+
+	audioEngine.shutdown();
+	return failures == 0 ? 0 : 1;
+}
@@ -51,6 +51,7 @@ void Application::init()
 {
 	m_audioEngine = new univer::audio::UAudioEngine();
 	m_audioEngine->init();
+	m_audioEngine->setFadeMode( univer::audio::UFadeMode::DSP_CLOCK );
 
 	float position[3] = { 0, 0, 0 };
 	float look[3] = { 0, 0, 1 };
@@ -87,7 +88,7 @@ void Application::update( const float dt )
 			std::cout << angle++ << std::endl;
 			if ( angle == 360 )
 			{
-				m_audioEngine->stopChannel( channelId, 1000 );
+				m_audioEngine->stopChannel( channelId, 1.f );
 			}
 		}
 
@@ -175,7 +176,7 @@ int main()
 			std::this_thread::sleep_for( delta );
 
 			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-			float dt = float( std::chrono::duration_cast<std::chrono::milliseconds>( now - lastTime ).count() );
+			float dt = std::chrono::duration<float>( now - lastTime ).count();
 
 			lastTime = now;
 
@@ -7,14 +7,178 @@
 #ifndef U_AUDIO_ENGINE_H_
 #define U_AUDIO_ENGINE_H_
 
+#include <functional>
+#include <span>
 #include <string>
 
 namespace univer::audio
 {
+enum class UStealPolicy
+{
+	OLDEST,
+	QUIETEST,
+	FURTHEST,
+	REJECT_NEW
+};
+
+enum class UFadeMode
+{
+	// Volume is stepped once per update with the game dt.
+	FRAME_STEPPED,
+	// Ramps and stops are scheduled on the mixer DSP clock.
+	DSP_CLOCK
+};
+
+// Buses created by init, all children of the master bus. Buses created later
+// get ids after these.
+enum UBusId : int
+{
+	MASTER_BUS = 0,
+	MUSIC_BUS,
+	SFX_BUS,
+	VOICE_BUS,
+	UI_BUS
+};
+
+enum class UBusEffect
+{
+	LOWPASS,
+	HIGHPASS,
+	ECHO,
+	REVERB,
+	COMPRESSOR,
+	PARAMEQ
+};
+
+// The FMOD reverb presets.
+enum class UReverbPreset
+{
+	OFF,
+	GENERIC,
+	PADDED_CELL,
+	ROOM,
+	BATHROOM,
+	LIVING_ROOM,
+	STONE_ROOM,
+	AUDITORIUM,
+	CONCERT_HALL,
+	CAVE,
+	ARENA,
+	HANGAR,
+	CARPETED_HALLWAY,
+	HALLWAY,
+	STONE_CORRIDOR,
+	ALLEY,
+	FOREST,
+	CITY,
+	MOUNTAINS,
+	QUARRY,
+	PLAIN,
+	PARKING_LOT,
+	SEWER_PIPE,
+	UNDERWATER
+};
+
+struct UPlayRequest
+{
+	int soundId;
+	float position[3];
+	float volumedB = 0.0f;
+};
+
+constexpr int OUTSIDE_ROOM = -1;
+
+// HDR audio: the loudest voices set the top of a loudness window the mix
+// follows, so a firefight pushes quieter sounds down and out of the mix
+// instead of clipping it.
+struct UHdrSettings
+{
+	bool enabled = false;
+	// Sounds routed to this bus or below it go through the window.
+	int busId = SFX_BUS;
+	// Loudness heard at full volume. While the window top is above it, the
+	// HDR sounds are turned down by the difference.
+	float referenceLoudnessdB = 0.0f;
+	// Voices further than this below the window top lose their voice.
+	float windowSizedB = 40.0f;
+	// Voices within this above the bottom of the window fade towards it.
+	float fadeRangedB = 6.0f;
+	// The window top rises at once and falls back this fast.
+	float releasedBPerSecond = 12.0f;
+};
+
+// A point of an authored distance rolloff, gain from 0 to 1.
+struct URolloffPoint
+{
+	float distance;
+	float gain;
+};
+
+// Split screen and multiple viewpoints, as many as FMOD allows.
+constexpr int MAX_LISTENERS = 8;
+
+struct UListenerAttributes
+{
+	float position[3];
+	float look[3];
+	float up[3];
+};
+
+// What a raycast between the listener and an emitter found in the way, from
+// 0 for a clear path to 1 for a fully blocked one. Obstruction only blocks the
+// direct sound, occlusion also blocks the reverberant sound.
+struct UOcclusion
+{
+	float obstruction = 0.0f;
+	float occlusion = 0.0f;
+};
+
+using URaycastCallback = std::function< UOcclusion( const float vListener[3], const float vEmitter[3] ) >;
+
+struct UOcclusionSettings
+{
+	// Each playing 3D channel is raycast again after this many updates.
+	int updateInterval = 4;
+	// Rays cast per update at most. Channels over the budget wait for the
+	// next update, the ones waiting the longest go first.
+	int maxRaysPerUpdate = 32;
+	// Time spent casting per update at most. 0 means no time limit.
+	float maxMillisecondsPerUpdate = 1.0f;
+	// Results within this of the cached one are ignored, so noisy rays do
+	// not keep the filter moving.
+	float hysteresis = 0.05f;
+	float smoothingSeconds = 0.15f;
+	// Gain and low pass gain of a fully blocked path.
+	float blockedVolumedB = -15.0f;
+	float blockedLowPassGain = 0.25f;
+};
+
+struct UDopplerSettings
+{
+	// Passed to FMOD as the doppler scale, 0 disables doppler.
+	float dopplerScale = 1.0f;
+	// Velocities are derived from the positions set between two updates and
+	// smoothed over this time, so uneven frame times do not wobble the pitch.
+	float smoothingSeconds = 0.05f;
+	// Faster moves are taken as a teleport and reset the velocity to zero
+	// instead of producing a pitch spike.
+	float teleportSpeed = 100.0f;
+};
+
+// A convex polygon of a geometry chunk. Occlusion of 1 fully blocks sound
+// going through it.
+struct UGeometryPolygon
+{
+	int vertexCount;
+	float directOcclusion = 1.0f;
+	float reverbOcclusion = 1.0f;
+	bool doubleSided = true;
+};
+
 class UAudioEngine
 {
 public:
-	void init();
+	void init( const int maxVoices = 512 );
 	void update( const float dt );
 	void shutdown();
 
@@ -39,18 +203,218 @@ public:
 
 	void unLoadSound( const int soundId );
 
+	// Encodes any file FMOD can read to the engine ADPCM format, about 3.7:1
+	// over 16 bit PCM. Sounds registered from a .uad file, or from binary
+	// data in that format, load quickly and can also be streamed. Non streamed
+	// ones longer than about 256KB of PCM stay compressed in memory and are
+	// decoded by each channel as it plays. Returns false if the source cannot
+	// be read or has more than 8 channels.
+	bool encodeSound( const std::string& sourcePath, const std::string& encodedPath );
+
+	// Priorities follow FMOD: 0 is the most important and 256 the least.
+	void setSoundPriority( const int soundId, const int priority );
+	// A max instance count of 0 means unlimited.
+	void setSoundMaxInstances( const int soundId,
+							   const int maxInstances,
+							   const UStealPolicy policy = UStealPolicy::OLDEST );
+	void setVoiceStealPolicy( const UStealPolicy policy );
+	// Loops of this sound further than minDistance from the listener and in
+	// the same clusterSize cell share one voice. A minDistance of 0 disables it.
+	void setSoundClustering( const int soundId, const float minDistance, const float clusterSize );
+	// Requests of this sound within radius of one started in the same frame are
+	// merged into it with a gain boost. playSound returns the merged channel.
+	void setSoundCoalescing( const int soundId, const float radius );
+	// Requests of this sound arriving sooner than this after the last started
+	// one are dropped, unless they are coalesced.
+	void setSoundCooldown( const int soundId, const float cooldownSeconds );
+	// Channels from distance on play the variant at path instead, such as a
+	// mono downmix or a lower sample rate version. Looping channels switch
+	// variant as they move and keep their playback position, one-shots keep
+	// the one they started with. Returns false if the sound is unknown.
+	bool addSoundLod( const int soundId, const float distance, const std::string& path );
+	// Past this distance channels of the sound drop their per channel DSP:
+	// occlusion keeps its last volume without the low pass, and HRTF leaves
+	// them to FMOD panning. 0 disables it.
+	void setSoundEffectsLodDistance( const int soundId, const float distance );
+	// Loudness of the sound relative to the others for the HDR window, e.g.
+	// 30 for a gunshot and -20 for a footstep mastered at the same level.
+	void setSoundLoudness( const int soundId, const float loudnessdB );
+
+	// Sounds play on the SFX bus unless routed elsewhere. Channels already
+	// playing stay on the bus they started on.
+	void setSoundBus( const int soundId, const int busId );
+	// Replaces the inverse rolloff from min and max distance with a curve
+	// through the points, sorted by distance. The same baked curve drives FMOD
+	// and the engine audibility estimate, so culling matches what is heard.
+	// Past the last point the gain stays at its value, curves should end at 0
+	// for emitters to be culled. An empty span removes the curve. Returns
+	// false if the points are not usable.
+	bool setSoundRolloff( const int soundId, std::span< const URolloffPoint > points );
+	// Curve for every sound routed to the bus or below it that has no curve
+	// of its own.
+	bool setBusRolloff( const int busId, std::span< const URolloffPoint > points );
+
+	// Returns the new bus id, or -1 if the parent does not exist.
+	int createBus( const std::string& name, const int parentBusId = MASTER_BUS );
+	int findBus( const std::string& name ) const;
+	void setBusVolume( const int busId, const float fVolumedB );
+	void setBusPaused( const int busId, const bool paused );
+	// Stops every channel routed through the bus or its children. FMOD voices
+	// stop at once, virtual channels are released on the next update.
+	void stopBus( const int busId );
+	// Effects run in insertion order before the bus fader. Returns the effect
+	// id within the bus, or -1 on failure.
+	int addBusEffect( const int busId, const UBusEffect effect );
+	// Parameter indices are the ones of the matching FMOD_DSP_TYPE.
+	void setBusEffectParameter( const int busId, const int effectId, const int parameter, const float value );
+	void setBusEffectBypass( const int busId, const int effectId, const bool bypass );
+	void removeBusEffect( const int busId, const int effectId );
+	// Lowers the target bus by depthdB while the output of the source bus
+	// peaks above thresholddB. Runs on the mixer thread, so it needs no
+	// update calls. Returns an id for removeBusDucking, or -1 on failure.
+	int addBusDucking( const int sourceBusId,
+					   const int targetBusId,
+					   const float depthdB,
+					   const float thresholddB = -40.f,
+					   const float attackSeconds = 0.05f,
+					   const float releaseSeconds = 0.5f );
+	void removeBusDucking( const int duckingId );
+
+	// Impulse responses are decoded once and resampled to the mixer rate.
+	// Returns an id for addBusConvolutionReverb, or -1 on failure.
+	int loadImpulseResponse( const std::string& path );
+	// Interleaved samples, already at the mixer rate.
+	int createImpulseResponse( std::span< const float > samples, const int channels );
+	// Reverbs already using the IR keep it alive.
+	void unloadImpulseResponse( const int impulseResponseId );
+	// Partitioned FFT convolution as a bus effect. Parameters 0 and 1 of the
+	// effect are the wet and dry levels in dB. The wet signal lags by 512
+	// samples.
+	int addBusConvolutionReverb( const int busId,
+								 const int impulseResponseId,
+								 const float wetdB = -6.f,
+								 const float drydB = 0.f );
+
 	int playSound( const int soundId, const float vPos[3], const float fVolumedB = 0.0f );
 
+	// Starts all the requests in the same mixer block. Channel ids are reserved
+	// in bulk: the request at index i gets the returned id + i. Requests that
+	// are culled or coalesced leave their id unused.
+	int playSounds( std::span< const UPlayRequest > requests );
+
+	// Binaural rendering of the most audible 3D voices through an HRIR
+	// dataset, the other voices keep FMOD panning. Meant for headphones.
+	// Returns false if the file cannot be read.
+	bool loadHrtfDataset( const std::string& path );
+	// directions holds azimuth and elevation pairs in degrees, azimuth
+	// counterclockwise from the front. hrirs holds the left then the right
+	// response of every direction, hrirLength samples each at the mixer rate.
+	bool createHrtfDataset( std::span< const float > directions, std::span< const float > hrirs, const int hrirLength );
+	// Voices rendered binaurally at most, 16 by default. 0 disables HRTF.
+	void setHrtfVoiceBudget( const int voices );
+	bool isBinaural( const int channelId ) const;
+
+	// Occlusion of the playing 3D channels by the game geometry. The callback
+	// is only called from update, never more than the settings allow. An
+	// empty callback turns occlusion off and clears every channel.
+	void setOcclusionCallback( URaycastCallback callback );
+	void setOcclusionSettings( const UOcclusionSettings& settings );
+
+	// Offline baking for tools: probes spacing apart over the bounds store the
+	// reverb send and the occlusion around them, written to path. Cost grows
+	// with probes times polygons.
+	bool bakeAcousticProbes( std::span< const float > vertices,
+							 std::span< const UGeometryPolygon > polygons,
+							 const float vBoundsMin[3],
+							 const float vBoundsMax[3],
+							 const float spacing,
+							 const std::string& path );
+	// While a baked grid is loaded it replaces the occlusion callback: every
+	// playing 3D channel samples it each update for its occlusion and its
+	// reverb send. Returns false if the file cannot be read.
+	bool loadAcousticProbes( const std::string& path );
+	void unloadAcousticProbes();
+
+	// Rooms and portals for sound propagation around corners. An emitter in
+	// another room than the listener is heard from the direction of the first
+	// portal on the shortest open path, as far away as the path is long, and
+	// attenuated by the openness of the portals it goes through. Paths are
+	// searched again only when a portal changes or the listener changes room.
+	// Rooms are axis aligned boxes, returns the room id or -1 on failure.
+	int addAcousticRoom( const float vMin[3], const float vMax[3] );
+	void removeAcousticRoom( const int roomId );
+	// Connects two rooms, or a room with the outside when a room id is
+	// OUTSIDE_ROOM. Returns the portal id or -1 on failure.
+	int addAcousticPortal( const int roomA, const int roomB, const float vPosition[3], const float openness = 1.f );
+	void removeAcousticPortal( const int portalId );
+	// 0 is closed and 1 fully open.
+	void setAcousticPortalOpenness( const int portalId, const float openness );
+	// Gain of emitters without an open path to the listener, -30 dB by default.
+	void setAcousticWallTransmission( const float transmissiondB );
+
+	// Level geometry occluding sound natively in FMOD, as an alternative to the
+	// occlusion callback. Chunks are only built into FMOD geometry while the
+	// listener is within the streaming radius of their bounds, so memory
+	// follows the listener instead of the world size.
+	// vertices holds world space xyz triplets of every polygon in order.
+	// Returns a chunk id, or -1 on failure.
+	int addGeometryChunk( std::span< const float > vertices, std::span< const UGeometryPolygon > polygons );
+	// Chunk cooked by saveGeometryChunk. The file is read again each time the
+	// chunk streams in. Returns a chunk id, or -1 on failure.
+	int loadGeometryChunk( const std::string& path );
+	bool saveGeometryChunk( const int chunkId, const std::string& path );
+	void removeGeometryChunk( const int chunkId );
+	// Defaults to 100. Chunks unload once 25% further than this.
+	void setGeometryStreamingRadius( const float radius );
+	bool isGeometryChunkLoaded( const int chunkId ) const;
+
+	// Spherical reverb zones. A zone applies fully within minDistance of its
+	// center and fades out towards maxDistance. The zones around the listener
+	// are blended into the single 3D reverb of the engine once per update.
+	// Returns the zone id, or -1 on failure.
+	int addReverbZone( const float vCenter[3], const float minDistance, const float maxDistance, const UReverbPreset preset );
+	void setReverbZonePreset( const int zoneId, const UReverbPreset preset );
+	void removeReverbZone( const int zoneId );
+	// Reverb heard where no zone applies fully, OFF by default.
+	void setAmbientReverb( const UReverbPreset preset );
+
 	void setChannel3dPosition( const int channelId, const float vPosition[3] );
 	void setChannelVolume( const int channelId, float fVolumedB );
 
+	// Positions are pushed to FMOD once per update, with velocities derived
+	// from the previous update so doppler needs no extra calls.
 	void set3dListenerAndOrientation( const float vPosition[3], const float vLook[3], const float vUp[3] );
+	void set3dListenerAndOrientation( const int listener, const float vPosition[3], const float vLook[3], const float vUp[3] );
+	// Each channel is attenuated, culled and occluded by its closest listener.
+	// Listener 0 drives reverb zones, room propagation and HRTF, which turns
+	// off while more than one listener is active. Clamped to MAX_LISTENERS.
+	void setNumListeners( const int count );
+	int getNumListeners() const;
+	// Sets the listener count to the span size and every listener at once.
+	void set3dListeners( std::span< const UListenerAttributes > listeners );
+	void setDopplerSettings( const UDopplerSettings& settings );
+	void setHdrSettings( const UHdrSettings& settings );
+	// Play requests estimated below this level (or beyond the sound max
+	// distance) never get an FMOD voice: one-shots are dropped and loops wait
+	// as virtual channels until they become audible. Defaults to -60 dB.
+	void setAudibilityThreshold( const float thresholddB );
+	// Cell size of the grid indexing 3D emitters for audibility queries.
+	// Roughly the typical max distance of the sounds works well.
+	void setEmitterGridCellSize( const float cellSize );
 	void stopChannel( const int channelId, const float fadeTimeSeconds = 0.f );
+	void setFadeMode( const UFadeMode mode );
 	void stopAllChannels();
 	bool isPlaying( const int channelId ) const;
+	// Virtual channels keep their playback time without an FMOD voice and are
+	// reported as playing.
+	bool isVirtual( const int channelId ) const;
 
 	float dBToVolume( const float dB );
 	float volumeTodB( const float volume );
+	// Batch conversions over the common prefix of both spans, within 1e-6
+	// relative error for volumes and 2e-5 dB for decibels.
+	void dBToVolume( std::span< const float > dB, std::span< float > volume );
+	void volumeTodB( std::span< const float > volume, std::span< float > dB );
 };
 }
 
@@ -7,15 +7,165 @@
 #include "UAEImplementation.h"
 #include "UAUtils.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
 using univer::audio::UAEImplementation;
+using univer::audio::UAdpcmCodec;
+using univer::audio::USound;
+using univer::audio::UChannel;
+using univer::audio::UFadeMode;
+using univer::audio::UBus;
+using univer::audio::UConvolutionReverb;
+using univer::audio::UImpulseResponse;
+using univer::audio::UGeometryManager;
+using univer::audio::UReverbZoneManager;
+using univer::audio::URolloffCurve;
+using univer::audio::URolloffPoint;
+
+namespace
+{
+std::vector< float > toFloatSamples( const void* data, const unsigned int bytes, const FMOD_SOUND_FORMAT format )
+{
+	std::vector< float > samples;
+	const auto* bytePtr = static_cast< const unsigned char* >( data );
+	switch ( format )
+	{
+		case FMOD_SOUND_FORMAT_PCM8:
+			for ( unsigned int i = 0; i < bytes; ++i )
+			{
+				samples.push_back( float( static_cast< signed char >( bytePtr[i] ) ) / 128.f );
+			}
+			break;
+		case FMOD_SOUND_FORMAT_PCM16:
+			for ( unsigned int i = 0; i + 1 < bytes; i += 2 )
+			{
+				const int16_t value = int16_t( bytePtr[i] | ( bytePtr[i + 1] << 8 ) );
+				samples.push_back( float( value ) / 32768.f );
+			}
+			break;
+		case FMOD_SOUND_FORMAT_PCM24:
+			for ( unsigned int i = 0; i + 2 < bytes; i += 3 )
+			{
+				const int32_t value = int32_t( uint32_t( bytePtr[i] ) << 8 | uint32_t( bytePtr[i + 1] ) << 16 | uint32_t( bytePtr[i + 2] ) << 24 ) >> 8;
+				samples.push_back( float( value ) / 8388608.f );
+			}
+			break;
+		case FMOD_SOUND_FORMAT_PCM32:
+			for ( unsigned int i = 0; i + 3 < bytes; i += 4 )
+			{
+				int32_t value = 0;
+				std::memcpy( &value, bytePtr + i, sizeof( value ) );
+				samples.push_back( float( value ) / 2147483648.f );
+			}
+			break;
+		case FMOD_SOUND_FORMAT_PCMFLOAT:
+			samples.resize( bytes / sizeof( float ) );
+			std::memcpy( samples.data(), data, samples.size() * sizeof( float ) );
+			break;
+		default:
+			break;
+	}
+	return samples;
+}
+
+std::vector< float > resampleLinear( const std::vector< float >& samples, const int channels, const double ratio )
+{
+	const size_t frames = samples.size() / size_t( channels );
+	const size_t resampledFrames = size_t( double( frames ) * ratio );
+	std::vector< float > resampled( resampledFrames * size_t( channels ) );
+	for ( size_t frame = 0; frame < resampledFrames; ++frame )
+	{
+		const double source = double( frame ) / ratio;
+		const size_t index = std::min( size_t( source ), frames - 1 );
+		const size_t next = std::min( index + 1, frames - 1 );
+		const float t = float( source - double( index ) );
+		for ( int channel = 0; channel < channels; ++channel )
+		{
+			const float a = samples[index * size_t( channels ) + size_t( channel )];
+			const float b = samples[next * size_t( channels ) + size_t( channel )];
+			resampled[frame * size_t( channels ) + size_t( channel )] = a + ( b - a ) * t;
+		}
+	}
+	return resampled;
+}
+
+FMOD_MODE soundMode( const univer::audio::USound& sound )
+{
+	FMOD_MODE eMode = /*FMOD_NONBLOCKING*/FMOD_DEFAULT;
+	eMode |= sound.is3d ? ( FMOD_3D/* | FMOD_3D_INVERSETAPEREDROLLOFF*/ ) : FMOD_2D;
+	eMode |= sound.isLooping ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
+	eMode |= sound.isStreaming ? FMOD_CREATESTREAM : FMOD_CREATECOMPRESSEDSAMPLE;
+	return eMode;
+}
+
+FMOD_MODE encodedStreamMode( const univer::audio::USound& sound )
+{
+	return ( soundMode( sound ) & ~FMOD_CREATECOMPRESSEDSAMPLE ) | FMOD_CREATESTREAM | FMOD_OPENMEMORY_POINT;
+}
 
-UAEImplementation::UAEImplementation() :
+constexpr FMOD_MODE ROLLOFF_MODES = FMOD_3D_INVERSEROLLOFF | FMOD_3D_LINEARROLLOFF | FMOD_3D_LINEARSQUAREROLLOFF |
+									FMOD_3D_INVERSETAPEREDROLLOFF | FMOD_3D_CUSTOMROLLOFF;
+// Streams of encoded sounds decode two codec blocks ahead, about 40ms at
+// 48kHz, instead of the FMOD default of 400ms per channel.
+constexpr unsigned int ENCODED_STREAM_DECODE_FRAMES = 2 * UAdpcmCodec::BLOCK_FRAMES;
+// A channel stream costs about 10KB. Encoded sounds decoding to less than
+// this are loaded as PCM samples instead, decoded once by the codec, so short
+// sounds with many channels do not end up using more memory.
+constexpr size_t MIN_RESIDENT_PCM_BYTES = 256 * 1024;
+// Checked before the built in codecs, rejecting other files is a 16 byte
+// header read.
+constexpr unsigned int ADPCM_CODEC_PRIORITY = 0;
+}
+
+static_assert( univer::audio::MAX_LISTENERS == FMOD_MAX_LISTENERS );
+
+UAEImplementation::UAEImplementation( const int maxVoices ) :
 	system( nullptr ),
+	busStopSerial( 0 ),
+	voiceManager( *this ),
+	fadeMode( UFadeMode::FRAME_STEPPED ),
+	sampleRate( 48000 ),
+	numListeners( 1 ),
+	audibilityThreshold( 0.001f ),
+	emitterGrid( 64.f ),
+	clusterer( *this ),
+	occlusionManager( *this ),
+	roomGraph( *this ),
+	hdrMixer( *this ),
+	audibleRadius( 0.f ),
+	clock( 0.0 ),
 	nextChannelId( 0 ),
-	nextSoundId( 0 )
+	nextSoundId( 0 ),
+	nextBusId( 0 ),
+	nextDuckerId( 0 ),
+	nextImpulseResponseId( 0 )
 {
+	for ( Listener& listener : listeners )
+	{
+		listener = { { 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f }, false };
+	}
 	checkErrors( ::FMOD::System_Create( &system ) );
-	checkErrors( system->init( 512, FMOD_INIT_NORMAL, nullptr ) );
+	checkErrors( system->init( maxVoices, FMOD_INIT_NORMAL, nullptr ) );
+	checkErrors( system->getSoftwareFormat( &sampleRate, nullptr, nullptr ) );
+	voiceManager.setMaxVoices( maxVoices );
+	checkErrors( system->registerDSP( UConvolutionReverb::getDescription(), &convolutionReverbPlugin ) );
+	checkErrors( system->registerCodec( UAdpcmCodec::getDescription(), &adpcmCodecPlugin, ADPCM_CODEC_PRIORITY ) );
+	hrtfSpatializer = std::make_unique< UHrtfSpatializer >( *this );
+	geometryManager = std::make_unique< UGeometryManager >( *this );
+	reverbZoneManager = std::make_unique< UReverbZoneManager >( *this );
+
+	::FMOD::ChannelGroup* masterGroup = nullptr;
+	checkErrors( system->getMasterChannelGroup( &masterGroup ) );
+	buses[nextBusId++] = std::make_unique< UBus >( "master", nullptr, masterGroup );
+	createBus( "music", MASTER_BUS );
+	createBus( "sfx", MASTER_BUS );
+	createBus( "voice", MASTER_BUS );
+	createBus( "ui", MASTER_BUS );
 }
 
 UAEImplementation::~UAEImplementation()
@@ -26,6 +176,7 @@ UAEImplementation::~UAEImplementation()
 		{
 			channel->stop();
 		}
+		channel->releaseStream();
 	}
 	for ( const auto& [soundId, sound] : sounds )
 	{
@@ -34,15 +185,56 @@ UAEImplementation::~UAEImplementation()
 			unloadSound( soundId );
 		}
 	}
+	duckers.clear();
+	hrtfSpatializer.reset();
+	geometryManager.reset();
+	reverbZoneManager.reset();
+	// Children have larger ids than their parents, so they go first.
+	while ( !buses.empty() )
+	{
+		buses.erase( std::prev( buses.end() ) );
+	}
 	checkErrors( system->release() );
 }
 
 void UAEImplementation::update( const float dt )
 {
+	clock += dt;
+	frameStarts.clear();
+	releaseStoppedBuses();
+	applyFades( dt );
+
+	// Dormant channels are far virtual loops, they are only visited when the
+	// emitter grid finds them within the audible radius of a listener.
+	updatedChannels.assign( awakeChannels.begin(), awakeChannels.end() );
+	nearbyChannels.clear();
+	for ( int index = 0; index < numListeners; ++index )
+	{
+		emitterGrid.query( listeners[index].position, audibleRadius, nearbyChannels );
+	}
+	if ( numListeners > 1 )
+	{
+		std::sort( nearbyChannels.begin(), nearbyChannels.end() );
+		nearbyChannels.erase( std::unique( nearbyChannels.begin(), nearbyChannels.end() ), nearbyChannels.end() );
+	}
+	for ( const int channelId : nearbyChannels )
+	{
+		if ( awakeChannels.count( channelId ) == 0 )
+		{
+			updatedChannels.push_back( channelId );
+		}
+	}
+	clusterer.update( updatedChannels );
+
 	std::vector<std::map< int, std::unique_ptr< UChannel > >::iterator> pStoppedChannels;
-	for ( auto it = channels.begin(), itEnd = channels.end(); it != itEnd; ++it )
+	for ( const int channelId : updatedChannels )
 	{
-		it->second->update( dt );
+		auto it = channels.find( channelId );
+		if ( it == channels.end() )
+		{
+			continue;
+		}
+		it->second->update();
 		if ( it->second->m_state == UChannel::State::STOPPED )
 		{
 			pStoppedChannels.push_back( it );
@@ -50,11 +242,451 @@ void UAEImplementation::update( const float dt )
 	}
 	for ( auto& it : pStoppedChannels )
 	{
+		voiceManager.releaseVoice( *it->second );
+		emitterGrid.remove( it->first );
+		faderBank.cancel( it->first );
+		velocityTracker.remove( it->first );
+		awakeChannels.erase( it->first );
 		channels.erase( it );
 	}
+	voiceManager.update();
+	roomGraph.update( updatedChannels );
+	hdrMixer.update( dt, updatedChannels );
+	applyMotion( dt );
+	geometryManager->update();
+	reverbZoneManager->update();
+	occlusionManager.update( dt, updatedChannels );
+	hrtfSpatializer->update();
 	checkErrors( system->update() );
 }
 
+void UAEImplementation::setNumListeners( const int count )
+{
+	const int clamped = std::clamp( count, 1, MAX_LISTENERS );
+	if ( clamped == numListeners )
+	{
+		return;
+	}
+	// A listener joining starts at rest where it was last left.
+	for ( int index = numListeners; index < clamped; ++index )
+	{
+		std::fill( listeners[index].velocity, listeners[index].velocity + 3, 0.f );
+		std::copy( listeners[index].position, listeners[index].position + 3, listeners[index].previousPosition );
+		listeners[index].dirty = true;
+	}
+	numListeners = clamped;
+	checkErrors( system->set3DNumListeners( numListeners ) );
+}
+
+void UAEImplementation::setListener( const int index, const float vPosition[3], const float vLook[3], const float vUp[3] )
+{
+	if ( index < 0 || index >= MAX_LISTENERS )
+	{
+		return;
+	}
+	Listener& listener = listeners[index];
+	std::copy( vPosition, vPosition + 3, listener.position );
+	std::copy( vLook, vLook + 3, listener.forward );
+	std::copy( vUp, vUp + 3, listener.up );
+	listener.dirty = true;
+}
+
+const float* UAEImplementation::closestListener( const float vPosition[3] ) const
+{
+	const float* closest = listeners[0].position;
+	float closestDistance = std::numeric_limits< float >::max();
+	for ( int index = 0; index < numListeners; ++index )
+	{
+		const float* position = listeners[index].position;
+		const float dx = vPosition[0] - position[0];
+		const float dy = vPosition[1] - position[1];
+		const float dz = vPosition[2] - position[2];
+		const float distance = dx * dx + dy * dy + dz * dz;
+		if ( distance < closestDistance )
+		{
+			closestDistance = distance;
+			closest = position;
+		}
+	}
+	return closest;
+}
+
+float UAEImplementation::distanceToListenerSquared( const float vPosition[3] ) const
+{
+	// FMOD attenuates every channel by its closest listener, so audibility
+	// and voice culling do the same.
+	const float* listener = closestListener( vPosition );
+	const float dx = vPosition[0] - listener[0];
+	const float dy = vPosition[1] - listener[1];
+	const float dz = vPosition[2] - listener[2];
+	return dx * dx + dy * dy + dz * dz;
+}
+
+float UAEImplementation::distanceGain( const USound& sound, const float vPosition[3] ) const
+{
+	if ( !sound.is3d )
+	{
+		return 1.f;
+	}
+	const float distanceSquared = distanceToListenerSquared( vPosition );
+	if ( sound.m_rolloff == nullptr && distanceSquared > sound.maxDistance * sound.maxDistance )
+	{
+		return 0.f;
+	}
+	if ( sound.m_rolloff != nullptr )
+	{
+		return sound.m_rolloff->getGain( std::sqrt( distanceSquared ) );
+	}
+	// Same inverse rolloff FMOD applies by default.
+	const float distance = std::sqrt( distanceSquared );
+	return distance > sound.minDistance ? sound.minDistance / distance : 1.f;
+}
+
+float UAEImplementation::estimateAudibility( const USound& sound, const float vPosition[3], const float fVolumedB )
+{
+	float audibility = dBToVolume( fVolumedB );
+	auto tBusIt = buses.find( sound.busId );
+	if ( tBusIt != buses.end() )
+	{
+		audibility *= tBusIt->second->getEffectiveVolume();
+	}
+	return audibility * distanceGain( sound, vPosition );
+}
+
+bool UAEImplementation::isAudible( const USound& sound, const float vPosition[3], const float fVolumedB )
+{
+	// For channels not created yet, which have no propagation: the same level
+	// as the channel overload below.
+	const float audibility = estimateAudibility( sound, vPosition, fVolumedB );
+	return audibility >= audibilityThreshold && !hdrMixer.isBelowWindow( sound, audibility );
+}
+
+float UAEImplementation::estimateAudibility( const USound& sound, const UChannel& channel )
+{
+	return estimateAudibility( sound, channel.m_apparentPosition, channel.m_soundVolume ) * channel.m_propagationGain;
+}
+
+bool UAEImplementation::isAudible( const USound& sound, const UChannel& channel )
+{
+	const float audibility = estimateAudibility( sound, channel );
+	return audibility >= audibilityThreshold && !hdrMixer.isBelowWindow( sound, audibility );
+}
+
+UChannel* UAEImplementation::createChannel( const int channelId,
+											const int soundId,
+											const USound& sound,
+											const float vPosition[3],
+											const float fVolumedB,
+											const bool isAdmitted )
+{
+	// Inaudible one-shots are dropped before any allocation, inaudible loops
+	// are kept as virtual channels until they come into range.
+	const bool audible = isAudible( sound, vPosition, fVolumedB );
+	if ( !audible && !sound.isLooping )
+	{
+		return nullptr;
+	}
+	if ( audible && !isAdmitted && !voiceManager.requestVoice( sound, soundId ) )
+	{
+		return nullptr;
+	}
+
+	auto tChannelIt = channels.emplace_hint( channels.end(),
+											 channelId,
+											 std::make_unique< UChannel >( *this,
+																		   channelId,
+																		   soundId,
+																		   vPosition,
+																		   fVolumedB ) );
+	UChannel& channel = *tChannelIt->second;
+	channel.m_priority = sound.priority;
+	channel.m_busId = sound.busId;
+	channel.m_busSerial = busStopSerial;
+	if ( sound.is3d )
+	{
+		channel.m_isSpatial = true;
+		emitterGrid.insert( channelId, vPosition );
+	}
+	if ( audible )
+	{
+		voiceManager.addVoice( channel );
+	}
+	else
+	{
+		channel.m_state = UChannel::State::VIRTUAL;
+	}
+	setChannelDormant( channel, !audible && channel.m_isSpatial );
+	return &channel;
+}
+
+UChannel* UAEImplementation::requestChannel( const int channelId,
+											 const int soundId,
+											 USound& sound,
+											 const float vPosition[3],
+											 const float fVolumedB,
+											 const bool isAdmitted )
+{
+	// Requests for the same sound close to a voice started this frame are
+	// indistinguishable from it, they only add their energy to that voice.
+	if ( sound.coalesceRadius > 0.f )
+	{
+		const float radiusSquared = sound.coalesceRadius * sound.coalesceRadius;
+		for ( FrameStart& start : frameStarts )
+		{
+			if ( start.soundId != soundId )
+			{
+				continue;
+			}
+			const float dx = vPosition[0] - start.position[0];
+			const float dy = vPosition[1] - start.position[1];
+			const float dz = vPosition[2] - start.position[2];
+			if ( dx * dx + dy * dy + dz * dz > radiusSquared )
+			{
+				continue;
+			}
+			auto tChannelIt = channels.find( start.channelId );
+			if ( tChannelIt == channels.end() || tChannelIt->second->m_stopRequested )
+			{
+				continue;
+			}
+			const float volume = dBToVolume( fVolumedB );
+			start.energy += volume * volume;
+			tChannelIt->second->setVolume( std::sqrt( start.energy ) );
+			return tChannelIt->second.get();
+		}
+	}
+
+	if ( clock - sound.m_lastPlayTime < sound.retriggerCooldown )
+	{
+		return nullptr;
+	}
+
+	UChannel* channel = createChannel( channelId, soundId, sound, vPosition, fVolumedB, isAdmitted );
+	if ( channel == nullptr )
+	{
+		return nullptr;
+	}
+	sound.m_lastPlayTime = clock;
+	if ( sound.coalesceRadius > 0.f )
+	{
+		const float volume = dBToVolume( fVolumedB );
+		frameStarts.push_back( { soundId, channelId, { vPosition[0], vPosition[1], vPosition[2] }, volume * volume } );
+	}
+	return channel;
+}
+
+void UAEImplementation::reserveChannels( const size_t count )
+{
+	// The channel map itself cannot reserve, the containers filled along
+	// with it grow once for the whole batch.
+	awakeChannels.reserve( awakeChannels.size() + count );
+	frameStarts.reserve( frameStarts.size() + count );
+	voiceManager.reserve( count );
+}
+
+void UAEImplementation::setChannelDormant( UChannel& channel, const bool dormant )
+{
+	channel.m_isDormant = dormant;
+	if ( dormant )
+	{
+		awakeChannels.erase( channel.m_channelId );
+	}
+	else
+	{
+		awakeChannels.insert( channel.m_channelId );
+	}
+}
+
+int UAEImplementation::createBus( const std::string& name, const int parentBusId )
+{
+	UBus* parent = findBus( parentBusId );
+	if ( parent == nullptr )
+	{
+		return -1;
+	}
+	::FMOD::ChannelGroup* group = nullptr;
+	if ( checkErrors( system->createChannelGroup( name.c_str(), &group ) ) ||
+		 checkErrors( parent->m_fmodGroup->addGroup( group ) ) )
+	{
+		if ( group != nullptr )
+		{
+			group->release();
+		}
+		return -1;
+	}
+	const int busId = nextBusId++;
+	buses[busId] = std::make_unique< UBus >( name, parent, group );
+	return busId;
+}
+
+UBus* UAEImplementation::findBus( const int busId )
+{
+	auto tFoundIt = buses.find( busId );
+	return tFoundIt != buses.end() ? tFoundIt->second.get() : nullptr;
+}
+
+void UAEImplementation::stopBus( const int busId )
+{
+	UBus* bus = findBus( busId );
+	if ( bus == nullptr )
+	{
+		return;
+	}
+	// One call stops every FMOD voice below the group. Engine side channels,
+	// including virtual ones, are released on the next update.
+	checkErrors( bus->m_fmodGroup->stop() );
+	pendingBusStops.push_back( { busId, ++busStopSerial } );
+}
+
+void UAEImplementation::releaseStoppedBuses()
+{
+	if ( pendingBusStops.empty() )
+	{
+		return;
+	}
+	for ( const auto& [channelId, channel] : channels )
+	{
+		if ( channel->m_stopRequested )
+		{
+			continue;
+		}
+		const UBus* channelBus = findBus( channel->m_busId );
+		for ( const BusStop& busStop : pendingBusStops )
+		{
+			const UBus* stoppedBus = findBus( busStop.busId );
+			// Channels started after the stop call are left alone.
+			if ( channel->m_busSerial < busStop.serial && channelBus != nullptr &&
+				 stoppedBus != nullptr && channelBus->isWithin( *stoppedBus ) )
+			{
+				// The group already stopped the FMOD channel.
+				channel->m_fmodChannel = nullptr;
+				channel->stop();
+				break;
+			}
+		}
+	}
+	pendingBusStops.clear();
+}
+
+bool UAEImplementation::decodeSoundFile( const std::string& path, std::vector< float >& samples, int& channels, float& frequency )
+{
+	samples.clear();
+	::FMOD::Sound* sound = nullptr;
+	if ( checkErrors( system->createSound( path.c_str(), FMOD_2D | FMOD_LOOP_OFF | FMOD_CREATESAMPLE, nullptr, &sound ) ) )
+	{
+		return false;
+	}
+	FMOD_SOUND_FORMAT format = FMOD_SOUND_FORMAT_NONE;
+	unsigned int bytes = 0;
+	channels = 0;
+	frequency = 0.f;
+	checkErrors( sound->getFormat( nullptr, &format, &channels, nullptr ) );
+	checkErrors( sound->getDefaults( &frequency, nullptr ) );
+	checkErrors( sound->getLength( &bytes, FMOD_TIMEUNIT_PCMBYTES ) );
+
+	void* data = nullptr;
+	void* wrapped = nullptr;
+	unsigned int length = 0;
+	unsigned int wrappedLength = 0;
+	if ( channels > 0 && bytes > 0 && !checkErrors( sound->lock( 0, bytes, &data, &wrapped, &length, &wrappedLength ) ) )
+	{
+		samples = toFloatSamples( data, length, format );
+		checkErrors( sound->unlock( data, wrapped, length, wrappedLength ) );
+	}
+	checkErrors( sound->release() );
+	return !samples.empty();
+}
+
+int UAEImplementation::loadImpulseResponse( const std::string& path )
+{
+	std::vector< float > samples;
+	int channels = 0;
+	float frequency = 0.f;
+	if ( !decodeSoundFile( path, samples, channels, frequency ) )
+	{
+		return -1;
+	}
+
+	// The kernels run at the mixer rate.
+	if ( frequency > 0.f && int( frequency ) != sampleRate )
+	{
+		samples = resampleLinear( samples, channels, double( sampleRate ) / double( frequency ) );
+	}
+	return addImpulseResponse( UConvolutionReverb::createImpulseResponse( samples, channels ) );
+}
+
+int UAEImplementation::addImpulseResponse( std::shared_ptr< const UImpulseResponse > impulseResponse )
+{
+	if ( impulseResponse == nullptr || impulseResponse->channels.empty() )
+	{
+		return -1;
+	}
+	const int impulseResponseId = nextImpulseResponseId++;
+	impulseResponses[impulseResponseId] = std::move( impulseResponse );
+	return impulseResponseId;
+}
+
+void UAEImplementation::applyFades( const float dt )
+{
+	for ( const UFaderBank::VolumeChange& change : faderBank.update( dt ) )
+	{
+		auto tChannelIt = channels.find( change.channelId );
+		if ( tChannelIt == channels.end() || tChannelIt->second->m_fmodChannel == nullptr )
+		{
+			continue;
+		}
+		::FMOD::Channel* fmodChannel = tChannelIt->second->m_fmodChannel;
+		checkErrors( fmodChannel->setVolume( change.volume * tChannelIt->second->getGainScale() ) );
+		if ( change.finished && tChannelIt->second->m_stopRequested )
+		{
+			checkErrors( fmodChannel->stop() );
+		}
+	}
+}
+
+void UAEImplementation::applyMotion( const float dt )
+{
+	const float blend = dopplerSettings.smoothingSeconds > 0.f ? 1.f - std::exp( -dt / dopplerSettings.smoothingSeconds ) : 1.f;
+	for ( const UVelocityTracker::Motion& motion : velocityTracker.update( dt, blend, dopplerSettings.teleportSpeed ) )
+	{
+		auto tChannelIt = channels.find( motion.channelId );
+		if ( tChannelIt == channels.end() || tChannelIt->second->m_fmodChannel == nullptr )
+		{
+			continue;
+		}
+		const float* apparent = tChannelIt->second->m_apparentPosition;
+		FMOD_VECTOR position = { apparent[0], apparent[1], apparent[2] };
+		FMOD_VECTOR velocity = { motion.velocity[0], motion.velocity[1], motion.velocity[2] };
+		checkErrors( tChannelIt->second->m_fmodChannel->set3DAttributes( &position, &velocity ) );
+	}
+
+	// Listeners are pushed while they move and once more when they stop, so
+	// FMOD never keeps a stale velocity.
+	for ( int index = 0; index < numListeners; ++index )
+	{
+		Listener& listener = listeners[index];
+		const bool wasMoving = listener.velocity[0] != 0.f || listener.velocity[1] != 0.f || listener.velocity[2] != 0.f;
+		UVelocityTracker::derive( listener.previousPosition, listener.position, dt, blend, dopplerSettings.teleportSpeed, listener.velocity );
+		std::copy( listener.position, listener.position + 3, listener.previousPosition );
+		const float speedSquared = listener.velocity[0] * listener.velocity[0] + listener.velocity[1] * listener.velocity[1] +
+								   listener.velocity[2] * listener.velocity[2];
+		if ( speedSquared < 1e-4f )
+		{
+			std::fill( listener.velocity, listener.velocity + 3, 0.f );
+		}
+		if ( !listener.dirty && !wasMoving )
+		{
+			continue;
+		}
+		listener.dirty = false;
+		FMOD_VECTOR position = { listener.position[0], listener.position[1], listener.position[2] };
+		FMOD_VECTOR velocity = { listener.velocity[0], listener.velocity[1], listener.velocity[2] };
+		FMOD_VECTOR look = { listener.forward[0], listener.forward[1], listener.forward[2] };
+		FMOD_VECTOR up = { listener.up[0], listener.up[1], listener.up[2] };
+		checkErrors( system->set3DListenerAttributes( index, &position, &velocity, &look, &up ) );
+	}
+}
+
 bool UAEImplementation::soundIsLoaded( const int soundId )
 {
 	auto tFoundIt = sounds.find( soundId );
@@ -68,6 +700,20 @@ bool UAEImplementation::soundIsLoaded( const int soundId )
 	return false;
 }
 
+USound* UAEImplementation::findLoadedSound( const int soundId )
+{
+	auto tFoundIt = sounds.find( soundId );
+	if ( tFoundIt == sounds.end() )
+	{
+		return nullptr;
+	}
+	if ( tFoundIt->second->m_fmodSound == nullptr )
+	{
+		loadSound( soundId );
+	}
+	return tFoundIt->second->m_fmodSound != nullptr ? tFoundIt->second.get() : nullptr;
+}
+
 void UAEImplementation::loadSound( const int soundId, const void* data, const size_t dataSize )
 {
 	if ( soundIsLoaded( soundId ) )
@@ -82,13 +728,14 @@ void UAEImplementation::loadSound( const int soundId, const void* data, const si
 
 	const auto& uSound = tFoundIt->second;
 
-	FMOD_MODE eMode = /*FMOD_NONBLOCKING*/FMOD_DEFAULT;
-	eMode |= uSound->is3d ? ( FMOD_3D/* | FMOD_3D_INVERSETAPEREDROLLOFF*/ ) : FMOD_2D;
-	eMode |= uSound->isLooping ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
-	eMode |= uSound->isStreaming ? FMOD_CREATESTREAM : FMOD_CREATECOMPRESSEDSAMPLE;
+	FMOD_MODE eMode = soundMode( *uSound );
 
 	::FMOD::Sound* sound = nullptr;
-	if ( uSound->useBinaryData )
+	if ( !uSound->isStreaming && loadEncoded( *uSound, data, dataSize ) )
+	{
+		sound = openEncodedStream( *uSound );
+	}
+	else if ( uSound->useBinaryData )
 	{
 		int numChannels = 0;
 		float frequency = 0;
@@ -124,7 +771,245 @@ void UAEImplementation::loadSound( const int soundId, const void* data, const si
 	if ( sound != nullptr )
 	{
 		checkErrors( sound->set3DMinMaxDistance( uSound->minDistance, uSound->maxDistance ) );
+		checkErrors( sound->getLength( &uSound->m_lengthMs, FMOD_TIMEUNIT_MS ) );
 		uSound->m_fmodSound = sound;
+		for ( USound::Lod& lod : uSound->lods )
+		{
+			loadSoundLod( *uSound, lod );
+		}
+		applyRolloff( soundId, *uSound );
+	}
+}
+
+bool UAEImplementation::loadEncoded( USound& sound, const void* data, const size_t dataSize )
+{
+	UAdpcmCodec::Header header;
+	std::ifstream file;
+	if ( sound.useBinaryData )
+	{
+		if ( !UAdpcmCodec::readHeader( data, dataSize, header ) )
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if ( !UAdpcmCodec::hasExtension( sound.name ) )
+		{
+			return false;
+		}
+		uint8_t bytes[UAdpcmCodec::HEADER_BYTES];
+		file.open( sound.name, std::ios::binary );
+		if ( !file.read( reinterpret_cast< char* >( bytes ), sizeof( bytes ) ) ||
+			 !UAdpcmCodec::readHeader( bytes, sizeof( bytes ), header ) )
+		{
+			return false;
+		}
+	}
+	if ( size_t( header.frames ) * size_t( header.channels ) * sizeof( int16_t ) < MIN_RESIDENT_PCM_BYTES )
+	{
+		return false;
+	}
+
+	if ( sound.useBinaryData )
+	{
+		const auto* bytes = static_cast< const uint8_t* >( data );
+		sound.m_encoded.assign( bytes, bytes + dataSize );
+	}
+	else
+	{
+		file.seekg( 0 );
+		sound.m_encoded.assign( std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() );
+	}
+	if ( sound.m_encoded.size() < UAdpcmCodec::getEncodedBytes( header ) )
+	{
+		std::vector< uint8_t >().swap( sound.m_encoded );
+		return false;
+	}
+	return true;
+}
+
+::FMOD::Sound* UAEImplementation::openEncodedStream( const USound& sound )
+{
+	FMOD_CREATESOUNDEXINFO info;
+	std::memset( &info, 0, sizeof( info ) );
+	info.cbsize = sizeof( info );
+	info.length = static_cast< unsigned int >( sound.m_encoded.size() );
+	info.decodebuffersize = ENCODED_STREAM_DECODE_FRAMES;
+	::FMOD::Sound* stream = nullptr;
+	if ( checkErrors( system->createSound( reinterpret_cast< const char* >( sound.m_encoded.data() ), encodedStreamMode( sound ), &info, &stream ) ) )
+	{
+		return nullptr;
+	}
+	checkErrors( stream->set3DMinMaxDistance( sound.minDistance, sound.maxDistance ) );
+	if ( sound.m_rolloff != nullptr )
+	{
+		FMOD_MODE mode = 0;
+		checkErrors( stream->getMode( &mode ) );
+		checkErrors( stream->setMode( ( mode & ~ROLLOFF_MODES ) | FMOD_3D_CUSTOMROLLOFF ) );
+		checkErrors( stream->set3DCustomRolloff( sound.m_rolloff->getFmodPoints(), sound.m_rolloff->getFmodPointCount() ) );
+	}
+	return stream;
+}
+
+bool UAEImplementation::encodeSound( const std::string& sourcePath, const std::string& encodedPath )
+{
+	std::vector< float > samples;
+	int channels = 0;
+	float frequency = 0.f;
+	if ( !decodeSoundFile( sourcePath, samples, channels, frequency ) )
+	{
+		return false;
+	}
+	std::vector< int16_t > pcm( samples.size() );
+	for ( size_t i = 0; i < samples.size(); ++i )
+	{
+		pcm[i] = int16_t( std::clamp( std::lrint( samples[i] * 32768.f ), -32768l, 32767l ) );
+	}
+	const std::vector< uint8_t > encoded = UAdpcmCodec::encode( pcm, channels, int( frequency ) );
+	if ( encoded.empty() )
+	{
+		return false;
+	}
+	std::ofstream file( encodedPath, std::ios::binary );
+	file.write( reinterpret_cast< const char* >( encoded.data() ), std::streamsize( encoded.size() ) );
+	return bool( file );
+}
+
+void UAEImplementation::loadSoundLod( const USound& sound, USound::Lod& lod )
+{
+	if ( lod.fmodSound != nullptr )
+	{
+		return;
+	}
+	// A variant that fails to load leaves its level to the closer one.
+	if ( checkErrors( system->createSound( lod.path.c_str(), soundMode( sound ), nullptr, &lod.fmodSound ) ) )
+	{
+		lod.fmodSound = nullptr;
+		return;
+	}
+	checkErrors( lod.fmodSound->set3DMinMaxDistance( sound.minDistance, sound.maxDistance ) );
+}
+
+bool UAEImplementation::isBeyondEffectsLod( const USound& sound, const float vPosition[3] ) const
+{
+	return sound.effectsLodDistance > 0.f &&
+		   distanceToListenerSquared( vPosition ) > sound.effectsLodDistance * sound.effectsLodDistance;
+}
+
+const URolloffCurve* UAEImplementation::bakeRolloff( std::span< const URolloffPoint > points )
+{
+	auto curve = URolloffCurve::bake( points );
+	if ( curve == nullptr )
+	{
+		return nullptr;
+	}
+	rolloffCurves.push_back( std::move( curve ) );
+	return rolloffCurves.back().get();
+}
+
+void UAEImplementation::applyRolloff( const int soundId, USound& sound )
+{
+	const URolloffCurve* rolloff = sound.rolloff;
+	for ( const UBus* bus = findBus( sound.busId ); rolloff == nullptr && bus != nullptr; bus = bus->parent )
+	{
+		rolloff = bus->rolloff;
+	}
+	sound.m_rolloff = sound.is3d ? rolloff : nullptr;
+	if ( !sound.is3d )
+	{
+		return;
+	}
+
+	const FMOD_MODE rolloffMode = sound.m_rolloff != nullptr ? FMOD_3D_CUSTOMROLLOFF : FMOD_3D_INVERSEROLLOFF;
+	FMOD_VECTOR* points = sound.m_rolloff != nullptr ? sound.m_rolloff->getFmodPoints() : nullptr;
+	const int pointCount = sound.m_rolloff != nullptr ? sound.m_rolloff->getFmodPointCount() : 0;
+	FMOD_MODE mode = 0;
+	auto applyToSound = [&]( ::FMOD::Sound* fmodSound )
+	{
+		checkErrors( fmodSound->getMode( &mode ) );
+		checkErrors( fmodSound->setMode( ( mode & ~ROLLOFF_MODES ) | rolloffMode ) );
+		checkErrors( fmodSound->set3DCustomRolloff( points, pointCount ) );
+	};
+	// Encoded sounds past the resident size only have per channel streams.
+	if ( sound.m_fmodSound != nullptr )
+	{
+		applyToSound( sound.m_fmodSound );
+	}
+	for ( const USound::Lod& lod : sound.lods )
+	{
+		if ( lod.fmodSound != nullptr )
+		{
+			applyToSound( lod.fmodSound );
+		}
+	}
+	// Playing channels took the rolloff of the sound when they started. None
+	// may keep pointing at the previous curve, it can be released next.
+	for ( auto& [channelId, channel] : channels )
+	{
+		if ( channel->m_soundId != soundId || channel->m_fmodChannel == nullptr )
+		{
+			continue;
+		}
+		checkErrors( channel->m_fmodChannel->getMode( &mode ) );
+		checkErrors( channel->m_fmodChannel->setMode( ( mode & ~ROLLOFF_MODES ) | rolloffMode ) );
+		checkErrors( channel->m_fmodChannel->set3DCustomRolloff( points, pointCount ) );
+		if ( channel->m_fmodStream != nullptr )
+		{
+			applyToSound( channel->m_fmodStream );
+		}
+		// A variant fading out after a LOD switch, the handle may be stale.
+		if ( channel->m_previousFmodChannel != nullptr && channel->m_previousFmodChannel->getMode( &mode ) == FMOD_OK )
+		{
+			channel->m_previousFmodChannel->setMode( ( mode & ~ROLLOFF_MODES ) | rolloffMode );
+			channel->m_previousFmodChannel->set3DCustomRolloff( points, pointCount );
+		}
+		if ( channel->m_previousFmodStream != nullptr )
+		{
+			applyToSound( channel->m_previousFmodStream );
+		}
+	}
+}
+
+void UAEImplementation::releaseUnusedRolloffs()
+{
+	auto isUsed = [&]( const URolloffCurve* curve )
+	{
+		for ( const auto& [soundId, sound] : sounds )
+		{
+			if ( sound->rolloff == curve || sound->m_rolloff == curve )
+			{
+				return true;
+			}
+		}
+		for ( const auto& [busId, bus] : buses )
+		{
+			if ( bus->rolloff == curve )
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+	std::erase_if( rolloffCurves, [&]( const std::shared_ptr< const URolloffCurve >& curve ) { return !isUsed( curve.get() ); } );
+}
+
+float UAEImplementation::getAudibleRange( const USound& sound ) const
+{
+	if ( !sound.is3d )
+	{
+		return 0.f;
+	}
+	return sound.m_rolloff != nullptr ? sound.m_rolloff->getRange() : sound.maxDistance;
+}
+
+void UAEImplementation::updateAudibleRadius()
+{
+	// Rebuilt from the sounds, a replaced curve may have been the longest.
+	audibleRadius = 0.f;
+	for ( const auto& [soundId, sound] : sounds )
+	{
+		audibleRadius = std::max( audibleRadius, getAudibleRange( *sound ) );
 	}
 }
 
@@ -136,9 +1021,29 @@ void UAEImplementation::unloadSound( const int soundId )
 		return;
 	}
 	const auto& uSound = tFoundIt->second;
+	if ( !uSound->m_encoded.empty() )
+	{
+		// Channel streams read the encoded data in place.
+		for ( auto& [channelId, channel] : channels )
+		{
+			if ( channel->m_soundId == soundId )
+			{
+				channel->releaseStream();
+			}
+		}
+		std::vector< uint8_t >().swap( uSound->m_encoded );
+	}
 	if ( uSound->m_fmodSound != nullptr )
 	{
 		checkErrors( uSound->m_fmodSound->release() );
 	}
 	uSound->m_fmodSound = nullptr;
+	for ( USound::Lod& lod : uSound->lods )
+	{
+		if ( lod.fmodSound != nullptr )
+		{
+			checkErrors( lod.fmodSound->release() );
+		}
+		lod.fmodSound = nullptr;
+	}
 }
@@ -6,15 +6,32 @@
 
 #pragma once
 
-#include "UAudioFader.h"
+#include "UAdpcmCodec.h"
+#include "UBus.h"
 #include "UChannel.h"
+#include "UConvolutionReverb.h"
+#include "UDecibel.h"
+#include "UDucker.h"
+#include "UEmitterClusterer.h"
+#include "UFaderBank.h"
+#include "UGeometryManager.h"
+#include "UHdrMixer.h"
+#include "UHrtfSpatializer.h"
+#include "UOcclusionManager.h"
+#include "UReverbZoneManager.h"
+#include "URoomGraph.h"
 #include "USound.h"
+#include "USpatialGrid.h"
+#include "UVelocityTracker.h"
+#include "UVoiceManager.h"
 
 #include <fmod/fmod.hpp>
 
 #include <map>
+#include <unordered_set>
 #include <vector>
 #include <memory>
+#include <span>
 #include <iostream>
 #include <cmath>
 
@@ -25,23 +42,80 @@ struct UChannel;
 class UAEImplementation
 {
 public:
-	UAEImplementation();
+	explicit UAEImplementation( const int maxVoices );
 	~UAEImplementation();
 
 	void update( const float fTimeDeltaSeconds );
+	void applyFades( const float dt );
+	void applyMotion( const float dt );
 
 	bool soundIsLoaded( const int soundId );
+	USound* findLoadedSound( const int soundId );
 	void loadSound( const int soundId, const void* data = nullptr, const size_t dataSize = 0 );
 	void unloadSound( const int soundId );
+	// Keeps the data of long ADPCM sounds, binary data or .uad files, in
+	// memory. Returns false for anything else.
+	bool loadEncoded( USound& sound, const void* data, const size_t dataSize );
+	// Every channel of an encoded sound streams it on its own.
+	::FMOD::Sound* openEncodedStream( const USound& sound );
+	void loadSoundLod( const USound& sound, USound::Lod& lod );
+	bool isBeyondEffectsLod( const USound& sound, const float vPosition[3] ) const;
+	// FMOD reads baked curves in place, they are kept while a sound or a bus
+	// refers to them.
+	const URolloffCurve* bakeRolloff( std::span< const URolloffPoint > points );
+	void applyRolloff( const int soundId, USound& sound );
+	// Once every sound had its rolloff applied again.
+	void releaseUnusedRolloffs();
+	float getAudibleRange( const USound& sound ) const;
+	void updateAudibleRadius();
+
+	void setNumListeners( const int count );
+	void setListener( const int index, const float vPosition[3], const float vLook[3], const float vUp[3] );
+	const float* closestListener( const float vPosition[3] ) const;
+	float distanceToListenerSquared( const float vPosition[3] ) const;
+	float distanceGain( const USound& sound, const float vPosition[3] ) const;
+	float estimateAudibility( const USound& sound, const float vPosition[3], const float fVolumedB );
+	bool isAudible( const USound& sound, const float vPosition[3], const float fVolumedB );
+	// As heard through the room graph: at the apparent position and scaled by
+	// the propagation gain, which are the plain ones until it propagated.
+	float estimateAudibility( const USound& sound, const UChannel& channel );
+	bool isAudible( const USound& sound, const UChannel& channel );
+	UChannel* createChannel( const int channelId,
+							 const int soundId,
+							 const USound& sound,
+							 const float vPosition[3],
+							 const float fVolumedB,
+							 const bool isAdmitted = false );
+	// isAdmitted skips the voice manager for requests of a batch that was
+	// admitted as a whole.
+	UChannel* requestChannel( const int channelId,
+							  const int soundId,
+							  USound& sound,
+							  const float vPosition[3],
+							  const float fVolumedB,
+							  const bool isAdmitted = false );
+	void reserveChannels( const size_t count );
+	void setChannelDormant( UChannel& channel, const bool dormant );
+
+	int createBus( const std::string& name, const int parentBusId );
+	UBus* findBus( const int busId );
+	void stopBus( const int busId );
+	void releaseStoppedBuses();
+
+	// Whole file decoded to interleaved samples.
+	bool decodeSoundFile( const std::string& path, std::vector< float >& samples, int& channels, float& frequency );
+	bool encodeSound( const std::string& sourcePath, const std::string& encodedPath );
+	int loadImpulseResponse( const std::string& path );
+	int addImpulseResponse( std::shared_ptr< const UImpulseResponse > impulseResponse );
 
 	float dBToVolume( const float dB )
 	{
-		return std::pow( 10.0f, 0.05f * dB );
+		return decibel::toVolume( dB );
 	}
 
 	float volumeTodB( const float volume )
 	{
-		return 20.0f * std::log10( volume );
+		return decibel::todB( volume );
 	}
 
 public:
@@ -49,8 +123,72 @@ public:
 
 	std::map< int, std::unique_ptr< USound > > sounds;
 	std::map< int, std::unique_ptr< UChannel > > channels;
+	std::map< int, std::unique_ptr< UBus > > buses;
+	std::map< int, std::unique_ptr< UDucker > > duckers;
+	std::unique_ptr< UHrtfSpatializer > hrtfSpatializer;
+	std::unique_ptr< UGeometryManager > geometryManager;
+	std::unique_ptr< UReverbZoneManager > reverbZoneManager;
+	std::map< int, std::shared_ptr< const UImpulseResponse > > impulseResponses;
+	std::vector< std::shared_ptr< const URolloffCurve > > rolloffCurves;
+	unsigned int convolutionReverbPlugin;
+	unsigned int adpcmCodecPlugin;
+
+	struct BusStop
+	{
+		int busId;
+		unsigned int serial;
+	};
+	std::vector< BusStop > pendingBusStops;
+	unsigned int busStopSerial;
+
+	UVoiceManager voiceManager;
+	UFaderBank faderBank;
+	UVelocityTracker velocityTracker;
+	UDopplerSettings dopplerSettings;
+	UFadeMode fadeMode;
+	int sampleRate;
+	struct Listener
+	{
+		float position[3];
+		float forward[3];
+		float up[3];
+		float velocity[3];
+		float previousPosition[3];
+		bool dirty;
+	};
+	// Listener 0 is the primary one: reverb zones, rooms and HRTF follow it,
+	// audibility and occlusion use the listener closest to each emitter.
+	Listener listeners[MAX_LISTENERS];
+	int numListeners;
+	float audibilityThreshold;
+
+	USpatialGrid emitterGrid;
+	UEmitterClusterer clusterer;
+	UOcclusionManager occlusionManager;
+	URoomGraph roomGraph;
+	UHdrMixer hdrMixer;
+	std::vector< int > nearbyChannels;
+	float audibleRadius;
+	std::unordered_set< int > awakeChannels;
+	std::vector< int > updatedChannels;
+
+	struct FrameStart
+	{
+		int soundId;
+		int channelId;
+		float position[3];
+		float energy;
+	};
+	std::vector< FrameStart > frameStarts;
+	// Scratch storage of playSounds.
+	std::vector< USound* > batchSounds;
+	std::vector< UChannel* > batchChannels;
+	double clock;
 
 	int nextChannelId;
 	int nextSoundId;
+	int nextBusId;
+	int nextDuckerId;
+	int nextImpulseResponseId;
 };
 }
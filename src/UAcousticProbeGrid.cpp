@@ -0,0 +1,350 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UAcousticProbeGrid.cpp                                                    //
+// ========================================================================= //
+
+#include "UAcousticProbeGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+using univer::audio::UAcousticProbeGrid;
+using univer::audio::UGeometryPolygon;
+using univer::audio::UOcclusion;
+
+namespace
+{
+// Free distances are stored in eighths of the spacing. The largest value
+// means nothing was hit within range.
+constexpr float DISTANCE_STEPS_PER_CELL = 8.f;
+constexpr uint8_t OPEN_DISTANCE = 255;
+// Directions are binned by rounding each component of the unit vector, with
+// this threshold (cos 67.5 degrees) splitting the 3x3x3 neighbourhood evenly.
+constexpr float BIN_THRESHOLD = 0.38268343f;
+// Probes beyond this many dimensions would not fit the probe index.
+constexpr uint32_t MAX_PROBES = 1u << 26;
+
+struct Triangle
+{
+	float origin[3];
+	float edge1[3];
+	float edge2[3];
+	float directOcclusion;
+	float reverbOcclusion;
+};
+
+int toBin( const float component, const float length )
+{
+	return component > BIN_THRESHOLD * length ? 1 : ( component < -BIN_THRESHOLD * length ? -1 : 0 );
+}
+
+size_t directionIndex( const float x, const float y, const float z )
+{
+	const float length = std::sqrt( x * x + y * y + z * z );
+	const size_t cell = size_t( ( toBin( x, length ) + 1 ) * 9 + ( toBin( y, length ) + 1 ) * 3 + toBin( z, length ) + 1 );
+	// Cell 13 is the center of the neighbourhood and has no direction.
+	return cell < 13 ? cell : cell - 1;
+}
+
+void cross( const float a[3], const float b[3], float out[3] )
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+float dot( const float a[3], const float b[3] )
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Moller-Trumbore, both faces count. Returns the ray parameter or a negative
+// value on a miss.
+float intersect( const Triangle& triangle, const float origin[3], const float direction[3] )
+{
+	float p[3];
+	cross( direction, triangle.edge2, p );
+	const float determinant = dot( triangle.edge1, p );
+	if ( std::abs( determinant ) < 1e-8f )
+	{
+		return -1.f;
+	}
+	const float inverse = 1.f / determinant;
+	const float t[3] = { origin[0] - triangle.origin[0], origin[1] - triangle.origin[1], origin[2] - triangle.origin[2] };
+	const float u = dot( t, p ) * inverse;
+	if ( u < 0.f || u > 1.f )
+	{
+		return -1.f;
+	}
+	float q[3];
+	cross( t, triangle.edge1, q );
+	const float v = dot( direction, q ) * inverse;
+	if ( v < 0.f || u + v > 1.f )
+	{
+		return -1.f;
+	}
+	return dot( triangle.edge2, q ) * inverse;
+}
+
+uint8_t toByte( const float value )
+{
+	return uint8_t( std::clamp( value, 0.f, 1.f ) * 255.f + 0.5f );
+}
+
+template< typename T >
+bool readValue( std::ifstream& file, T& value )
+{
+	return static_cast< bool >( file.read( reinterpret_cast< char* >( &value ), sizeof( T ) ) );
+}
+
+template< typename T >
+void writeValue( std::ofstream& file, const T& value )
+{
+	file.write( reinterpret_cast< const char* >( &value ), sizeof( T ) );
+}
+}
+
+UAcousticProbeGrid::UAcousticProbeGrid( const uint32_t size[3], const float origin[3], const float spacing ) :
+	m_size{ size[0], size[1], size[2] },
+	m_origin{ origin[0], origin[1], origin[2] },
+	m_spacing( spacing ),
+	m_probes( size_t( size[0] ) * size[1] * size[2] * PROBE_BYTES, 0 )
+{}
+
+std::shared_ptr< UAcousticProbeGrid > UAcousticProbeGrid::bake( std::span< const float > vertices,
+															   std::span< const UGeometryPolygon > polygons,
+															   const float boundsMin[3],
+															   const float boundsMax[3],
+															   const float spacing )
+{
+	if ( spacing <= 0.f )
+	{
+		return nullptr;
+	}
+	uint32_t size[3];
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		if ( boundsMax[axis] < boundsMin[axis] )
+		{
+			return nullptr;
+		}
+		size[axis] = uint32_t( ( boundsMax[axis] - boundsMin[axis] ) / spacing ) + 1;
+	}
+	if ( uint64_t( size[0] ) * size[1] * size[2] > MAX_PROBES )
+	{
+		return nullptr;
+	}
+
+	// Polygons are convex, a fan from the first vertex covers them.
+	std::vector< Triangle > triangles;
+	size_t offset = 0;
+	for ( const UGeometryPolygon& polygon : polygons )
+	{
+		if ( polygon.vertexCount < 3 || vertices.size() < ( offset + size_t( polygon.vertexCount ) ) * 3 )
+		{
+			return nullptr;
+		}
+		const float* first = &vertices[offset * 3];
+		for ( int vertex = 1; vertex + 1 < polygon.vertexCount; ++vertex )
+		{
+			const float* b = &vertices[( offset + size_t( vertex ) ) * 3];
+			const float* c = b + 3;
+			triangles.push_back( { { first[0], first[1], first[2] },
+								   { b[0] - first[0], b[1] - first[1], b[2] - first[2] },
+								   { c[0] - first[0], c[1] - first[1], c[2] - first[2] },
+								   polygon.directOcclusion,
+								   polygon.reverbOcclusion } );
+		}
+		offset += size_t( polygon.vertexCount );
+	}
+
+	float directions[DIRECTION_COUNT][3];
+	for ( int x = -1; x <= 1; ++x )
+	{
+		for ( int y = -1; y <= 1; ++y )
+		{
+			for ( int z = -1; z <= 1; ++z )
+			{
+				if ( x == 0 && y == 0 && z == 0 )
+				{
+					continue;
+				}
+				const float length = std::sqrt( float( x * x + y * y + z * z ) );
+				float* direction = directions[directionIndex( float( x ), float( y ), float( z ) )];
+				direction[0] = float( x ) / length;
+				direction[1] = float( y ) / length;
+				direction[2] = float( z ) / length;
+			}
+		}
+	}
+
+	auto grid = std::make_shared< UAcousticProbeGrid >( size, boundsMin, spacing );
+	const float step = spacing / DISTANCE_STEPS_PER_CELL;
+	const float range = float( OPEN_DISTANCE - 1 ) * step;
+	uint8_t* probe = grid->m_probes.data();
+	for ( uint32_t z = 0; z < size[2]; ++z )
+	{
+		for ( uint32_t y = 0; y < size[1]; ++y )
+		{
+			for ( uint32_t x = 0; x < size[0]; ++x, probe += PROBE_BYTES )
+			{
+				const float position[3] = { boundsMin[0] + float( x ) * spacing,
+											boundsMin[1] + float( y ) * spacing,
+											boundsMin[2] + float( z ) * spacing };
+				size_t enclosed = 0;
+				for ( size_t direction = 0; direction < DIRECTION_COUNT; ++direction )
+				{
+					float nearest = range;
+					const Triangle* hit = nullptr;
+					for ( const Triangle& triangle : triangles )
+					{
+						const float t = intersect( triangle, position, directions[direction] );
+						if ( t >= 0.f && t < nearest )
+						{
+							nearest = t;
+							hit = &triangle;
+						}
+					}
+					uint8_t* record = probe + 1 + direction * 3;
+					if ( hit == nullptr )
+					{
+						record[0] = OPEN_DISTANCE;
+						continue;
+					}
+					++enclosed;
+					record[0] = uint8_t( std::min( nearest / step, float( OPEN_DISTANCE - 1 ) ) );
+					record[1] = toByte( hit->directOcclusion );
+					record[2] = toByte( hit->reverbOcclusion );
+				}
+				// The share of directions closed by geometry stands for how
+				// much of the sound comes back as reverb.
+				probe[0] = toByte( float( enclosed ) / float( DIRECTION_COUNT ) );
+			}
+		}
+	}
+	return grid;
+}
+
+std::shared_ptr< const UAcousticProbeGrid > UAcousticProbeGrid::load( const std::string& path )
+{
+	std::ifstream file( path, std::ios::binary );
+	char magic[4] = {};
+	uint32_t version = 0;
+	uint32_t size[3] = {};
+	float origin[3] = {};
+	float spacing = 0.f;
+	if ( !file.read( magic, sizeof( magic ) ) || std::memcmp( magic, "UAPG", sizeof( magic ) ) != 0 ||
+		 !readValue( file, version ) || version != 1 || !readValue( file, size ) || !readValue( file, origin ) ||
+		 !readValue( file, spacing ) || !( spacing > 0.f ) || size[0] == 0 || size[1] == 0 || size[2] == 0 ||
+		 uint64_t( size[0] ) * size[1] * size[2] > MAX_PROBES )
+	{
+		return nullptr;
+	}
+	auto grid = std::make_shared< UAcousticProbeGrid >( size, origin, spacing );
+	if ( !file.read( reinterpret_cast< char* >( grid->m_probes.data() ), std::streamsize( grid->m_probes.size() ) ) )
+	{
+		return nullptr;
+	}
+	return grid;
+}
+
+bool UAcousticProbeGrid::save( const std::string& path ) const
+{
+	std::ofstream file( path, std::ios::binary );
+	file.write( "UAPG", 4 );
+	writeValue( file, uint32_t( 1 ) );
+	writeValue( file, m_size );
+	writeValue( file, m_origin );
+	writeValue( file, m_spacing );
+	file.write( reinterpret_cast< const char* >( m_probes.data() ), std::streamsize( m_probes.size() ) );
+	return static_cast< bool >( file );
+}
+
+void UAcousticProbeGrid::findCorners( const float vPosition[3], Corners& corners ) const
+{
+	uint32_t base[3];
+	float fraction[3];
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		const float maximum = float( m_size[axis] - 1 );
+		const float cell = std::clamp( ( vPosition[axis] - m_origin[axis] ) / m_spacing, 0.f, maximum );
+		base[axis] = std::min( uint32_t( cell ), m_size[axis] > 1 ? m_size[axis] - 2 : 0 );
+		fraction[axis] = m_size[axis] > 1 ? cell - float( base[axis] ) : 0.f;
+	}
+	const size_t strideY = m_size[0];
+	const size_t strideZ = size_t( m_size[0] ) * m_size[1];
+	for ( int corner = 0; corner < 8; ++corner )
+	{
+		const int dx = corner & 1;
+		const int dy = ( corner >> 1 ) & 1;
+		const int dz = ( corner >> 2 ) & 1;
+		// Single probe thick grids reuse the same probe for both corners,
+		// where the fraction is always 0.
+		const size_t x = std::min< size_t >( base[0] + uint32_t( dx ), m_size[0] - 1 );
+		const size_t y = std::min< size_t >( base[1] + uint32_t( dy ), m_size[1] - 1 );
+		const size_t z = std::min< size_t >( base[2] + uint32_t( dz ), m_size[2] - 1 );
+		corners.probe[corner] = &m_probes[( x + y * strideY + z * strideZ ) * PROBE_BYTES];
+		corners.weight[corner] = ( dx ? fraction[0] : 1.f - fraction[0] ) *
+								 ( dy ? fraction[1] : 1.f - fraction[1] ) *
+								 ( dz ? fraction[2] : 1.f - fraction[2] );
+	}
+}
+
+UAcousticProbeGrid::Hit UAcousticProbeGrid::sampleDirection( const float vPosition[3], const size_t direction ) const
+{
+	Corners corners;
+	findCorners( vPosition, corners );
+	const float step = m_spacing / DISTANCE_STEPS_PER_CELL;
+	Hit hit = { 0.f, 0.f, 0.f };
+	for ( int corner = 0; corner < 8; ++corner )
+	{
+		const uint8_t* record = corners.probe[corner] + 1 + direction * 3;
+		const float weight = corners.weight[corner];
+		hit.freeDistance += float( record[0] ) * step * weight;
+		hit.directOcclusion += float( record[1] ) * weight;
+		hit.reverbOcclusion += float( record[2] ) * weight;
+	}
+	hit.directOcclusion *= 1.f / 255.f;
+	hit.reverbOcclusion *= 1.f / 255.f;
+	return hit;
+}
+
+UOcclusion UAcousticProbeGrid::sampleOcclusion( const float vListener[3], const float vEmitter[3] ) const
+{
+	const float delta[3] = { vEmitter[0] - vListener[0], vEmitter[1] - vListener[1], vEmitter[2] - vListener[2] };
+	const float distance = std::sqrt( dot( delta, delta ) );
+	UOcclusion result;
+	if ( distance <= 0.f )
+	{
+		return result;
+	}
+	// A wall is found from whichever end sees it first, the probes at each end
+	// only know their own surroundings. Blocking ramps in over one spacing past
+	// the free distance, which hides the direction binning.
+	const Hit fromListener = sampleDirection( vListener, directionIndex( delta[0], delta[1], delta[2] ) );
+	const Hit fromEmitter = sampleDirection( vEmitter, directionIndex( -delta[0], -delta[1], -delta[2] ) );
+	const float inverseSpacing = 1.f / m_spacing;
+	for ( const Hit& hit : { fromListener, fromEmitter } )
+	{
+		const float blocked = std::clamp( ( distance - hit.freeDistance ) * inverseSpacing, 0.f, 1.f );
+		result.obstruction = std::max( result.obstruction, blocked * hit.directOcclusion );
+		result.occlusion = std::max( result.occlusion, blocked * hit.reverbOcclusion );
+	}
+	return result;
+}
+
+float UAcousticProbeGrid::sampleReverbSend( const float vPosition[3] ) const
+{
+	Corners corners;
+	findCorners( vPosition, corners );
+	float send = 0.f;
+	for ( int corner = 0; corner < 8; ++corner )
+	{
+		send += float( corners.probe[corner][0] ) * corners.weight[corner];
+	}
+	return send * ( 1.f / 255.f );
+}
@@ -0,0 +1,82 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UAcousticProbeGrid.h                                                      //
+// ========================================================================= //
+
+#ifndef U_ACOUSTIC_PROBE_GRID_H_
+#define U_ACOUSTIC_PROBE_GRID_H_
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace univer::audio
+{
+// Acoustics baked offline on a regular grid of probes. Every probe stores a
+// reverb send, from 0 in the open to 1 fully enclosed, and for each of 26
+// directions the free distance to the first polygon hit with the occlusion
+// of that polygon. A query blends the 8 probes around a point, so sampling a
+// voice is a few byte reads instead of a raycast.
+//
+// The file form is a little endian blob:
+//   char magic[4] = "UAPG", uint32 version = 1, uint32 size[3],
+//   float origin[3], float spacing, then the probes x fastest, each
+//   PROBE_BYTES long: uint8 reverbSend, then per direction uint8 distance,
+//   uint8 directOcclusion, uint8 reverbOcclusion, then padding.
+class UAcousticProbeGrid
+{
+public:
+	static constexpr size_t DIRECTION_COUNT = 26;
+	static constexpr size_t PROBE_BYTES = 80;
+
+	UAcousticProbeGrid( const uint32_t size[3], const float origin[3], const float spacing );
+
+	// Casts DIRECTION_COUNT rays per probe against every polygon, so the cost
+	// grows with probes times polygons. Meant for tools, not for the game.
+	static std::shared_ptr< UAcousticProbeGrid > bake( std::span< const float > vertices,
+													   std::span< const UGeometryPolygon > polygons,
+													   const float boundsMin[3],
+													   const float boundsMax[3],
+													   const float spacing );
+	// Returns nullptr if the file is missing or malformed.
+	static std::shared_ptr< const UAcousticProbeGrid > load( const std::string& path );
+	bool save( const std::string& path ) const;
+
+	size_t getProbeCount() const { return m_probes.size() / PROBE_BYTES; }
+
+	// Obstruction and occlusion of the segment between both points, checked
+	// from both ends.
+	UOcclusion sampleOcclusion( const float vListener[3], const float vEmitter[3] ) const;
+	float sampleReverbSend( const float vPosition[3] ) const;
+
+private:
+	struct Corners
+	{
+		const uint8_t* probe[8];
+		float weight[8];
+	};
+
+	struct Hit
+	{
+		float freeDistance;
+		float directOcclusion;
+		float reverbOcclusion;
+	};
+
+	void findCorners( const float vPosition[3], Corners& corners ) const;
+	Hit sampleDirection( const float vPosition[3], const size_t direction ) const;
+
+	uint32_t m_size[3];
+	float m_origin[3];
+	float m_spacing;
+	std::vector< uint8_t > m_probes;
+};
+}
+
+#endif // U_ACOUSTIC_PROBE_GRID_H_
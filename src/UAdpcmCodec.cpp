@@ -0,0 +1,570 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UAdpcmCodec.cpp                                                           //
+// ========================================================================= //
+
+#include "UAdpcmCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define U_ADPCM_CODEC_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define U_ADPCM_CODEC_NEON
+#endif
+
+using univer::audio::UAdpcmCodec;
+
+namespace
+{
+constexpr uint8_t MAGIC[4] = { 'U', 'A', 'D', 'P' };
+constexpr uint8_t VERSION = 1;
+// Each channel of a block starts with the two source samples before it, the
+// predictor history.
+constexpr size_t HISTORY_BYTES = 4;
+// A byte with the shift and the predictor order, then two deltas per byte.
+constexpr size_t GROUP_BYTES = 1 + UAdpcmCodec::GROUP_SIZE / 2;
+constexpr size_t GROUPS_PER_BLOCK = UAdpcmCodec::BLOCK_FRAMES / UAdpcmCodec::GROUP_SIZE;
+constexpr size_t CHANNEL_BYTES = HISTORY_BYTES + GROUPS_PER_BLOCK * GROUP_BYTES;
+// A delta of -8 shifted by 12 spans the whole 16 bit range, so shift 12 with
+// no prediction can always encode a group.
+constexpr int MAX_SHIFT = 12;
+constexpr int MAX_ORDER = 2;
+
+static_assert( UAdpcmCodec::BLOCK_FRAMES % UAdpcmCodec::GROUP_SIZE == 0 );
+static_assert( UAdpcmCodec::GROUP_SIZE == 32, "the vectorized decoder unpacks groups of 32 deltas" );
+
+void writeU32( uint8_t* data, const uint32_t value )
+{
+	for ( int i = 0; i < 4; ++i )
+	{
+		data[i] = uint8_t( value >> ( 8 * i ) );
+	}
+}
+
+uint32_t readU32( const uint8_t* data )
+{
+	return uint32_t( data[0] ) | uint32_t( data[1] ) << 8 | uint32_t( data[2] ) << 16 | uint32_t( data[3] ) << 24;
+}
+
+int32_t clampSample( const int32_t sample )
+{
+	return std::clamp( sample, int32_t( std::numeric_limits< int16_t >::min() ), int32_t( std::numeric_limits< int16_t >::max() ) );
+}
+
+// Orders past MAX_ORDER only come from damaged data and decode as order 0.
+int32_t predict( const int order, const int32_t s1, const int32_t s2 )
+{
+	return order == 1 ? s1 : order == 2 ? 2 * s1 - s2 : 0;
+}
+
+// The history is clamped between groups so damaged data cannot overflow.
+void decodeGroupScalar( const uint8_t* group, int32_t history[2], int16_t* output )
+{
+	const int shift = group[0] & 0x0F;
+	const int order = group[0] >> 4;
+	int32_t s1 = history[0];
+	int32_t s2 = history[1];
+	for ( size_t i = 0; i < UAdpcmCodec::GROUP_SIZE; ++i )
+	{
+		const int nibble = ( group[1 + i / 2] >> ( ( i & 1 ) * 4 ) ) & 0x0F;
+		const int32_t sample = predict( order, s1, s2 ) + ( ( nibble ^ 8 ) - 8 ) * ( 1 << shift );
+		s2 = s1;
+		s1 = sample;
+		output[i] = int16_t( clampSample( sample ) );
+	}
+	history[0] = clampSample( s1 );
+	history[1] = clampSample( s2 );
+}
+
+#if defined( U_ADPCM_CODEC_SSE )
+// Running sum of the lanes plus the broadcast carry.
+__m128i prefixSum( __m128i x, const __m128i carry )
+{
+	x = _mm_add_epi32( x, _mm_slli_si128( x, 4 ) );
+	x = _mm_add_epi32( x, _mm_slli_si128( x, 8 ) );
+	return _mm_add_epi32( x, carry );
+}
+
+void decodeGroupSimd( const uint8_t* group, int32_t history[2], int16_t* output )
+{
+	const int order = group[0] >> 4;
+	const __m128i shift = _mm_cvtsi32_si128( group[0] & 0x0F );
+	const __m128i packed = _mm_loadu_si128( reinterpret_cast< const __m128i* >( group + 1 ) );
+	const __m128i mask = _mm_set1_epi8( 0x0F );
+	const __m128i bias = _mm_set1_epi8( 8 );
+	// Sign extended nibbles, then interleaved back into sample order.
+	const __m128i low = _mm_sub_epi8( _mm_xor_si128( _mm_and_si128( packed, mask ), bias ), bias );
+	const __m128i high = _mm_sub_epi8( _mm_xor_si128( _mm_and_si128( _mm_srli_epi16( packed, 4 ), mask ), bias ), bias );
+	const __m128i bytes[2] = { _mm_unpacklo_epi8( low, high ), _mm_unpackhi_epi8( low, high ) };
+	__m128i samples[8];
+	for ( int half = 0; half < 2; ++half )
+	{
+		const __m128i words[2] = { _mm_srai_epi16( _mm_unpacklo_epi8( bytes[half], bytes[half] ), 8 ),
+								   _mm_srai_epi16( _mm_unpackhi_epi8( bytes[half], bytes[half] ), 8 ) };
+		for ( int word = 0; word < 2; ++word )
+		{
+			samples[half * 4 + word * 2] = _mm_sll_epi32( _mm_srai_epi32( _mm_unpacklo_epi16( words[word], words[word] ), 16 ), shift );
+			samples[half * 4 + word * 2 + 1] = _mm_sll_epi32( _mm_srai_epi32( _mm_unpackhi_epi16( words[word], words[word] ), 16 ), shift );
+		}
+	}
+
+	if ( order == 1 )
+	{
+		__m128i carry = _mm_set1_epi32( history[0] );
+		for ( __m128i& x : samples )
+		{
+			x = prefixSum( x, carry );
+			carry = _mm_shuffle_epi32( x, 0xFF );
+		}
+	}
+	else if ( order == 2 )
+	{
+		// The deltas sum up to the slope, the slope to the samples.
+		__m128i slopeCarry = _mm_set1_epi32( history[0] - history[1] );
+		__m128i carry = _mm_set1_epi32( history[0] );
+		for ( __m128i& x : samples )
+		{
+			x = prefixSum( x, slopeCarry );
+			slopeCarry = _mm_shuffle_epi32( x, 0xFF );
+			x = prefixSum( x, carry );
+			carry = _mm_shuffle_epi32( x, 0xFF );
+		}
+	}
+
+	for ( int i = 0; i < 4; ++i )
+	{
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( output + i * 8 ), _mm_packs_epi32( samples[i * 2], samples[i * 2 + 1] ) );
+	}
+	alignas( 16 ) int32_t tail[4];
+	_mm_store_si128( reinterpret_cast< __m128i* >( tail ), samples[7] );
+	history[0] = clampSample( tail[3] );
+	history[1] = clampSample( tail[2] );
+}
+#elif defined( U_ADPCM_CODEC_NEON )
+// Running sum of the lanes plus the broadcast carry.
+int32x4_t prefixSum( int32x4_t x, const int32x4_t carry )
+{
+	const int32x4_t zero = vdupq_n_s32( 0 );
+	x = vaddq_s32( x, vextq_s32( zero, x, 3 ) );
+	x = vaddq_s32( x, vextq_s32( zero, x, 2 ) );
+	return vaddq_s32( x, carry );
+}
+
+void decodeGroupSimd( const uint8_t* group, int32_t history[2], int16_t* output )
+{
+	const int order = group[0] >> 4;
+	const int32x4_t shift = vdupq_n_s32( group[0] & 0x0F );
+	const int8x16_t packed = vreinterpretq_s8_u8( vld1q_u8( group + 1 ) );
+	// Sign extended nibbles, then interleaved back into sample order.
+	const int8x16x2_t bytes = vzipq_s8( vshrq_n_s8( vshlq_n_s8( packed, 4 ), 4 ), vshrq_n_s8( packed, 4 ) );
+	int32x4_t samples[8];
+	for ( int half = 0; half < 2; ++half )
+	{
+		const int16x8_t words[2] = { vmovl_s8( vget_low_s8( bytes.val[half] ) ), vmovl_s8( vget_high_s8( bytes.val[half] ) ) };
+		for ( int word = 0; word < 2; ++word )
+		{
+			samples[half * 4 + word * 2] = vshlq_s32( vmovl_s16( vget_low_s16( words[word] ) ), shift );
+			samples[half * 4 + word * 2 + 1] = vshlq_s32( vmovl_s16( vget_high_s16( words[word] ) ), shift );
+		}
+	}
+
+	if ( order == 1 )
+	{
+		int32x4_t carry = vdupq_n_s32( history[0] );
+		for ( int32x4_t& x : samples )
+		{
+			x = prefixSum( x, carry );
+			carry = vdupq_n_s32( vgetq_lane_s32( x, 3 ) );
+		}
+	}
+	else if ( order == 2 )
+	{
+		// The deltas sum up to the slope, the slope to the samples.
+		int32x4_t slopeCarry = vdupq_n_s32( history[0] - history[1] );
+		int32x4_t carry = vdupq_n_s32( history[0] );
+		for ( int32x4_t& x : samples )
+		{
+			x = prefixSum( x, slopeCarry );
+			slopeCarry = vdupq_n_s32( vgetq_lane_s32( x, 3 ) );
+			x = prefixSum( x, carry );
+			carry = vdupq_n_s32( vgetq_lane_s32( x, 3 ) );
+		}
+	}
+
+	for ( int i = 0; i < 4; ++i )
+	{
+		vst1q_s16( output + i * 8, vcombine_s16( vqmovn_s32( samples[i * 2] ), vqmovn_s32( samples[i * 2 + 1] ) ) );
+	}
+	history[0] = clampSample( vgetq_lane_s32( samples[7], 3 ) );
+	history[1] = clampSample( vgetq_lane_s32( samples[7], 2 ) );
+}
+#endif
+
+void decodeChannel( const uint8_t* data, int16_t* output, const bool allowSimd )
+{
+	int32_t history[2] = { int16_t( data[0] | data[1] << 8 ), int16_t( data[2] | data[3] << 8 ) };
+	const uint8_t* group = data + HISTORY_BYTES;
+	for ( size_t i = 0; i < GROUPS_PER_BLOCK; ++i, group += GROUP_BYTES, output += UAdpcmCodec::GROUP_SIZE )
+	{
+#if defined( U_ADPCM_CODEC_SSE ) || defined( U_ADPCM_CODEC_NEON )
+		if ( allowSimd )
+		{
+			decodeGroupSimd( group, history, output );
+			continue;
+		}
+#else
+		( void ) allowSimd;
+#endif
+		decodeGroupScalar( group, history, output );
+	}
+}
+
+// Squared error of the group with the given shift and order, or the maximum
+// once it reaches limit or leaves the 16 bit range. Writes the deltas and
+// moves the history forward when nibbles is given.
+int64_t quantizeGroup( const int32_t* target,
+					   int32_t history[2],
+					   const int order,
+					   const int shift,
+					   const int64_t limit,
+					   uint8_t* nibbles )
+{
+	const int32_t step = 1 << shift;
+	int32_t s1 = history[0];
+	int32_t s2 = history[1];
+	int64_t error = 0;
+	for ( size_t i = 0; i < UAdpcmCodec::GROUP_SIZE; ++i )
+	{
+		const int32_t prediction = predict( order, s1, s2 );
+		int32_t delta = std::clamp( ( target[i] - prediction + ( step >> 1 ) ) >> shift, -8, 7 );
+		int32_t sample = prediction + delta * step;
+		// The decoder does not clamp inside a group, the encoder has to stay
+		// in range.
+		while ( sample > std::numeric_limits< int16_t >::max() && delta > -8 )
+		{
+			--delta;
+			sample -= step;
+		}
+		while ( sample < std::numeric_limits< int16_t >::min() && delta < 7 )
+		{
+			++delta;
+			sample += step;
+		}
+		if ( sample != clampSample( sample ) )
+		{
+			return std::numeric_limits< int64_t >::max();
+		}
+		error += int64_t( target[i] - sample ) * int64_t( target[i] - sample );
+		if ( error >= limit )
+		{
+			return std::numeric_limits< int64_t >::max();
+		}
+		if ( nibbles != nullptr )
+		{
+			nibbles[i / 2] |= uint8_t( ( delta & 0x0F ) << ( ( i & 1 ) * 4 ) );
+		}
+		s2 = s1;
+		s1 = sample;
+	}
+	if ( nibbles != nullptr )
+	{
+		history[0] = s1;
+		history[1] = s2;
+	}
+	return error;
+}
+
+void encodeGroup( const int32_t* target, int32_t history[2], uint8_t* group )
+{
+	int64_t bestError = std::numeric_limits< int64_t >::max();
+	int bestOrder = 0;
+	int bestShift = MAX_SHIFT;
+	for ( int order = 0; order <= MAX_ORDER; ++order )
+	{
+		for ( int shift = 0; shift <= MAX_SHIFT; ++shift )
+		{
+			const int64_t error = quantizeGroup( target, history, order, shift, bestError, nullptr );
+			if ( error < bestError )
+			{
+				bestError = error;
+				bestOrder = order;
+				bestShift = shift;
+			}
+		}
+	}
+	group[0] = uint8_t( bestOrder << 4 | bestShift );
+	quantizeGroup( target, history, bestOrder, bestShift, std::numeric_limits< int64_t >::max(), group + 1 );
+}
+
+struct Instance
+{
+	UAdpcmCodec::Header header;
+	FMOD_CODEC_WAVEFORMAT waveFormat;
+	size_t blockBytes;
+	std::vector< uint8_t > encoded;
+	// The block a read stopped in, reads usually continue from it.
+	std::vector< int16_t > decoded;
+	uint32_t decodedBlock;
+	uint32_t position;
+};
+
+constexpr uint32_t NO_BLOCK = std::numeric_limits< uint32_t >::max();
+
+Instance* getInstance( FMOD_CODEC_STATE* codecState )
+{
+	return static_cast< Instance* >( codecState->plugindata );
+}
+
+FMOD_RESULT F_CALL open( FMOD_CODEC_STATE* codecState, FMOD_MODE, FMOD_CREATESOUNDEXINFO* )
+{
+	// Every file FMOD opens comes through here first, the header is the only
+	// read before rejecting it.
+	uint8_t bytes[UAdpcmCodec::HEADER_BYTES];
+	unsigned int bytesRead = 0;
+	UAdpcmCodec::Header header;
+	if ( FMOD_CODEC_FILE_READ( codecState, bytes, sizeof( bytes ), &bytesRead ) != FMOD_OK ||
+		 !UAdpcmCodec::readHeader( bytes, bytesRead, header ) )
+	{
+		return FMOD_ERR_FORMAT;
+	}
+	unsigned int fileSize = 0;
+	if ( FMOD_CODEC_FILE_SIZE( codecState, &fileSize ) != FMOD_OK || fileSize < UAdpcmCodec::getEncodedBytes( header ) )
+	{
+		return FMOD_ERR_FILE_BAD;
+	}
+
+	Instance* instance = new Instance();
+	instance->header = header;
+	instance->blockBytes = UAdpcmCodec::getBlockBytes( header.channels );
+	instance->encoded.resize( instance->blockBytes );
+	instance->decoded.resize( UAdpcmCodec::BLOCK_FRAMES * size_t( header.channels ) );
+	instance->decodedBlock = NO_BLOCK;
+	instance->position = 0;
+
+	FMOD_CODEC_WAVEFORMAT& waveFormat = instance->waveFormat;
+	std::memset( &waveFormat, 0, sizeof( waveFormat ) );
+	waveFormat.name = "univer adpcm";
+	waveFormat.format = FMOD_SOUND_FORMAT_PCM16;
+	waveFormat.channels = header.channels;
+	waveFormat.frequency = header.sampleRate;
+	waveFormat.lengthbytes = fileSize;
+	waveFormat.lengthpcm = header.frames;
+	waveFormat.pcmblocksize = UAdpcmCodec::BLOCK_FRAMES;
+	waveFormat.loopstart = 0;
+	waveFormat.loopend = header.frames > 0 ? int( header.frames - 1 ) : 0;
+	waveFormat.channelorder = FMOD_CHANNELORDER_DEFAULT;
+
+	codecState->plugindata = instance;
+	codecState->waveformat = &instance->waveFormat;
+	codecState->numsubsounds = 0;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL close( FMOD_CODEC_STATE* codecState )
+{
+	delete getInstance( codecState );
+	codecState->plugindata = nullptr;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL read( FMOD_CODEC_STATE* codecState, void* buffer, unsigned int samplesIn, unsigned int* samplesOut )
+{
+	Instance* instance = getInstance( codecState );
+	const size_t channels = size_t( instance->header.channels );
+	auto* output = static_cast< int16_t* >( buffer );
+	unsigned int done = 0;
+	while ( done < samplesIn && instance->position < instance->header.frames )
+	{
+		const uint32_t block = instance->position / UAdpcmCodec::BLOCK_FRAMES;
+		const uint32_t offset = instance->position % UAdpcmCodec::BLOCK_FRAMES;
+		const uint32_t count = std::min( { samplesIn - done,
+										   uint32_t( UAdpcmCodec::BLOCK_FRAMES ) - offset,
+										   instance->header.frames - instance->position } );
+		if ( block != instance->decodedBlock )
+		{
+			unsigned int bytesRead = 0;
+			FMOD_RESULT result = FMOD_CODEC_FILE_SEEK( codecState,
+													   unsigned( UAdpcmCodec::HEADER_BYTES + block * instance->blockBytes ),
+													   FMOD_CODEC_SEEK_METHOD_SET );
+			if ( result == FMOD_OK )
+			{
+				result = FMOD_CODEC_FILE_READ( codecState, instance->encoded.data(), unsigned( instance->blockBytes ), &bytesRead );
+			}
+			if ( bytesRead != instance->blockBytes )
+			{
+				*samplesOut = done;
+				return done > 0 ? FMOD_OK : ( result != FMOD_OK ? result : FMOD_ERR_FILE_BAD );
+			}
+			// Whole blocks skip the copy.
+			if ( count == UAdpcmCodec::BLOCK_FRAMES )
+			{
+				UAdpcmCodec::decodeBlock( instance->encoded.data(), instance->header.channels, output + done * channels );
+				done += count;
+				instance->position += count;
+				continue;
+			}
+			UAdpcmCodec::decodeBlock( instance->encoded.data(), instance->header.channels, instance->decoded.data() );
+			instance->decodedBlock = block;
+		}
+		std::memcpy( output + done * channels,
+					 instance->decoded.data() + offset * channels,
+					 count * channels * sizeof( int16_t ) );
+		done += count;
+		instance->position += count;
+	}
+	*samplesOut = done;
+	return done > 0 || samplesIn == 0 ? FMOD_OK : FMOD_ERR_FILE_EOF;
+}
+
+FMOD_RESULT F_CALL setPosition( FMOD_CODEC_STATE* codecState, int, unsigned int position, FMOD_TIMEUNIT postype )
+{
+	if ( postype != FMOD_TIMEUNIT_PCM )
+	{
+		return FMOD_ERR_FORMAT;
+	}
+	Instance* instance = getInstance( codecState );
+	instance->position = std::min( position, instance->header.frames );
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL getPosition( FMOD_CODEC_STATE* codecState, unsigned int* position, FMOD_TIMEUNIT postype )
+{
+	if ( postype != FMOD_TIMEUNIT_PCM )
+	{
+		return FMOD_ERR_FORMAT;
+	}
+	*position = getInstance( codecState )->position;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL getWaveFormat( FMOD_CODEC_STATE* codecState, int index, FMOD_CODEC_WAVEFORMAT* waveFormat )
+{
+	if ( index != 0 )
+	{
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	*waveFormat = getInstance( codecState )->waveFormat;
+	return FMOD_OK;
+}
+}
+
+FMOD_CODEC_DESCRIPTION* UAdpcmCodec::getDescription()
+{
+	static FMOD_CODEC_DESCRIPTION description = { FMOD_CODEC_PLUGIN_VERSION,
+												  "univer adpcm",
+												  1,
+												  0,
+												  FMOD_TIMEUNIT_PCM,
+												  &open,
+												  &close,
+												  &read,
+												  nullptr,
+												  &setPosition,
+												  &getPosition,
+												  nullptr,
+												  &getWaveFormat };
+	return &description;
+}
+
+size_t UAdpcmCodec::getBlockBytes( const int channels )
+{
+	return CHANNEL_BYTES * size_t( channels );
+}
+
+size_t UAdpcmCodec::getEncodedBytes( const Header& header )
+{
+	const size_t blocks = ( size_t( header.frames ) + BLOCK_FRAMES - 1 ) / BLOCK_FRAMES;
+	return HEADER_BYTES + blocks * getBlockBytes( header.channels );
+}
+
+bool UAdpcmCodec::readHeader( const void* data, const size_t size, Header& header )
+{
+	const auto* bytes = static_cast< const uint8_t* >( data );
+	if ( data == nullptr || size < HEADER_BYTES || std::memcmp( bytes, MAGIC, sizeof( MAGIC ) ) != 0 || bytes[4] != VERSION )
+	{
+		return false;
+	}
+	header.channels = bytes[5];
+	header.sampleRate = int( readU32( bytes + 8 ) );
+	header.frames = readU32( bytes + 12 );
+	return header.channels > 0 && header.channels <= MAX_CHANNELS && header.sampleRate > 0;
+}
+
+bool UAdpcmCodec::hasExtension( const std::string_view path )
+{
+	const std::string_view extension = FILE_EXTENSION;
+	return path.size() >= extension.size() && path.substr( path.size() - extension.size() ) == extension;
+}
+
+std::vector< uint8_t > UAdpcmCodec::encode( std::span< const int16_t > interleaved, const int channels, const int sampleRate )
+{
+	if ( channels <= 0 || channels > MAX_CHANNELS || sampleRate <= 0 ||
+		 interleaved.size() / size_t( channels ) > std::numeric_limits< uint32_t >::max() )
+	{
+		return {};
+	}
+	const Header header = { channels, sampleRate, uint32_t( interleaved.size() / size_t( channels ) ) };
+	std::vector< uint8_t > encoded( getEncodedBytes( header ), 0 );
+	std::memcpy( encoded.data(), MAGIC, sizeof( MAGIC ) );
+	encoded[4] = VERSION;
+	encoded[5] = uint8_t( channels );
+	writeU32( encoded.data() + 8, uint32_t( sampleRate ) );
+	writeU32( encoded.data() + 12, header.frames );
+
+	// Frames outside the sound read as silence, which pads the last block.
+	auto sampleAt = [&]( const int64_t frame, const int channel ) -> int32_t
+	{
+		return frame >= 0 && frame < int64_t( header.frames ) ? interleaved[size_t( frame ) * size_t( channels ) + size_t( channel )] : 0;
+	};
+
+	uint8_t* data = encoded.data() + HEADER_BYTES;
+	for ( int64_t blockStart = 0; blockStart < int64_t( header.frames ); blockStart += BLOCK_FRAMES )
+	{
+		for ( int channel = 0; channel < channels; ++channel, data += CHANNEL_BYTES )
+		{
+			// Blocks start from the source rather than from the previous
+			// block, so any of them decodes on its own.
+			int32_t history[2] = { sampleAt( blockStart - 1, channel ), sampleAt( blockStart - 2, channel ) };
+			for ( int i = 0; i < 2; ++i )
+			{
+				data[i * 2] = uint8_t( history[i] );
+				data[i * 2 + 1] = uint8_t( history[i] >> 8 );
+			}
+			uint8_t* group = data + HISTORY_BYTES;
+			int32_t target[GROUP_SIZE];
+			for ( size_t groupStart = 0; groupStart < BLOCK_FRAMES; groupStart += GROUP_SIZE, group += GROUP_BYTES )
+			{
+				for ( size_t i = 0; i < GROUP_SIZE; ++i )
+				{
+					target[i] = sampleAt( blockStart + int64_t( groupStart + i ), channel );
+				}
+				encodeGroup( target, history, group );
+			}
+		}
+	}
+	return encoded;
+}
+
+void UAdpcmCodec::decodeBlock( const uint8_t* block, const int channels, int16_t* interleaved, const bool allowSimd )
+{
+	if ( channels == 1 )
+	{
+		decodeChannel( block, interleaved, allowSimd );
+		return;
+	}
+	int16_t planar[BLOCK_FRAMES];
+	for ( int channel = 0; channel < channels; ++channel, block += CHANNEL_BYTES )
+	{
+		decodeChannel( block, planar, allowSimd );
+		for ( size_t frame = 0; frame < BLOCK_FRAMES; ++frame )
+		{
+			interleaved[frame * size_t( channels ) + size_t( channel )] = planar[frame];
+		}
+	}
+}
@@ -0,0 +1,58 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UAdpcmCodec.h                                                             //
+// ========================================================================= //
+
+#ifndef U_ADPCM_CODEC_H_
+#define U_ADPCM_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+// A 4 bit ADPCM format read through an FMOD codec plugin, about 3.7:1 over
+// 16 bit PCM. Audio is stored in blocks of BLOCK_FRAMES frames that decode on
+// their own, so seeking is a jump to a block. Inside a block each channel is
+// split in groups of GROUP_SIZE deltas sharing a shift and a predictor order.
+// The predictors are running sums of the deltas, so a group decodes with a
+// couple of vectorized prefix sums instead of a sample by sample loop.
+class UAdpcmCodec
+{
+public:
+	static constexpr size_t BLOCK_FRAMES = 1024;
+	static constexpr size_t GROUP_SIZE = 32;
+	static constexpr size_t HEADER_BYTES = 16;
+	static constexpr int MAX_CHANNELS = 8;
+	static constexpr const char* FILE_EXTENSION = ".uad";
+
+	struct Header
+	{
+		int channels;
+		int sampleRate;
+		uint32_t frames;
+	};
+
+	// FMOD takes the description as mutable, it is not changed.
+	static FMOD_CODEC_DESCRIPTION* getDescription();
+
+	static size_t getBlockBytes( const int channels );
+	static size_t getEncodedBytes( const Header& header );
+	static bool readHeader( const void* data, const size_t size, Header& header );
+	static bool hasExtension( const std::string_view path );
+
+	// Interleaved samples to a whole file, header included.
+	static std::vector< uint8_t > encode( std::span< const int16_t > interleaved, const int channels, const int sampleRate );
+	// One block to BLOCK_FRAMES interleaved frames, the last block of a file
+	// is padded with silence.
+	static void decodeBlock( const uint8_t* block, const int channels, int16_t* interleaved, const bool allowSimd = true );
+};
+}
+
+#endif // U_ADPCM_CODEC_H_
@@ -5,20 +5,39 @@
 // ========================================================================= //
 
 #include <univer_audio/UAudioEngine.h>
-#include "UAudioFader.h"
 #include "UAEImplementation.h"
 #include "UChannel.h"
+#include "UDecibel.h"
 #include "UAUtils.h"
 
+#include <algorithm>
+
 using univer::audio::UAudioEngine;
 using univer::audio::USound;
 using univer::audio::UAEImplementation;
+using univer::audio::UChannel;
+using univer::audio::UPlayRequest;
+using univer::audio::UStealPolicy;
+using univer::audio::UFadeMode;
+using univer::audio::UBus;
+using univer::audio::UBusEffect;
+using univer::audio::UDucker;
+using univer::audio::UConvolutionReverb;
+using univer::audio::UImpulseResponse;
+using univer::audio::UHrtfDataset;
+using univer::audio::URaycastCallback;
+using univer::audio::UOcclusionSettings;
+using univer::audio::UGeometryPolygon;
+using univer::audio::UReverbPreset;
+using univer::audio::UAcousticProbeGrid;
+using univer::audio::URolloffCurve;
+using univer::audio::URolloffPoint;
 
 static UAEImplementation* implementationPtr = nullptr;
 
-void UAudioEngine::init()
+void UAudioEngine::init( const int maxVoices )
 {
-	implementationPtr = new UAEImplementation();
+	implementationPtr = new UAEImplementation( maxVoices );
 }
 
 void UAudioEngine::update( const float dt )
@@ -50,6 +69,9 @@ int UAudioEngine::registerSound( const std::string name,
 																	 isLooping,
 																	 isStreaming,
 																	 useBinary );
+	implementationPtr->applyRolloff( soundId, *implementationPtr->sounds[soundId] );
+	implementationPtr->audibleRadius = std::max( implementationPtr->audibleRadius,
+												 implementationPtr->getAudibleRange( *implementationPtr->sounds[soundId] ) );
 
 	if ( load && !useBinary )
 	{
@@ -66,6 +88,8 @@ void UAudioEngine::unregisterSound( const int soundId )
 		unLoadSound( soundId );
 	}
 	implementationPtr->sounds.erase( soundId );
+	implementationPtr->releaseUnusedRolloffs();
+	implementationPtr->updateAudibleRadius();
 }
 
 void UAudioEngine::loadSound( const int soundId, const bool b3d, const bool bLooping, const bool bStream, const void* data, const size_t dataSize )
@@ -78,24 +102,602 @@ void UAudioEngine::unLoadSound( const int soundId )
 	implementationPtr->unloadSound( soundId );
 }
 
+bool UAudioEngine::encodeSound( const std::string& sourcePath, const std::string& encodedPath )
+{
+	return implementationPtr->encodeSound( sourcePath, encodedPath );
+}
+
+void UAudioEngine::setSoundPriority( const int soundId, const int priority )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->priority = std::clamp( priority, 0, 256 );
+}
+
+void UAudioEngine::setSoundMaxInstances( const int soundId, const int maxInstances, const UStealPolicy policy )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->maxInstances = std::max( maxInstances, 0 );
+	tFoundIt->second->stealPolicy = policy;
+}
+
+bool UAudioEngine::addSoundLod( const int soundId, const float distance, const std::string& path )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return false;
+	}
+	USound& sound = *tFoundIt->second;
+	auto tLodIt = std::upper_bound( sound.lods.begin(),
+									sound.lods.end(),
+									distance,
+									[]( const float value, const USound::Lod& lod ) { return value < lod.distance; } );
+	tLodIt = sound.lods.insert( tLodIt, { std::max( distance, 0.f ), path, nullptr } );
+	if ( sound.m_fmodSound != nullptr )
+	{
+		implementationPtr->loadSoundLod( sound, *tLodIt );
+		implementationPtr->applyRolloff( soundId, sound );
+	}
+	return true;
+}
+
+void UAudioEngine::setSoundEffectsLodDistance( const int soundId, const float distance )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->effectsLodDistance = std::max( distance, 0.f );
+}
+
+void UAudioEngine::setSoundLoudness( const int soundId, const float loudnessdB )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->loudnessdB = loudnessdB;
+}
+
+void UAudioEngine::setSoundBus( const int soundId, const int busId )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() || implementationPtr->findBus( busId ) == nullptr )
+	{
+		return;
+	}
+	tFoundIt->second->busId = busId;
+	implementationPtr->applyRolloff( soundId, *tFoundIt->second );
+	implementationPtr->updateAudibleRadius();
+}
+
+bool UAudioEngine::setSoundRolloff( const int soundId, std::span< const URolloffPoint > points )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return false;
+	}
+	const URolloffCurve* rolloff = nullptr;
+	if ( !points.empty() )
+	{
+		rolloff = implementationPtr->bakeRolloff( points );
+		if ( rolloff == nullptr )
+		{
+			return false;
+		}
+	}
+	tFoundIt->second->rolloff = rolloff;
+	implementationPtr->applyRolloff( soundId, *tFoundIt->second );
+	implementationPtr->releaseUnusedRolloffs();
+	implementationPtr->updateAudibleRadius();
+	return true;
+}
+
+bool UAudioEngine::setBusRolloff( const int busId, std::span< const URolloffPoint > points )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	if ( bus == nullptr )
+	{
+		return false;
+	}
+	const URolloffCurve* rolloff = nullptr;
+	if ( !points.empty() )
+	{
+		rolloff = implementationPtr->bakeRolloff( points );
+		if ( rolloff == nullptr )
+		{
+			return false;
+		}
+	}
+	bus->rolloff = rolloff;
+	for ( auto& [soundId, sound] : implementationPtr->sounds )
+	{
+		implementationPtr->applyRolloff( soundId, *sound );
+	}
+	implementationPtr->releaseUnusedRolloffs();
+	implementationPtr->updateAudibleRadius();
+	return true;
+}
+
+int UAudioEngine::createBus( const std::string& name, const int parentBusId )
+{
+	return implementationPtr->createBus( name, parentBusId );
+}
+
+int UAudioEngine::findBus( const std::string& name ) const
+{
+	for ( const auto& [busId, bus] : implementationPtr->buses )
+	{
+		if ( bus->name == name )
+		{
+			return busId;
+		}
+	}
+	return -1;
+}
+
+void UAudioEngine::setBusVolume( const int busId, const float fVolumedB )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	if ( bus == nullptr )
+	{
+		return;
+	}
+	bus->volume = dBToVolume( fVolumedB );
+	checkErrors( bus->m_fmodGroup->setVolume( bus->volume ) );
+}
+
+void UAudioEngine::setBusPaused( const int busId, const bool paused )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	if ( bus == nullptr )
+	{
+		return;
+	}
+	checkErrors( bus->m_fmodGroup->setPaused( paused ) );
+}
+
+void UAudioEngine::stopBus( const int busId )
+{
+	implementationPtr->stopBus( busId );
+}
+
+int UAudioEngine::addBusEffect( const int busId, const UBusEffect effect )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	if ( bus == nullptr )
+	{
+		return -1;
+	}
+	FMOD_DSP_TYPE type = FMOD_DSP_TYPE_UNKNOWN;
+	switch ( effect )
+	{
+		case UBusEffect::LOWPASS:
+			type = FMOD_DSP_TYPE_LOWPASS;
+			break;
+		case UBusEffect::HIGHPASS:
+			type = FMOD_DSP_TYPE_HIGHPASS;
+			break;
+		case UBusEffect::ECHO:
+			type = FMOD_DSP_TYPE_ECHO;
+			break;
+		case UBusEffect::REVERB:
+			type = FMOD_DSP_TYPE_SFXREVERB;
+			break;
+		case UBusEffect::COMPRESSOR:
+			type = FMOD_DSP_TYPE_COMPRESSOR;
+			break;
+		case UBusEffect::PARAMEQ:
+			type = FMOD_DSP_TYPE_PARAMEQ;
+			break;
+	}
+	::FMOD::DSP* dsp = nullptr;
+	if ( checkErrors( implementationPtr->system->createDSPByType( type, &dsp ) ) )
+	{
+		return -1;
+	}
+	const int effectId = bus->addEffect( dsp );
+	if ( effectId < 0 )
+	{
+		checkErrors( dsp->release() );
+	}
+	return effectId;
+}
+
+void UAudioEngine::setBusEffectParameter( const int busId, const int effectId, const int parameter, const float value )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	::FMOD::DSP* dsp = bus != nullptr ? bus->getEffect( effectId ) : nullptr;
+	if ( dsp == nullptr )
+	{
+		return;
+	}
+	checkErrors( dsp->setParameterFloat( parameter, value ) );
+}
+
+void UAudioEngine::setBusEffectBypass( const int busId, const int effectId, const bool bypass )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	::FMOD::DSP* dsp = bus != nullptr ? bus->getEffect( effectId ) : nullptr;
+	if ( dsp == nullptr )
+	{
+		return;
+	}
+	checkErrors( dsp->setBypass( bypass ) );
+}
+
+void UAudioEngine::removeBusEffect( const int busId, const int effectId )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	if ( bus == nullptr )
+	{
+		return;
+	}
+	bus->removeEffect( effectId );
+}
+
+int UAudioEngine::addBusDucking( const int sourceBusId,
+								 const int targetBusId,
+								 const float depthdB,
+								 const float thresholddB,
+								 const float attackSeconds,
+								 const float releaseSeconds )
+{
+	UBus* source = implementationPtr->findBus( sourceBusId );
+	UBus* target = implementationPtr->findBus( targetBusId );
+	if ( source == nullptr || target == nullptr || source == target )
+	{
+		return -1;
+	}
+	auto ducker = std::make_unique< UDucker >( implementationPtr->system,
+											   *source,
+											   *target,
+											   implementationPtr->sampleRate,
+											   depthdB,
+											   thresholddB,
+											   attackSeconds,
+											   releaseSeconds );
+	if ( !ducker->isValid() )
+	{
+		return -1;
+	}
+	const int duckingId = implementationPtr->nextDuckerId++;
+	implementationPtr->duckers[duckingId] = std::move( ducker );
+	return duckingId;
+}
+
+void UAudioEngine::removeBusDucking( const int duckingId )
+{
+	implementationPtr->duckers.erase( duckingId );
+}
+
+int UAudioEngine::loadImpulseResponse( const std::string& path )
+{
+	return implementationPtr->loadImpulseResponse( path );
+}
+
+int UAudioEngine::createImpulseResponse( std::span< const float > samples, const int channels )
+{
+	return implementationPtr->addImpulseResponse( UConvolutionReverb::createImpulseResponse( samples, channels ) );
+}
+
+void UAudioEngine::unloadImpulseResponse( const int impulseResponseId )
+{
+	implementationPtr->impulseResponses.erase( impulseResponseId );
+}
+
+int UAudioEngine::addBusConvolutionReverb( const int busId,
+										   const int impulseResponseId,
+										   const float wetdB,
+										   const float drydB )
+{
+	UBus* bus = implementationPtr->findBus( busId );
+	auto tImpulseIt = implementationPtr->impulseResponses.find( impulseResponseId );
+	if ( bus == nullptr || tImpulseIt == implementationPtr->impulseResponses.end() )
+	{
+		return -1;
+	}
+	::FMOD::DSP* dsp = nullptr;
+	if ( checkErrors( implementationPtr->system->createDSPByPlugin( implementationPtr->convolutionReverbPlugin, &dsp ) ) )
+	{
+		return -1;
+	}
+	checkErrors( dsp->setParameterFloat( UConvolutionReverb::WET, wetdB ) );
+	checkErrors( dsp->setParameterFloat( UConvolutionReverb::DRY, drydB ) );
+	std::shared_ptr< const UImpulseResponse > impulseResponse = tImpulseIt->second;
+	checkErrors( dsp->setParameterData( UConvolutionReverb::IMPULSE_RESPONSE, &impulseResponse, sizeof( impulseResponse ) ) );
+	const int effectId = bus->addEffect( dsp );
+	if ( effectId < 0 )
+	{
+		checkErrors( dsp->release() );
+	}
+	return effectId;
+}
+
+void UAudioEngine::setSoundClustering( const int soundId, const float minDistance, const float clusterSize )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->clusterDistance = minDistance;
+	tFoundIt->second->clusterSize = clusterSize;
+}
+
+void UAudioEngine::setSoundCoalescing( const int soundId, const float radius )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->coalesceRadius = std::max( radius, 0.f );
+}
+
+void UAudioEngine::setSoundCooldown( const int soundId, const float cooldownSeconds )
+{
+	auto tFoundIt = implementationPtr->sounds.find( soundId );
+	if ( tFoundIt == implementationPtr->sounds.end() )
+	{
+		return;
+	}
+	tFoundIt->second->retriggerCooldown = std::max( cooldownSeconds, 0.f );
+}
+
+void UAudioEngine::setVoiceStealPolicy( const UStealPolicy policy )
+{
+	implementationPtr->voiceManager.setStealPolicy( policy );
+}
+
 int UAudioEngine::playSound( const int soundId, const float vPosition[3], const float fVolumedB )
 {
 	int channelId = implementationPtr->nextChannelId++;
-	// auto tSoundIt = implementationPtr->sounds.find( soundId );
-	if ( !implementationPtr->soundIsLoaded( soundId ) )
+	USound* sound = implementationPtr->findLoadedSound( soundId );
+	if ( sound == nullptr )
 	{
-		loadSound( soundId );
-		if ( !implementationPtr->soundIsLoaded( soundId ) )
+		return channelId;
+	}
+	UChannel* channel = implementationPtr->requestChannel( channelId, soundId, *sound, vPosition, fVolumedB );
+	if ( channel == nullptr )
+	{
+		return channelId;
+	}
+	// A coalesced request hands back the voice it was merged into.
+	if ( channel->m_channelId == channelId && channel->m_hasVoice )
+	{
+		channel->update();
+	}
+	return channel->m_channelId;
+}
+
+int UAudioEngine::playSounds( std::span< const UPlayRequest > requests )
+{
+	const int firstChannelId = implementationPtr->nextChannelId;
+	implementationPtr->nextChannelId += static_cast< int >( requests.size() );
+
+	// Bursts usually repeat the same few sounds, so the last lookup is reused.
+	std::vector< USound* >& sounds = implementationPtr->batchSounds;
+	sounds.clear();
+	bool hasInstanceLimit = false;
+	for ( size_t i = 0; i < requests.size(); ++i )
+	{
+		if ( i == 0 || requests[i].soundId != requests[i - 1].soundId )
+		{
+			sounds.push_back( implementationPtr->findLoadedSound( requests[i].soundId ) );
+		}
+		else
+		{
+			sounds.push_back( sounds.back() );
+		}
+		hasInstanceLimit |= sounds.back() != nullptr && sounds.back()->maxInstances > 0;
+	}
+
+	// A batch that fits in the free voices is admitted once, nothing has to
+	// be stolen for it. Otherwise every request goes through the voice
+	// manager, and may evict a voice of an earlier request.
+	const bool isAdmitted = !hasInstanceLimit && size_t( implementationPtr->voiceManager.getFreeVoices() ) >= requests.size();
+	implementationPtr->reserveChannels( requests.size() );
+	std::vector< UChannel* >& startedChannels = implementationPtr->batchChannels;
+	startedChannels.clear();
+	for ( size_t i = 0; i < requests.size(); ++i )
+	{
+		if ( sounds[i] == nullptr )
+		{
+			continue;
+		}
+		const UPlayRequest& request = requests[i];
+		const int channelId = firstChannelId + static_cast< int >( i );
+		UChannel* channel = implementationPtr->requestChannel( channelId,
+															   request.soundId,
+															   *sounds[i],
+															   request.position,
+															   request.volumedB,
+															   isAdmitted );
+		if ( channel != nullptr && channel->m_channelId == channelId && channel->m_hasVoice )
 		{
-			return channelId;
+			startedChannels.push_back( channel );
 		}
 	}
-	implementationPtr->channels[channelId] = std::make_unique< UChannel >( *implementationPtr,
-																			soundId,
-																			vPosition,
-																			fVolumedB );
-	implementationPtr->channels[channelId]->update( 0.f );
-	return channelId;
+
+	// The mixer cannot run while the DSP is locked, so the voices are started
+	// unpaused and set up in one go, and all of them begin on the same block.
+	checkErrors( implementationPtr->system->lockDSP() );
+	for ( UChannel* channel : startedChannels )
+	{
+		// Voices evicted by a later request of the same batch are not started.
+		if ( channel->m_hasVoice && !channel->m_stopRequested )
+		{
+			channel->start( *sounds[channel->m_channelId - firstChannelId], false );
+		}
+	}
+	checkErrors( implementationPtr->system->unlockDSP() );
+
+	return firstChannelId;
+}
+
+bool UAudioEngine::loadHrtfDataset( const std::string& path )
+{
+	auto dataset = UHrtfDataset::load( path, implementationPtr->sampleRate );
+	if ( dataset == nullptr )
+	{
+		return false;
+	}
+	implementationPtr->hrtfSpatializer->setDataset( std::move( dataset ) );
+	return true;
+}
+
+bool UAudioEngine::createHrtfDataset( std::span< const float > directions, std::span< const float > hrirs, const int hrirLength )
+{
+	if ( hrirLength <= 0 || directions.size() < 2 || hrirs.size() < size_t( hrirLength ) * 2 )
+	{
+		return false;
+	}
+	implementationPtr->hrtfSpatializer->setDataset( std::make_shared< const UHrtfDataset >( directions, hrirs, size_t( hrirLength ) ) );
+	return true;
+}
+
+void UAudioEngine::setHrtfVoiceBudget( const int voices )
+{
+	implementationPtr->hrtfSpatializer->setVoiceBudget( voices );
+}
+
+bool UAudioEngine::isBinaural( const int channelId ) const
+{
+	auto tFoundIt = implementationPtr->channels.find( channelId );
+	if ( tFoundIt == implementationPtr->channels.end() )
+	{
+		return false;
+	}
+	return tFoundIt->second->m_isBinaural;
+}
+
+void UAudioEngine::setOcclusionCallback( URaycastCallback callback )
+{
+	implementationPtr->occlusionManager.setCallback( std::move( callback ) );
+}
+
+void UAudioEngine::setOcclusionSettings( const UOcclusionSettings& settings )
+{
+	implementationPtr->occlusionManager.setSettings( settings );
+}
+
+bool UAudioEngine::bakeAcousticProbes( std::span< const float > vertices,
+									  std::span< const UGeometryPolygon > polygons,
+									  const float vBoundsMin[3],
+									  const float vBoundsMax[3],
+									  const float spacing,
+									  const std::string& path )
+{
+	auto grid = UAcousticProbeGrid::bake( vertices, polygons, vBoundsMin, vBoundsMax, spacing );
+	return grid != nullptr && grid->save( path );
+}
+
+bool UAudioEngine::loadAcousticProbes( const std::string& path )
+{
+	auto grid = UAcousticProbeGrid::load( path );
+	if ( grid == nullptr )
+	{
+		return false;
+	}
+	implementationPtr->occlusionManager.setProbeGrid( std::move( grid ) );
+	return true;
+}
+
+void UAudioEngine::unloadAcousticProbes()
+{
+	implementationPtr->occlusionManager.setProbeGrid( nullptr );
+}
+
+int UAudioEngine::addAcousticRoom( const float vMin[3], const float vMax[3] )
+{
+	return implementationPtr->roomGraph.addRoom( vMin, vMax );
+}
+
+void UAudioEngine::removeAcousticRoom( const int roomId )
+{
+	implementationPtr->roomGraph.removeRoom( roomId );
+}
+
+int UAudioEngine::addAcousticPortal( const int roomA, const int roomB, const float vPosition[3], const float openness )
+{
+	return implementationPtr->roomGraph.addPortal( roomA, roomB, vPosition, openness );
+}
+
+void UAudioEngine::removeAcousticPortal( const int portalId )
+{
+	implementationPtr->roomGraph.removePortal( portalId );
+}
+
+void UAudioEngine::setAcousticPortalOpenness( const int portalId, const float openness )
+{
+	implementationPtr->roomGraph.setPortalOpenness( portalId, openness );
+}
+
+void UAudioEngine::setAcousticWallTransmission( const float transmissiondB )
+{
+	implementationPtr->roomGraph.setWallTransmission( implementationPtr->dBToVolume( transmissiondB ) );
+}
+
+int UAudioEngine::addGeometryChunk( std::span< const float > vertices, std::span< const UGeometryPolygon > polygons )
+{
+	return implementationPtr->geometryManager->addChunk( vertices, polygons );
+}
+
+int UAudioEngine::loadGeometryChunk( const std::string& path )
+{
+	return implementationPtr->geometryManager->loadChunk( path );
+}
+
+bool UAudioEngine::saveGeometryChunk( const int chunkId, const std::string& path )
+{
+	return implementationPtr->geometryManager->saveChunk( chunkId, path );
+}
+
+void UAudioEngine::removeGeometryChunk( const int chunkId )
+{
+	implementationPtr->geometryManager->removeChunk( chunkId );
+}
+
+void UAudioEngine::setGeometryStreamingRadius( const float radius )
+{
+	implementationPtr->geometryManager->setStreamingRadius( radius );
+}
+
+bool UAudioEngine::isGeometryChunkLoaded( const int chunkId ) const
+{
+	return implementationPtr->geometryManager->isLoaded( chunkId );
+}
+
+int UAudioEngine::addReverbZone( const float vCenter[3], const float minDistance, const float maxDistance, const UReverbPreset preset )
+{
+	return implementationPtr->reverbZoneManager->addZone( vCenter, minDistance, maxDistance, preset );
+}
+
+void UAudioEngine::setReverbZonePreset( const int zoneId, const UReverbPreset preset )
+{
+	implementationPtr->reverbZoneManager->setZonePreset( zoneId, preset );
+}
+
+void UAudioEngine::removeReverbZone( const int zoneId )
+{
+	implementationPtr->reverbZoneManager->removeZone( zoneId );
+}
+
+void UAudioEngine::setAmbientReverb( const UReverbPreset preset )
+{
+	implementationPtr->reverbZoneManager->setAmbient( preset );
 }
 
 void UAudioEngine::setChannel3dPosition( const int channelId, const float vPosition[3] )
@@ -106,9 +708,7 @@ void UAudioEngine::setChannel3dPosition( const int channelId, const float vPosit
 		return;
 	}
 
-	FMOD_VECTOR position = { vPosition[0], vPosition[1], vPosition[2] };
-	FMOD_VECTOR velocity = { 0, 0, 0 };
-	tFoundIt->second->set3DAttributes( &position, &velocity );
+	tFoundIt->second->set3DAttributes( vPosition );
 }
 
 void UAudioEngine::setChannelVolume( const int channelId, const float fVolumedB )
@@ -124,11 +724,61 @@ void UAudioEngine::setChannelVolume( const int channelId, const float fVolumedB
 
 void UAudioEngine::set3dListenerAndOrientation( const float vPosition[3], const float vLook[3], const float vUp[3] )
 {
-	FMOD_VECTOR position = { vPosition[0], vPosition[1], vPosition[2] };
-	FMOD_VECTOR speed = { 0, 0, 0 };
-	FMOD_VECTOR look = { vLook[0], vLook[1], vLook[2] };
-	FMOD_VECTOR up = { vUp[0], vUp[1], vUp[2] };
-	checkErrors( implementationPtr->system->set3DListenerAttributes( 0, &position, &speed, &look, &up ) );
+	implementationPtr->setListener( 0, vPosition, vLook, vUp );
+}
+
+void UAudioEngine::set3dListenerAndOrientation( const int listener, const float vPosition[3], const float vLook[3], const float vUp[3] )
+{
+	implementationPtr->setListener( listener, vPosition, vLook, vUp );
+}
+
+void UAudioEngine::setNumListeners( const int count )
+{
+	implementationPtr->setNumListeners( count );
+}
+
+int UAudioEngine::getNumListeners() const
+{
+	return implementationPtr->numListeners;
+}
+
+void UAudioEngine::set3dListeners( std::span< const UListenerAttributes > listeners )
+{
+	const int count = int( std::min( listeners.size(), size_t( MAX_LISTENERS ) ) );
+	for ( int index = 0; index < count; ++index )
+	{
+		const UListenerAttributes& listener = listeners[size_t( index )];
+		implementationPtr->setListener( index, listener.position, listener.look, listener.up );
+	}
+	implementationPtr->setNumListeners( count );
+}
+
+void UAudioEngine::setHdrSettings( const UHdrSettings& settings )
+{
+	implementationPtr->hdrMixer.setSettings( settings );
+}
+
+void UAudioEngine::setDopplerSettings( const UDopplerSettings& settings )
+{
+	implementationPtr->dopplerSettings = settings;
+	float dopplerScale = 0.f;
+	float distanceFactor = 1.f;
+	float rolloffScale = 1.f;
+	checkErrors( implementationPtr->system->get3DSettings( &dopplerScale, &distanceFactor, &rolloffScale ) );
+	checkErrors( implementationPtr->system->set3DSettings( std::max( settings.dopplerScale, 0.f ), distanceFactor, rolloffScale ) );
+}
+
+void UAudioEngine::setAudibilityThreshold( const float thresholddB )
+{
+	implementationPtr->audibilityThreshold = dBToVolume( thresholddB );
+}
+
+void UAudioEngine::setEmitterGridCellSize( const float cellSize )
+{
+	if ( cellSize > 0.f )
+	{
+		implementationPtr->emitterGrid.setCellSize( cellSize );
+	}
 }
 
 void UAudioEngine::stopChannel( const int channelId, const float fadeTimeSeconds )
@@ -141,15 +791,14 @@ void UAudioEngine::stopChannel( const int channelId, const float fadeTimeSeconds
 	tFoundIt->second->stop( fadeTimeSeconds );
 }
 
+void UAudioEngine::setFadeMode( const UFadeMode mode )
+{
+	implementationPtr->fadeMode = mode;
+}
+
 void UAudioEngine::stopAllChannels()
 {
-	for ( const auto& [channelId, channel] : implementationPtr->channels )
-	{
-		if ( isPlaying( channelId ) )
-		{
-			channel->stop();
-		}
-	}
+	implementationPtr->stopBus( MASTER_BUS );
 }
 
 bool UAudioEngine::isPlaying( const int channelId ) const
@@ -163,6 +812,17 @@ bool UAudioEngine::isPlaying( const int channelId ) const
 	return tFoundIt->second->isPlaying();
 }
 
+bool UAudioEngine::isVirtual( const int channelId ) const
+{
+	auto tFoundIt = implementationPtr->channels.find( channelId );
+	if ( tFoundIt == implementationPtr->channels.end() )
+	{
+		return false;
+	}
+
+	return tFoundIt->second->m_state == UChannel::State::VIRTUAL;
+}
+
 float UAudioEngine::dBToVolume( const float dB )
 {
 	return implementationPtr->dBToVolume( dB );
@@ -172,3 +832,13 @@ float UAudioEngine::volumeTodB( const float volume )
 {
 	return implementationPtr->volumeTodB( volume );
 }
+
+void UAudioEngine::dBToVolume( std::span< const float > dB, std::span< float > volume )
+{
+	univer::audio::decibel::toVolume( dB, volume );
+}
+
+void UAudioEngine::volumeTodB( std::span< const float > volume, std::span< float > dB )
+{
+	univer::audio::decibel::todB( volume, dB );
+}
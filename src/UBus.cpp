@@ -0,0 +1,86 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UBus.cpp                                                                  //
+// ========================================================================= //
+
+#include "UBus.h"
+#include "UAUtils.h"
+
+using univer::audio::UBus;
+
+UBus::UBus( const std::string& _name, UBus* _parent, ::FMOD::ChannelGroup* _fmodGroup ) :
+	name( _name ),
+	parent( _parent ),
+	volume( 1.f ),
+	rolloff( nullptr ),
+	m_fmodGroup( _fmodGroup )
+{}
+
+UBus::~UBus()
+{
+	for ( int effectId = 0; effectId < static_cast< int >( m_effects.size() ); ++effectId )
+	{
+		removeEffect( effectId );
+	}
+	// The master group belongs to the FMOD system.
+	if ( parent != nullptr && m_fmodGroup != nullptr )
+	{
+		checkErrors( m_fmodGroup->release() );
+	}
+	m_fmodGroup = nullptr;
+}
+
+int UBus::addEffect( ::FMOD::DSP* dsp )
+{
+	// The tail is the input side of the group, so effects run before its fader.
+	if ( dsp == nullptr || checkErrors( m_fmodGroup->addDSP( FMOD_CHANNELCONTROL_DSP_TAIL, dsp ) ) )
+	{
+		return -1;
+	}
+	m_effects.push_back( dsp );
+	return static_cast< int >( m_effects.size() ) - 1;
+}
+
+::FMOD::DSP* UBus::getEffect( const int effectId ) const
+{
+	if ( effectId < 0 || effectId >= static_cast< int >( m_effects.size() ) )
+	{
+		return nullptr;
+	}
+	return m_effects[effectId];
+}
+
+void UBus::removeEffect( const int effectId )
+{
+	::FMOD::DSP* dsp = getEffect( effectId );
+	if ( dsp == nullptr )
+	{
+		return;
+	}
+	checkErrors( m_fmodGroup->removeDSP( dsp ) );
+	checkErrors( dsp->release() );
+	m_effects[effectId] = nullptr;
+}
+
+float UBus::getEffectiveVolume() const
+{
+	float effectiveVolume = volume;
+	for ( const UBus* bus = parent; bus != nullptr; bus = bus->parent )
+	{
+		effectiveVolume *= bus->volume;
+	}
+	return effectiveVolume;
+}
+
+bool UBus::isWithin( const UBus& ancestor ) const
+{
+	for ( const UBus* bus = this; bus != nullptr; bus = bus->parent )
+	{
+		if ( bus == &ancestor )
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,47 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UBus.h                                                                    //
+// ========================================================================= //
+
+#ifndef U_BUS_H_
+#define U_BUS_H_
+
+#include <string>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+class URolloffCurve;
+
+// A node of the mixing hierarchy backed by an FMOD channel group. Volume,
+// pause and effects act on the group, so they cost the same whatever the
+// number of channels routed through the bus.
+class UBus
+{
+public:
+	UBus( const std::string& _name, UBus* _parent, ::FMOD::ChannelGroup* _fmodGroup );
+	~UBus();
+
+	// Returns the effect id, stable until the effect is removed.
+	int addEffect( ::FMOD::DSP* dsp );
+	::FMOD::DSP* getEffect( const int effectId ) const;
+	void removeEffect( const int effectId );
+
+	// Product of the volumes from this bus up to the master.
+	float getEffectiveVolume() const;
+	bool isWithin( const UBus& ancestor ) const;
+
+	std::string name;
+	UBus* parent;
+	float volume;
+	const URolloffCurve* rolloff;
+
+	std::vector< ::FMOD::DSP* > m_effects;
+	::FMOD::ChannelGroup* m_fmodGroup;
+};
+}
+
+#endif // U_BUS_H_
@@ -8,27 +8,90 @@
 #include "UAEImplementation.h"
 #include "UAUtils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 using univer::audio::UChannel;
+using univer::audio::UFadeMode;
+using univer::audio::UBus;
+
+namespace
+{
+// Long enough to hide the seam between two variants, short enough for the
+// previous one to be gone by the next update.
+constexpr float LOD_CROSSFADE_SECONDS = 0.005f;
+// What a new FMOD channel starts with, the engine never changes the sound
+// defaults.
+constexpr int FMOD_DEFAULT_PRIORITY = 128;
+}
 
 UChannel::UChannel( UAEImplementation& tImplementation,
+		  const int channelId,
 		  const int soundId,
 		  const float vPosition[3],
 		  const float fVolumedB ) :
 	m_implementation( tImplementation ),
 	m_fmodChannel( nullptr ),
+	m_fmodStream( nullptr ),
+	m_previousFmodChannel( nullptr ),
+	m_previousFmodStream( nullptr ),
+	m_channelId( channelId ),
 	m_soundId( soundId ),
 	m_soundVolume( fVolumedB ),
+	m_propagationGain( 1.f ),
+	m_isPropagated( false ),
+	m_roomId( OUTSIDE_ROOM ),
+	m_hdrGain( 1.f ),
+	m_virtualCursor( 0.f ),
+	m_virtualCursorTime( tImplementation.clock ),
 	m_state( State::INITIALIZE ),
-	m_stopRequested( false )
+	m_stopRequested( false ),
+	m_hasVoice( false ),
+	m_voiceSerial( 0 ),
+	m_isSpatial( false ),
+	m_isDormant( false ),
+	m_isCluster( false ),
+	m_isBinaural( false ),
+	m_clusterId( -1 ),
+	m_lodLevel( 0 ),
+	m_priority( 128 ),
+	m_busId( MASTER_BUS ),
+	m_busSerial( 0 )
 {
 	std::copy( vPosition, vPosition + 3, m_position );
-	m_stopFader.setInitialVolume( m_implementation.dBToVolume( getVolumedB() ) );
+	std::copy( vPosition, vPosition + 3, m_apparentPosition );
 };
 
-void UChannel::update( float fTimeDeltaSeconds )
+UChannel::~UChannel()
+{
+	releaseStream();
+	m_fmodChannel = nullptr;
+}
+
+void UChannel::update()
 {
 	switch ( m_state )
 	{
+		case UChannel::State::VIRTUAL:
+			if ( m_stopRequested )
+			{
+				m_state = State::STOPPED;
+				return;
+			}
+			advanceVirtualCursor();
+			// Clustered channels are heard through their cluster voice.
+			if ( m_clusterId >= 0 || !acquireVoice() )
+			{
+				if ( m_isSpatial )
+				{
+					m_implementation.setChannelDormant( *this, true );
+				}
+				return;
+			}
+			m_implementation.setChannelDormant( *this, false );
+			m_state = State::TOPLAY;
+			[[fallthrough]];
 		case UChannel::State::INITIALIZE:
 			[[fallthrough]];
 		case UChannel::State::TOPLAY:
@@ -44,34 +107,16 @@ void UChannel::update( float fTimeDeltaSeconds )
 				m_state = State::LOADING;
 				return;
 			}
-			m_fmodChannel = nullptr;
 			auto tSoundIt = m_implementation.sounds.find( m_soundId );
-			if ( tSoundIt != m_implementation.sounds.end() )
+			if ( tSoundIt == m_implementation.sounds.end() )
 			{
-				checkErrors( m_implementation.system->playSound( tSoundIt->second->m_fmodSound,
-																 nullptr,
-																 true,
-																 &m_fmodChannel ) );
+				m_state = State::STOPPING;
+				return;
 			}
-			if ( m_fmodChannel != nullptr )
+			if ( start( *tSoundIt->second ) )
 			{
-				m_state = State::PLAYING;
-
-				FMOD_MODE currMode;
-				checkErrors( tSoundIt->second->m_fmodSound->getMode( &currMode ) );
-				if ( currMode & FMOD_3D )
-				{
-					FMOD_VECTOR position = { m_position[0], m_position[1], m_position[2] };
-					FMOD_VECTOR velocity = { 0, 0, 0 };
-					checkErrors( m_fmodChannel->set3DAttributes( &position, &velocity ) );
-				}
-				checkErrors( m_fmodChannel->setVolume( m_implementation.dBToVolume( getVolumedB() ) ) );
 				checkErrors( m_fmodChannel->setPaused( false ) );
 			}
-			else
-			{
-				m_state = State::STOPPING;
-			}
 		}
 		break;
 
@@ -83,21 +128,28 @@ void UChannel::update( float fTimeDeltaSeconds )
 			break;
 
 		case UChannel::State::PLAYING:
-			updateChannelParameters();
+			if ( m_previousFmodChannel != nullptr )
+			{
+				releasePreviousLod( false );
+			}
 			if ( !isPlaying() || m_stopRequested )
 			{
 				m_state = State::STOPPING;
 				return;
 			}
+			if ( shouldVirtualize() )
+			{
+				virtualize();
+			}
+			else if ( shouldSwitchLod() )
+			{
+				switchLod();
+			}
 			break;
 
 		case UChannel::State::STOPPING:
-			m_stopFader.update( fTimeDeltaSeconds );
-			updateChannelParameters();
-			if ( m_stopFader.isFinished() )
-			{
-				m_fmodChannel->stop();
-			}
+			// Fade outs are advanced by the engine fader bank, which stops the
+			// FMOD channel once the fade is over.
 			if ( !isPlaying() )
 			{
 				m_state = State::STOPPED;
@@ -110,48 +162,455 @@ void UChannel::update( float fTimeDeltaSeconds )
 	}
 }
 
-void UChannel::updateChannelParameters()
+bool UChannel::start( const USound& sound, const bool paused )
+{
+	m_fmodChannel = nullptr;
+	releaseStream();
+	if ( !sound.lods.empty() )
+	{
+		m_lodLevel = sound.selectLod( std::sqrt( m_implementation.distanceToListenerSquared( m_position ) ), m_lodLevel );
+	}
+	::FMOD::Sound* fmodSound = sound.getLodSound( m_lodLevel );
+	// A stream plays a single channel at a time, so encoded sounds open one
+	// per channel over the shared data.
+	if ( fmodSound == sound.m_fmodSound && !sound.m_encoded.empty() )
+	{
+		fmodSound = m_fmodStream = m_implementation.openEncodedStream( sound );
+	}
+	UBus* bus = m_implementation.findBus( m_busId );
+	if ( fmodSound != nullptr )
+	{
+		checkErrors( m_implementation.system->playSound( fmodSound,
+														 bus != nullptr ? bus->m_fmodGroup : nullptr,
+														 paused,
+														 &m_fmodChannel ) );
+	}
+	if ( m_fmodChannel == nullptr )
+	{
+		m_state = State::STOPPING;
+		return false;
+	}
+
+	m_state = State::PLAYING;
+	// Every FMOD call costs about as much as the engine side of a voice, so
+	// values the channel already has are not set again.
+	if ( m_priority != FMOD_DEFAULT_PRIORITY )
+	{
+		checkErrors( m_fmodChannel->setPriority( m_priority ) );
+	}
+	if ( m_virtualCursor > 0.f )
+	{
+		checkErrors( m_fmodChannel->setPosition( static_cast< unsigned int >( m_virtualCursor * 1000.f ), FMOD_TIMEUNIT_MS ) );
+	}
+	if ( sound.is3d )
+	{
+		FMOD_VECTOR position = { m_apparentPosition[0], m_apparentPosition[1], m_apparentPosition[2] };
+		FMOD_VECTOR velocity = { 0, 0, 0 };
+		checkErrors( m_fmodChannel->set3DAttributes( &position, &velocity ) );
+	}
+	const float volume = m_implementation.dBToVolume( m_soundVolume ) * getGainScale();
+	if ( volume != 1.f )
+	{
+		checkErrors( m_fmodChannel->setVolume( volume ) );
+	}
+	return true;
+}
+
+bool UChannel::acquireVoice()
+{
+	auto tSoundIt = m_implementation.sounds.find( m_soundId );
+	if ( tSoundIt == m_implementation.sounds.end() )
+	{
+		return false;
+	}
+	const USound& sound = *tSoundIt->second;
+	// The graph only follows channels with a voice, the path is brought up
+	// to date before the channel is judged by it.
+	if ( m_isSpatial && m_implementation.roomGraph.isEnabled() )
+	{
+		m_implementation.roomGraph.propagate( *this );
+	}
+	if ( !m_implementation.isAudible( sound, *this ) ||
+		 !m_implementation.voiceManager.requestVoice( sound, m_soundId, false ) )
+	{
+		return false;
+	}
+	m_implementation.voiceManager.addVoice( *this );
+	return true;
+}
+
+bool UChannel::shouldVirtualize() const
+{
+	auto tSoundIt = m_implementation.sounds.find( m_soundId );
+	if ( tSoundIt == m_implementation.sounds.end() || !tSoundIt->second->isLooping )
+	{
+		return false;
+	}
+	// Half the audibility threshold (-6 dB) keeps voices near the edge from
+	// flipping between real and virtual every frame.
+	const float audibility = m_implementation.estimateAudibility( *tSoundIt->second, *this );
+	return audibility < 0.5f * m_implementation.audibilityThreshold;
+}
+
+void UChannel::virtualize()
+{
+	if ( m_fmodChannel != nullptr )
+	{
+		unsigned int positionMs = 0;
+		if ( m_fmodChannel->getPosition( &positionMs, FMOD_TIMEUNIT_MS ) == FMOD_OK )
+		{
+			m_virtualCursor = positionMs * 0.001f;
+		}
+		m_virtualCursorTime = m_implementation.clock;
+		checkErrors( m_fmodChannel->stop() );
+		m_fmodChannel = nullptr;
+	}
+	releaseStream();
+	m_implementation.voiceManager.releaseVoice( *this );
+	m_implementation.setChannelDormant( *this, m_isSpatial );
+	m_state = State::VIRTUAL;
+}
+
+bool UChannel::shouldSwitchLod() const
+{
+	// One-shots keep the variant they started with, a restart would be heard.
+	auto tSoundIt = m_implementation.sounds.find( m_soundId );
+	if ( tSoundIt == m_implementation.sounds.end() || tSoundIt->second->lods.empty() || !tSoundIt->second->isLooping )
+	{
+		return false;
+	}
+	const USound& sound = *tSoundIt->second;
+	const float distance = std::sqrt( m_implementation.distanceToListenerSquared( m_position ) );
+	return sound.getLodSound( sound.selectLod( distance, m_lodLevel ) ) != sound.getLodSound( m_lodLevel );
+}
+
+void UChannel::switchLod()
+{
+	// The variant starts where the previous one was, as a virtual channel
+	// resuming would, and the two are crossfaded on the DSP clock so the seam
+	// is not heard.
+	::FMOD::Channel* previousChannel = m_fmodChannel;
+	unsigned int positionMs = 0;
+	if ( previousChannel->getPosition( &positionMs, FMOD_TIMEUNIT_MS ) == FMOD_OK )
+	{
+		m_virtualCursor = positionMs * 0.001f;
+	}
+	unsigned long long parentClock = 0;
+	checkErrors( previousChannel->getDSPClock( nullptr, &parentClock ) );
+	const auto fadeSamples = static_cast< unsigned long long >( LOD_CROSSFADE_SECONDS * float( m_implementation.sampleRate ) );
+	const unsigned long long fadeEnd = parentClock + fadeSamples;
+
+	// Everything FMOD holds on the channel is read before it is replaced.
+	float volume = 1.f;
+	checkErrors( previousChannel->getVolume( &volume ) );
+	FMOD_VECTOR position = { m_apparentPosition[0], m_apparentPosition[1], m_apparentPosition[2] };
+	FMOD_VECTOR velocity = { 0, 0, 0 };
+	const bool is3d = previousChannel->get3DAttributes( &position, &velocity ) == FMOD_OK;
+	const float fadeLevel = getFadeLevel( parentClock );
+	const float fadeEndLevel = getFadeLevel( fadeEnd );
+	std::vector< unsigned long long > fadeClocks;
+	std::vector< float > fadeVolumes;
+	unsigned int fadeCount = 0;
+	if ( previousChannel->getFadePoints( &fadeCount, nullptr, nullptr ) == FMOD_OK && fadeCount > 0 )
+	{
+		fadeClocks.resize( fadeCount );
+		fadeVolumes.resize( fadeCount );
+		checkErrors( previousChannel->getFadePoints( &fadeCount, fadeClocks.data(), fadeVolumes.data() ) );
+	}
+	unsigned long long stopClock = 0;
+	bool stopsChannel = false;
+	checkErrors( previousChannel->getDelay( nullptr, &stopClock, &stopsChannel ) );
+
+	// start releases the stream of the channel, the previous variant may
+	// still be playing from it.
+	::FMOD::Sound* previousStream = m_fmodStream;
+	m_fmodStream = nullptr;
+	const bool isStarted = start( *m_implementation.sounds.at( m_soundId ) );
+	m_previousFmodChannel = previousChannel;
+	m_previousFmodStream = previousStream;
+	if ( !isStarted )
+	{
+		releasePreviousLod( true );
+		return;
+	}
+
+	checkErrors( m_fmodChannel->setVolume( volume ) );
+	if ( is3d )
+	{
+		checkErrors( m_fmodChannel->set3DAttributes( &position, &velocity ) );
+	}
+	checkErrors( previousChannel->removeFadePoints( parentClock, ~0ull ) );
+	checkErrors( previousChannel->addFadePoint( parentClock, fadeLevel ) );
+	checkErrors( previousChannel->addFadePoint( fadeEnd, 0.f ) );
+	checkErrors( previousChannel->setDelay( 0, fadeEnd, true ) );
+	checkErrors( m_fmodChannel->addFadePoint( parentClock, 0.f ) );
+	checkErrors( m_fmodChannel->addFadePoint( fadeEnd, fadeEndLevel ) );
+	for ( unsigned int i = 0; i < fadeCount; ++i )
+	{
+		if ( fadeClocks[i] > fadeEnd )
+		{
+			checkErrors( m_fmodChannel->addFadePoint( fadeClocks[i], fadeVolumes[i] ) );
+		}
+	}
+	if ( stopsChannel && stopClock > 0 )
+	{
+		checkErrors( m_fmodChannel->setDelay( 0, std::max( stopClock, fadeEnd ), true ) );
+	}
+	m_implementation.occlusionManager.rebind( m_channelId, m_fmodChannel );
+	if ( m_implementation.hrtfSpatializer != nullptr )
+	{
+		m_implementation.hrtfSpatializer->rebind( *this, previousChannel );
+	}
+	checkErrors( m_fmodChannel->setPaused( false ) );
+}
+
+void UChannel::evict()
 {
-	if ( !m_stopFader.isFinished() && m_stopFader.isStarted() )
+	auto tSoundIt = m_implementation.sounds.find( m_soundId );
+	if ( m_state == State::PLAYING && !m_stopRequested &&
+		 tSoundIt != m_implementation.sounds.end() && tSoundIt->second->isLooping )
 	{
-		m_fmodChannel->setVolume( m_stopFader.getVolume() );
+		virtualize();
+	}
+	else
+	{
+		stop();
 	}
 }
 
+void UChannel::advanceVirtualCursor()
+{
+	// The cursor is only brought up to date when the channel is looked at, so
+	// far away virtual channels cost nothing per frame.
+	const float elapsed = static_cast< float >( m_implementation.clock - m_virtualCursorTime );
+	m_virtualCursorTime = m_implementation.clock;
+	auto tSoundIt = m_implementation.sounds.find( m_soundId );
+	if ( tSoundIt == m_implementation.sounds.end() || tSoundIt->second->m_lengthMs == 0 )
+	{
+		return;
+	}
+	const float length = tSoundIt->second->m_lengthMs * 0.001f;
+	m_virtualCursor = std::fmod( m_virtualCursor + elapsed, length );
+}
+
 bool UChannel::isPlaying() const
 {
+	if ( m_state == State::VIRTUAL )
+	{
+		return true;
+	}
 	bool isPlaying = false;
-	m_fmodChannel->isPlaying( &isPlaying );
+	if ( m_fmodChannel != nullptr )
+	{
+		m_fmodChannel->isPlaying( &isPlaying );
+	}
 	return isPlaying;
 }
 
 float UChannel::getVolumedB() const
 {
-	float volumeDb = 0.f;
-	m_fmodChannel->getVolume( &volumeDb );
-	return volumeDb;
+	return m_soundVolume;
+}
+
+float UChannel::getAudibility() const
+{
+	// Binaural voices bypass FMOD attenuation, so FMOD would report them as
+	// loud at any distance.
+	float audibility = 0.f;
+	if ( m_fmodChannel == nullptr || m_isBinaural || m_fmodChannel->getAudibility( &audibility ) != FMOD_OK )
+	{
+		auto tSoundIt = m_implementation.sounds.find( m_soundId );
+		if ( tSoundIt != m_implementation.sounds.end() )
+		{
+			audibility = m_implementation.estimateAudibility( *tSoundIt->second, *this );
+		}
+	}
+	return audibility;
 }
 
 void UChannel::stop( const float fadeTimeSeconds )
 {
+	// A fade already running is left alone, starting another one would jump
+	// back to full volume. Only an immediate stop cuts it short.
+	if ( m_stopRequested && fadeTimeSeconds > 0.f )
+	{
+		return;
+	}
 	m_stopRequested = true;
-	if ( fadeTimeSeconds > 0.f )
+	if ( m_isDormant )
+	{
+		m_implementation.setChannelDormant( *this, false );
+	}
+	if ( m_fmodChannel == nullptr || fadeTimeSeconds <= 0.f )
+	{
+		m_implementation.voiceManager.releaseVoice( *this );
+	}
+	else
+	{
+		// Still heard until the fade is over, the voice is released when the
+		// channel is removed.
+		m_implementation.voiceManager.markStopping( *this );
+	}
+	if ( m_fmodChannel == nullptr )
+	{
+		return;
+	}
+	if ( fadeTimeSeconds > 0.f && m_implementation.fadeMode == UFadeMode::DSP_CLOCK )
 	{
-		m_stopFader.startFade( 0, fadeTimeSeconds );
+		m_implementation.faderBank.cancel( m_channelId );
+		scheduleFadeOut( fadeTimeSeconds );
+	}
+	else if ( fadeTimeSeconds > 0.f )
+	{
+		m_implementation.faderBank.start( m_channelId, m_implementation.dBToVolume( m_soundVolume ), 0.f, fadeTimeSeconds );
 	}
 	else
 	{
+		m_implementation.faderBank.cancel( m_channelId );
 		checkErrors( m_fmodChannel->stop() );
 	}
 }
 
-void UChannel::set3DAttributes( const FMOD_VECTOR* position, const FMOD_VECTOR* velocity )
+void UChannel::scheduleFadeOut( const float fadeTimeSeconds )
 {
-	checkErrors( m_fmodChannel->set3DAttributes( position, velocity ) );
+	// Both the ramp and the stop run on the mixer thread against the parent
+	// DSP clock, so the fade is sample accurate and needs no further updates.
+	unsigned long long parentClock = 0;
+	if ( checkErrors( m_fmodChannel->getDSPClock( nullptr, &parentClock ) ) )
+	{
+		checkErrors( m_fmodChannel->stop() );
+		return;
+	}
+	const auto fadeSamples = static_cast< unsigned long long >( fadeTimeSeconds * float( m_implementation.sampleRate ) );
+	const unsigned long long fadeEnd = parentClock + fadeSamples;
+	// Ramps from wherever an earlier ramp left the channel, points past now
+	// are replaced.
+	const float fadeLevel = getFadeLevel( parentClock );
+	checkErrors( m_fmodChannel->removeFadePoints( parentClock, ~0ull ) );
+	checkErrors( m_fmodChannel->addFadePoint( parentClock, fadeLevel ) );
+	checkErrors( m_fmodChannel->addFadePoint( fadeEnd, 0.f ) );
+	checkErrors( m_fmodChannel->setDelay( 0, fadeEnd, true ) );
+}
+
+float UChannel::getFadeLevel( const unsigned long long parentClock ) const
+{
+	unsigned int count = 0;
+	if ( checkErrors( m_fmodChannel->getFadePoints( &count, nullptr, nullptr ) ) || count == 0 )
+	{
+		return 1.f;
+	}
+	std::vector< unsigned long long > clocks( count );
+	std::vector< float > volumes( count );
+	if ( checkErrors( m_fmodChannel->getFadePoints( &count, clocks.data(), volumes.data() ) ) || count == 0 )
+	{
+		return 1.f;
+	}
+	if ( parentClock <= clocks[0] )
+	{
+		return volumes[0];
+	}
+	for ( unsigned int i = 1; i < count; ++i )
+	{
+		if ( parentClock < clocks[i] )
+		{
+			const float t = float( parentClock - clocks[i - 1] ) / float( clocks[i] - clocks[i - 1] );
+			return volumes[i - 1] + ( volumes[i] - volumes[i - 1] ) * t;
+		}
+	}
+	return volumes[count - 1];
+}
+
+void UChannel::set3DAttributes( const float vPosition[3] )
+{
+	// FMOD gets the position on the next update together with the velocity
+	// derived from it.
+	if ( m_isSpatial )
+	{
+		m_implementation.velocityTracker.move( m_channelId, m_position, vPosition );
+		m_implementation.emitterGrid.move( m_channelId, vPosition );
+	}
+	std::copy( vPosition, vPosition + 3, m_position );
+	// Propagated channels get their apparent position from the room graph on
+	// the next update.
+	if ( !m_isPropagated )
+	{
+		std::copy( m_position, m_position + 3, m_apparentPosition );
+	}
 }
 
 void UChannel::setVolume( const float volume )
 {
-	checkErrors( m_fmodChannel->setVolume( volume ) );
-	m_stopFader.setInitialVolume( volume );
+	m_soundVolume = m_implementation.volumeTodB( volume );
+	if ( m_fmodChannel != nullptr )
+	{
+		checkErrors( m_fmodChannel->setVolume( volume * getGainScale() ) );
+	}
+}
+
+void UChannel::setPropagation( const float vApparentPosition[3], const float gain )
+{
+	const bool moved = !std::equal( vApparentPosition, vApparentPosition + 3, m_apparentPosition );
+	const bool gainChanged = gain != m_propagationGain;
+	std::copy( vApparentPosition, vApparentPosition + 3, m_apparentPosition );
+	m_propagationGain = gain;
+	m_isPropagated = gain != 1.f || !std::equal( m_apparentPosition, m_apparentPosition + 3, m_position );
+	if ( m_fmodChannel == nullptr )
+	{
+		return;
+	}
+	if ( moved )
+	{
+		m_implementation.velocityTracker.move( m_channelId, m_position, m_position );
+	}
+	// Running fades pick the gain up on their next step.
+	if ( gainChanged && !m_implementation.faderBank.isFading( m_channelId ) )
+	{
+		checkErrors( m_fmodChannel->setVolume( m_implementation.dBToVolume( m_soundVolume ) * getGainScale() ) );
+	}
+}
+
+void UChannel::setHdrGain( const float gain )
+{
+	if ( gain == m_hdrGain )
+	{
+		return;
+	}
+	m_hdrGain = gain;
+	if ( m_fmodChannel != nullptr && !m_implementation.faderBank.isFading( m_channelId ) )
+	{
+		checkErrors( m_fmodChannel->setVolume( m_implementation.dBToVolume( m_soundVolume ) * getGainScale() ) );
+	}
+}
+
+void UChannel::releaseStream()
+{
+	releasePreviousLod( true );
+	if ( m_fmodStream == nullptr )
+	{
+		return;
+	}
+	checkErrors( m_fmodStream->release() );
+	m_fmodStream = nullptr;
+	m_fmodChannel = nullptr;
+}
+
+void UChannel::releasePreviousLod( const bool force )
+{
+	if ( m_previousFmodChannel == nullptr )
+	{
+		return;
+	}
+	bool isPlaying = false;
+	if ( !force && m_previousFmodChannel->isPlaying( &isPlaying ) == FMOD_OK && isPlaying )
+	{
+		return;
+	}
+	// The handle may be stale already, stopping it then fails harmlessly.
+	m_previousFmodChannel->stop();
+	if ( m_previousFmodStream != nullptr )
+	{
+		checkErrors( m_previousFmodStream->release() );
+	}
+	m_previousFmodChannel = nullptr;
+	m_previousFmodStream = nullptr;
 }
@@ -6,23 +6,23 @@
 
 #pragma once
 
-#include "UAudioFader.h"
-
 #include <fmod/fmod.hpp>
 
 namespace univer::audio
 {
 
 class UAEImplementation;
+class USound;
 
 struct UChannel
 {
 	UChannel( UAEImplementation& tImplementation,
+			  const int channelId,
 			  const int soundId,
 			  const float vPosition[3],
 			  const float fVolumedB );
 
-	~UChannel() { m_fmodChannel = nullptr; }
+	~UChannel();
 
 	enum class State
 	{
@@ -30,26 +30,74 @@ struct UChannel
 		TOPLAY,
 		LOADING,
 		PLAYING,
+		VIRTUAL,
 		STOPPING,
 		STOPPED
 	};
 
 	UAEImplementation& m_implementation;
 	::FMOD::Channel* m_fmodChannel;
+	// Own stream of an encoded sound, released with the channel.
+	::FMOD::Sound* m_fmodStream;
+	// Variant fading out after a LOD switch and its stream, if any, kept
+	// until the crossfade is over.
+	::FMOD::Channel* m_previousFmodChannel;
+	::FMOD::Sound* m_previousFmodStream;
+	int m_channelId;
 	int m_soundId;
 	float m_position[3];
-	float m_volumedB;
 	float m_soundVolume;
+	// Where FMOD hears the channel, away from m_position when the sound goes
+	// around walls through portals.
+	float m_apparentPosition[3];
+	float m_propagationGain;
+	bool m_isPropagated;
+	int m_roomId;
+	// Attenuation from the HDR loudness window.
+	float m_hdrGain;
+	float m_virtualCursor;
+	double m_virtualCursorTime;
 	State m_state = State::INITIALIZE;
 	bool m_stopRequested;
-	UAudioFader m_stopFader;
+	bool m_hasVoice;
+	unsigned int m_voiceSerial;
+	bool m_isSpatial;
+	bool m_isDormant;
+	bool m_isCluster;
+	bool m_isBinaural;
+	int m_clusterId;
+	int m_lodLevel;
+	int m_priority;
+	int m_busId;
+	unsigned int m_busSerial;
 
-	void update( float fTimeDeltaSeconds );
-	void updateChannelParameters();
+	void update();
+	// Unpaused only with the DSP locked, the setup after the FMOD play call
+	// would be heard otherwise.
+	bool start( const USound& sound, const bool paused = true );
+	bool acquireVoice();
+	bool shouldVirtualize() const;
+	void virtualize();
+	bool shouldSwitchLod() const;
+	void switchLod();
+	void evict();
+	void advanceVirtualCursor();
 	bool isPlaying() const;
 	float getVolumedB() const;
+	float getAudibility() const;
 	void stop( const float fadeTimeSeconds = 0.f );
-	void set3DAttributes( const FMOD_VECTOR* pos, const FMOD_VECTOR* vel );
+	void scheduleFadeOut( const float fadeTimeSeconds );
+	// Fade point volume at a parent DSP clock, 1 without fade points.
+	float getFadeLevel( const unsigned long long parentClock ) const;
+	void set3DAttributes( const float vPosition[3] );
 	void setVolume( const float volume );
+	void setPropagation( const float vApparentPosition[3], const float gain );
+	void setHdrGain( const float gain );
+	// Also stops the FMOD channel playing the stream.
+	void releaseStream();
+	// Without force, only once the previous variant stopped.
+	void releasePreviousLod( const bool force );
+	// Gains applied by the engine on top of the channel volume.
+	float getGainScale() const { return m_propagationGain * m_hdrGain; }
 };
 }
@@ -0,0 +1,238 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UConvolutionReverb.cpp                                                    //
+// ========================================================================= //
+
+#include "UConvolutionReverb.h"
+#include "UDecibel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+using univer::audio::UConvolutionReverb;
+using univer::audio::UConvolver;
+using univer::audio::UImpulseResponse;
+
+namespace
+{
+constexpr float DEFAULT_WET_DB = -6.f;
+constexpr float DEFAULT_DRY_DB = 0.f;
+constexpr float MIN_DB = -80.f;
+
+struct Instance
+{
+	std::atomic< float > wetdB{ DEFAULT_WET_DB };
+	std::atomic< float > drydB{ DEFAULT_DRY_DB };
+	std::atomic< float > wetGain{ univer::audio::decibel::toVolume( DEFAULT_WET_DB ) };
+	std::atomic< float > dryGain{ univer::audio::decibel::toVolume( DEFAULT_DRY_DB ) };
+	std::shared_ptr< const UImpulseResponse > impulseResponse;
+	std::vector< UConvolver > convolvers;
+	std::vector< float > input;
+	std::vector< float > output;
+};
+
+Instance* getInstance( FMOD_DSP_STATE* dspState )
+{
+	return static_cast< Instance* >( dspState->plugindata );
+}
+
+float toGain( const float dB )
+{
+	return dB <= MIN_DB ? 0.f : univer::audio::decibel::toVolume( dB );
+}
+
+FMOD_RESULT F_CALL create( FMOD_DSP_STATE* dspState )
+{
+	Instance* instance = new Instance();
+	unsigned int blockSize = 0;
+	dspState->functions->getblocksize( dspState, &blockSize );
+	instance->input.resize( std::max( blockSize, 1024u ) );
+	instance->output.resize( instance->input.size() );
+	dspState->plugindata = instance;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL release( FMOD_DSP_STATE* dspState )
+{
+	delete getInstance( dspState );
+	dspState->plugindata = nullptr;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL reset( FMOD_DSP_STATE* dspState )
+{
+	for ( UConvolver& convolver : getInstance( dspState )->convolvers )
+	{
+		convolver.reset();
+	}
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL read( FMOD_DSP_STATE* dspState,
+						 float* inBuffer,
+						 float* outBuffer,
+						 unsigned int length,
+						 int inChannels,
+						 int* outChannels )
+{
+	Instance* instance = getInstance( dspState );
+	*outChannels = inChannels;
+	const float wet = instance->wetGain.load( std::memory_order_relaxed );
+	const float dry = instance->dryGain.load( std::memory_order_relaxed );
+	const size_t channels = size_t( inChannels );
+
+	for ( size_t channel = 0; channel < channels; ++channel )
+	{
+		const bool convolved = channel < instance->convolvers.size() && wet > 0.f;
+		size_t done = 0;
+		while ( done < length )
+		{
+			// Mixer blocks larger than the scratch buffers are split.
+			const size_t chunk = std::min( size_t( length ) - done, instance->input.size() );
+			for ( size_t i = 0; i < chunk; ++i )
+			{
+				instance->input[i] = inBuffer[( done + i ) * channels + channel];
+			}
+			if ( convolved )
+			{
+				instance->convolvers[channel].process( instance->input.data(), instance->output.data(), chunk );
+			}
+			for ( size_t i = 0; i < chunk; ++i )
+			{
+				const float wetSample = convolved ? wet * instance->output[i] : 0.f;
+				outBuffer[( done + i ) * channels + channel] = dry * instance->input[i] + wetSample;
+			}
+			done += chunk;
+		}
+	}
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL setParameterFloat( FMOD_DSP_STATE* dspState, int index, float value )
+{
+	Instance* instance = getInstance( dspState );
+	switch ( index )
+	{
+		case UConvolutionReverb::WET:
+			instance->wetdB = value;
+			instance->wetGain = toGain( value );
+			return FMOD_OK;
+		case UConvolutionReverb::DRY:
+			instance->drydB = value;
+			instance->dryGain = toGain( value );
+			return FMOD_OK;
+	}
+	return FMOD_ERR_INVALID_PARAM;
+}
+
+FMOD_RESULT F_CALL getParameterFloat( FMOD_DSP_STATE* dspState, int index, float* value, char* )
+{
+	Instance* instance = getInstance( dspState );
+	switch ( index )
+	{
+		case UConvolutionReverb::WET:
+			*value = instance->wetdB;
+			return FMOD_OK;
+		case UConvolutionReverb::DRY:
+			*value = instance->drydB;
+			return FMOD_OK;
+	}
+	return FMOD_ERR_INVALID_PARAM;
+}
+
+FMOD_RESULT F_CALL setParameterData( FMOD_DSP_STATE* dspState, int index, void* data, unsigned int length )
+{
+	if ( index != UConvolutionReverb::IMPULSE_RESPONSE || data == nullptr ||
+		 length != sizeof( std::shared_ptr< const UImpulseResponse > ) )
+	{
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	Instance* instance = getInstance( dspState );
+	instance->impulseResponse = *static_cast< const std::shared_ptr< const UImpulseResponse >* >( data );
+	instance->convolvers.clear();
+	if ( instance->impulseResponse == nullptr || instance->impulseResponse->channels.empty() )
+	{
+		return FMOD_OK;
+	}
+	// A mono IR is applied to both sides of a stereo bus.
+	const auto& kernels = instance->impulseResponse->channels;
+	const size_t convolverCount = std::max< size_t >( kernels.size(), 2 );
+	instance->convolvers.reserve( convolverCount );
+	for ( size_t channel = 0; channel < convolverCount; ++channel )
+	{
+		instance->convolvers.emplace_back( kernels[channel % kernels.size()] );
+	}
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL getParameterData( FMOD_DSP_STATE* dspState, int index, void** data, unsigned int* length, char* )
+{
+	if ( index != UConvolutionReverb::IMPULSE_RESPONSE )
+	{
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	Instance* instance = getInstance( dspState );
+	*data = &instance->impulseResponse;
+	*length = sizeof( instance->impulseResponse );
+	return FMOD_OK;
+}
+
+FMOD_DSP_DESCRIPTION makeDescription()
+{
+	static FMOD_DSP_PARAMETER_DESC wet;
+	static FMOD_DSP_PARAMETER_DESC dry;
+	static FMOD_DSP_PARAMETER_DESC impulseResponse;
+	static FMOD_DSP_PARAMETER_DESC* parameters[UConvolutionReverb::PARAMETER_COUNT] = { &wet, &dry, &impulseResponse };
+	FMOD_DSP_INIT_PARAMDESC_FLOAT( wet, "Wet", "dB", "Level of the convolved signal", MIN_DB, 10.f, DEFAULT_WET_DB );
+	FMOD_DSP_INIT_PARAMDESC_FLOAT( dry, "Dry", "dB", "Level of the input signal", MIN_DB, 10.f, DEFAULT_DRY_DB );
+	FMOD_DSP_INIT_PARAMDESC_DATA( impulseResponse, "IR", "", "Impulse response", FMOD_DSP_PARAMETER_DATA_TYPE_USER );
+
+	FMOD_DSP_DESCRIPTION description;
+	std::memset( &description, 0, sizeof( description ) );
+	description.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	std::strncpy( description.name, "univer convolution", sizeof( description.name ) - 1 );
+	description.version = 1;
+	description.numinputbuffers = 1;
+	description.numoutputbuffers = 1;
+	description.create = &create;
+	description.release = &release;
+	description.reset = &reset;
+	description.read = &read;
+	description.numparameters = UConvolutionReverb::PARAMETER_COUNT;
+	description.paramdesc = parameters;
+	description.setparameterfloat = &setParameterFloat;
+	description.getparameterfloat = &getParameterFloat;
+	description.setparameterdata = &setParameterData;
+	description.getparameterdata = &getParameterData;
+	return description;
+}
+}
+
+const FMOD_DSP_DESCRIPTION* UConvolutionReverb::getDescription()
+{
+	static const FMOD_DSP_DESCRIPTION description = makeDescription();
+	return &description;
+}
+
+std::shared_ptr< const UImpulseResponse > UConvolutionReverb::createImpulseResponse( std::span< const float > interleaved,
+																					 const int channels )
+{
+	auto impulseResponse = std::make_shared< UImpulseResponse >();
+	if ( channels <= 0 )
+	{
+		return impulseResponse;
+	}
+	const size_t frames = interleaved.size() / size_t( channels );
+	std::vector< float > samples( frames );
+	for ( int channel = 0; channel < channels; ++channel )
+	{
+		for ( size_t frame = 0; frame < frames; ++frame )
+		{
+			samples[frame] = interleaved[frame * size_t( channels ) + size_t( channel )];
+		}
+		impulseResponse->channels.push_back( std::make_shared< const UConvolutionKernel >( samples, BLOCK_SIZE ) );
+	}
+	return impulseResponse;
+}
@@ -0,0 +1,51 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UConvolutionReverb.h                                                      //
+// ========================================================================= //
+
+#ifndef U_CONVOLUTION_REVERB_H_
+#define U_CONVOLUTION_REVERB_H_
+
+#include "UConvolver.h"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+// One kernel per IR channel, shared by every reverb instance using the IR.
+struct UImpulseResponse
+{
+	std::vector< std::shared_ptr< const UConvolutionKernel > > channels;
+};
+
+// Convolution reverb as an FMOD DSP plugin. Parameters follow Parameter, the
+// impulse response is passed as a pointer to a
+// std::shared_ptr< const UImpulseResponse > and must be set with the DSP
+// engine locked since it swaps the convolvers used by the mixer.
+class UConvolutionReverb
+{
+public:
+	// Partition size. Also the latency of the wet signal, about 10ms at 48kHz.
+	static constexpr size_t BLOCK_SIZE = 512;
+
+	enum Parameter
+	{
+		WET,
+		DRY,
+		IMPULSE_RESPONSE,
+		PARAMETER_COUNT
+	};
+
+	static const FMOD_DSP_DESCRIPTION* getDescription();
+	static std::shared_ptr< const UImpulseResponse > createImpulseResponse( std::span< const float > interleaved,
+																			const int channels );
+};
+}
+
+#endif // U_CONVOLUTION_REVERB_H_
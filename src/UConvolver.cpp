@@ -0,0 +1,189 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UConvolver.cpp                                                            //
+// ========================================================================= //
+
+#include "UConvolver.h"
+
+#include <algorithm>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#define U_CONVOLVER_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define U_CONVOLVER_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define U_CONVOLVER_NEON
+#endif
+
+using univer::audio::UConvolutionKernel;
+using univer::audio::UConvolver;
+
+namespace
+{
+constexpr size_t SIMD_WIDTH = 8;
+
+size_t paddedBins( const size_t blockSize )
+{
+	const size_t bins = blockSize + 1;
+	return ( bins + SIMD_WIDTH - 1 ) / SIMD_WIDTH * SIMD_WIDTH;
+}
+}
+
+UConvolutionKernel::UConvolutionKernel( std::span< const float > impulseResponse, const size_t blockSize ) :
+	m_blockSize( blockSize ),
+	m_partitionCount( std::max< size_t >( ( impulseResponse.size() + blockSize - 1 ) / blockSize, 1 ) ),
+	m_stride( paddedBins( blockSize ) ),
+	m_re( m_partitionCount * m_stride, 0.f ),
+	m_im( m_partitionCount * m_stride, 0.f )
+{
+	// Each partition is zero padded to twice the block so the circular
+	// convolution of the FFT does not wrap into the kept half.
+	URealFFT fft( 2 * blockSize );
+	std::vector< float > padded( 2 * blockSize );
+	for ( size_t partition = 0; partition < m_partitionCount; ++partition )
+	{
+		std::fill( padded.begin(), padded.end(), 0.f );
+		const size_t begin = partition * blockSize;
+		const size_t end = std::min( begin + blockSize, impulseResponse.size() );
+		if ( begin < end )
+		{
+			std::copy( impulseResponse.begin() + begin, impulseResponse.begin() + end, padded.begin() );
+		}
+		fft.forward( padded.data(), m_re.data() + partition * m_stride, m_im.data() + partition * m_stride );
+	}
+}
+
+UConvolver::UConvolver( std::shared_ptr< const UConvolutionKernel > kernel ) :
+	m_kernel( std::move( kernel ) ),
+	m_fft( 2 * m_kernel->getBlockSize() ),
+	m_blockSize( m_kernel->getBlockSize() ),
+	m_position( 0 ),
+	m_historyRe( m_kernel->getPartitionCount() * m_kernel->getStride(), 0.f ),
+	m_historyIm( m_kernel->getPartitionCount() * m_kernel->getStride(), 0.f ),
+	m_head( 0 ),
+	m_window( 2 * m_blockSize, 0.f ),
+	m_outputBlock( m_blockSize, 0.f ),
+	m_accRe( m_kernel->getStride(), 0.f ),
+	m_accIm( m_kernel->getStride(), 0.f ),
+	m_time( 2 * m_blockSize, 0.f )
+{}
+
+void UConvolver::reset()
+{
+	std::fill( m_historyRe.begin(), m_historyRe.end(), 0.f );
+	std::fill( m_historyIm.begin(), m_historyIm.end(), 0.f );
+	std::fill( m_window.begin(), m_window.end(), 0.f );
+	std::fill( m_outputBlock.begin(), m_outputBlock.end(), 0.f );
+	m_position = 0;
+	m_head = 0;
+}
+
+void UConvolver::process( const float* input, float* output, const size_t count )
+{
+	size_t done = 0;
+	while ( done < count )
+	{
+		const size_t chunk = std::min( count - done, m_blockSize - m_position );
+		std::copy( input + done, input + done + chunk, m_window.begin() + m_blockSize + m_position );
+		std::copy( m_outputBlock.begin() + m_position, m_outputBlock.begin() + m_position + chunk, output + done );
+		m_position += chunk;
+		done += chunk;
+		if ( m_position == m_blockSize )
+		{
+			processBlock();
+			m_position = 0;
+		}
+	}
+}
+
+void UConvolver::processBlock()
+{
+	const size_t partitions = m_kernel->getPartitionCount();
+	const size_t stride = m_kernel->getStride();
+
+	m_head = m_head == 0 ? partitions - 1 : m_head - 1;
+	m_fft.forward( m_window.data(), m_historyRe.data() + m_head * stride, m_historyIm.data() + m_head * stride );
+
+	// Partition p meets the spectrum of the block that arrived p blocks ago.
+	std::fill( m_accRe.begin(), m_accRe.end(), 0.f );
+	std::fill( m_accIm.begin(), m_accIm.end(), 0.f );
+	for ( size_t partition = 0; partition < partitions; ++partition )
+	{
+		size_t slot = m_head + partition;
+		if ( slot >= partitions )
+		{
+			slot -= partitions;
+		}
+		multiplyAccumulate( m_historyRe.data() + slot * stride,
+							m_historyIm.data() + slot * stride,
+							m_kernel->getRe( partition ),
+							m_kernel->getIm( partition ),
+							m_accRe.data(),
+							m_accIm.data(),
+							stride );
+	}
+
+	// Overlap-save: the first half of the result is aliased and dropped.
+	m_fft.inverse( m_accRe.data(), m_accIm.data(), m_time.data() );
+	std::copy( m_time.begin() + m_blockSize, m_time.end(), m_outputBlock.begin() );
+	std::copy( m_window.begin() + m_blockSize, m_window.end(), m_window.begin() );
+}
+
+void UConvolver::multiplyAccumulate( const float* xRe,
+									 const float* xIm,
+									 const float* hRe,
+									 const float* hIm,
+									 float* accRe,
+									 float* accIm,
+									 const size_t count )
+{
+	size_t i = 0;
+#if defined( U_CONVOLVER_AVX )
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		const __m256 ar = _mm256_loadu_ps( xRe + i );
+		const __m256 ai = _mm256_loadu_ps( xIm + i );
+		const __m256 br = _mm256_loadu_ps( hRe + i );
+		const __m256 bi = _mm256_loadu_ps( hIm + i );
+		const __m256 re = _mm256_sub_ps( _mm256_mul_ps( ar, br ), _mm256_mul_ps( ai, bi ) );
+		const __m256 im = _mm256_add_ps( _mm256_mul_ps( ar, bi ), _mm256_mul_ps( ai, br ) );
+		_mm256_storeu_ps( accRe + i, _mm256_add_ps( _mm256_loadu_ps( accRe + i ), re ) );
+		_mm256_storeu_ps( accIm + i, _mm256_add_ps( _mm256_loadu_ps( accIm + i ), im ) );
+	}
+#elif defined( U_CONVOLVER_SSE )
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 ar = _mm_loadu_ps( xRe + i );
+		const __m128 ai = _mm_loadu_ps( xIm + i );
+		const __m128 br = _mm_loadu_ps( hRe + i );
+		const __m128 bi = _mm_loadu_ps( hIm + i );
+		const __m128 re = _mm_sub_ps( _mm_mul_ps( ar, br ), _mm_mul_ps( ai, bi ) );
+		const __m128 im = _mm_add_ps( _mm_mul_ps( ar, bi ), _mm_mul_ps( ai, br ) );
+		_mm_storeu_ps( accRe + i, _mm_add_ps( _mm_loadu_ps( accRe + i ), re ) );
+		_mm_storeu_ps( accIm + i, _mm_add_ps( _mm_loadu_ps( accIm + i ), im ) );
+	}
+#elif defined( U_CONVOLVER_NEON )
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const float32x4_t ar = vld1q_f32( xRe + i );
+		const float32x4_t ai = vld1q_f32( xIm + i );
+		const float32x4_t br = vld1q_f32( hRe + i );
+		const float32x4_t bi = vld1q_f32( hIm + i );
+		float32x4_t re = vmlaq_f32( vld1q_f32( accRe + i ), ar, br );
+		re = vmlsq_f32( re, ai, bi );
+		float32x4_t im = vmlaq_f32( vld1q_f32( accIm + i ), ar, bi );
+		im = vmlaq_f32( im, ai, br );
+		vst1q_f32( accRe + i, re );
+		vst1q_f32( accIm + i, im );
+	}
+#endif
+	for ( ; i < count; ++i )
+	{
+		accRe[i] += xRe[i] * hRe[i] - xIm[i] * hIm[i];
+		accIm[i] += xRe[i] * hIm[i] + xIm[i] * hRe[i];
+	}
+}
@@ -0,0 +1,83 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UConvolver.h                                                              //
+// ========================================================================= //
+
+#ifndef U_CONVOLVER_H_
+#define U_CONVOLVER_H_
+
+#include "URealFFT.h"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace univer::audio
+{
+// Spectra of an impulse response cut into partitions of one block each. It is
+// immutable once built, so every convolver using it can share it.
+class UConvolutionKernel
+{
+public:
+	UConvolutionKernel( std::span< const float > impulseResponse, const size_t blockSize );
+
+	size_t getBlockSize() const { return m_blockSize; }
+	size_t getPartitionCount() const { return m_partitionCount; }
+	// Bins are padded so every partition starts on a SIMD boundary.
+	size_t getStride() const { return m_stride; }
+	const float* getRe( const size_t partition ) const { return m_re.data() + partition * m_stride; }
+	const float* getIm( const size_t partition ) const { return m_im.data() + partition * m_stride; }
+
+private:
+	size_t m_blockSize;
+	size_t m_partitionCount;
+	size_t m_stride;
+	std::vector< float > m_re;
+	std::vector< float > m_im;
+};
+
+// Uniformly partitioned overlap-save convolution of a mono stream. Every
+// block costs one forward FFT, one complex multiply-accumulate per partition
+// and one inverse FFT, instead of one multiply per IR sample per sample. The
+// output lags the input by one block.
+class UConvolver
+{
+public:
+	explicit UConvolver( std::shared_ptr< const UConvolutionKernel > kernel );
+
+	void process( const float* input, float* output, const size_t count );
+	void reset();
+
+	// acc += x * h over count complex bins stored as separate re / im arrays.
+	static void multiplyAccumulate( const float* xRe,
+									const float* xIm,
+									const float* hRe,
+									const float* hIm,
+									float* accRe,
+									float* accIm,
+									const size_t count );
+
+private:
+	void processBlock();
+
+	std::shared_ptr< const UConvolutionKernel > m_kernel;
+	URealFFT m_fft;
+	size_t m_blockSize;
+	size_t m_position;
+	// Frequency domain delay line, a ring of input spectra with the newest at
+	// m_head.
+	std::vector< float > m_historyRe;
+	std::vector< float > m_historyIm;
+	size_t m_head;
+	// The last two input blocks, the overlap-save window.
+	std::vector< float > m_window;
+	std::vector< float > m_outputBlock;
+	std::vector< float > m_accRe;
+	std::vector< float > m_accIm;
+	std::vector< float > m_time;
+};
+}
+
+#endif // U_CONVOLVER_H_
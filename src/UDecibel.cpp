@@ -0,0 +1,172 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UDecibel.cpp                                                              //
+// ========================================================================= //
+
+#include "UDecibel.h"
+
+#include <algorithm>
+
+// Integer lanes are needed to build and split exponents, so AVX without AVX2
+// stays on the 128 bit path.
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define U_DECIBEL_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define U_DECIBEL_NEON
+#endif
+
+namespace decibel = univer::audio::decibel;
+
+namespace
+{
+size_t toVolumeSimd( const float* dB, float* volume, const size_t count )
+{
+	size_t i = 0;
+#if defined( U_DECIBEL_SSE )
+	const __m128 vScale = _mm_set1_ps( decibel::LOG2_10_OVER_20 );
+	const __m128 vMin = _mm_set1_ps( -126.f );
+	const __m128 vMax = _mm_set1_ps( 127.f );
+	const __m128i vBias = _mm_set1_epi32( 127 );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 x = _mm_mul_ps( _mm_loadu_ps( dB + i ), vScale );
+		const __m128 underflow = _mm_cmplt_ps( x, vMin );
+		const __m128 clamped = _mm_min_ps( _mm_max_ps( x, vMin ), vMax );
+		// cvtps rounds to nearest in the default MXCSR mode.
+		const __m128i n = _mm_cvtps_epi32( clamped );
+		const __m128 f = _mm_sub_ps( clamped, _mm_cvtepi32_ps( n ) );
+		__m128 p = _mm_set1_ps( 1.54035304e-4f );
+		p = _mm_add_ps( _mm_mul_ps( p, f ), _mm_set1_ps( 1.33335581e-3f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, f ), _mm_set1_ps( 9.61812911e-3f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, f ), _mm_set1_ps( 5.55041087e-2f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, f ), _mm_set1_ps( 2.40226507e-1f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, f ), _mm_set1_ps( 6.93147181e-1f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, f ), _mm_set1_ps( 1.f ) );
+		const __m128 scale = _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( n, vBias ), 23 ) );
+		_mm_storeu_ps( volume + i, _mm_andnot_ps( underflow, _mm_mul_ps( p, scale ) ) );
+	}
+#elif defined( U_DECIBEL_NEON )
+	const float32x4_t vScale = vdupq_n_f32( decibel::LOG2_10_OVER_20 );
+	const float32x4_t vMin = vdupq_n_f32( -126.f );
+	const float32x4_t vMax = vdupq_n_f32( 127.f );
+	const int32x4_t vBias = vdupq_n_s32( 127 );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const float32x4_t x = vmulq_f32( vld1q_f32( dB + i ), vScale );
+		const uint32x4_t underflow = vcltq_f32( x, vMin );
+		const float32x4_t clamped = vminq_f32( vmaxq_f32( x, vMin ), vMax );
+		const int32x4_t n = vcvtq_s32_f32( vaddq_f32( clamped, vbslq_f32( vcltq_f32( clamped, vdupq_n_f32( 0.f ) ),
+																		  vdupq_n_f32( -0.5f ), vdupq_n_f32( 0.5f ) ) ) );
+		const float32x4_t f = vsubq_f32( clamped, vcvtq_f32_s32( n ) );
+		float32x4_t p = vdupq_n_f32( 1.54035304e-4f );
+		p = vmlaq_f32( vdupq_n_f32( 1.33335581e-3f ), p, f );
+		p = vmlaq_f32( vdupq_n_f32( 9.61812911e-3f ), p, f );
+		p = vmlaq_f32( vdupq_n_f32( 5.55041087e-2f ), p, f );
+		p = vmlaq_f32( vdupq_n_f32( 2.40226507e-1f ), p, f );
+		p = vmlaq_f32( vdupq_n_f32( 6.93147181e-1f ), p, f );
+		p = vmlaq_f32( vdupq_n_f32( 1.f ), p, f );
+		const float32x4_t scale = vreinterpretq_f32_s32( vshlq_n_s32( vaddq_s32( n, vBias ), 23 ) );
+		const uint32x4_t result = vreinterpretq_u32_f32( vmulq_f32( p, scale ) );
+		vst1q_f32( volume + i, vreinterpretq_f32_u32( vbicq_u32( result, underflow ) ) );
+	}
+#else
+	( void ) dB;
+	( void ) volume;
+	( void ) count;
+#endif
+	return i;
+}
+
+size_t todBSimd( const float* volume, float* dB, const size_t count )
+{
+	size_t i = 0;
+#if defined( U_DECIBEL_SSE )
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vOne = _mm_set1_ps( 1.f );
+	const __m128 vHalf = _mm_set1_ps( 0.5f );
+	const __m128 vSqrt2 = _mm_set1_ps( decibel::SQRT_2 );
+	const __m128 vMinNormal = _mm_set1_ps( std::numeric_limits< float >::min() );
+	const __m128 vNegInf = _mm_set1_ps( -std::numeric_limits< float >::infinity() );
+	const __m128i vMantissaMask = _mm_set1_epi32( 0x007fffff );
+	const __m128i vOneBits = _mm_set1_epi32( 0x3f800000 );
+	const __m128i vBias = _mm_set1_epi32( 127 );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 v = _mm_loadu_ps( volume + i );
+		const __m128 silent = _mm_cmple_ps( v, vZero );
+		const __m128i bits = _mm_castps_si128( _mm_max_ps( v, vMinNormal ) );
+		__m128 exponent = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( bits, 23 ), vBias ) );
+		__m128 m = _mm_castsi128_ps( _mm_or_si128( _mm_and_si128( bits, vMantissaMask ), vOneBits ) );
+		const __m128 high = _mm_cmpgt_ps( m, vSqrt2 );
+		m = _mm_or_ps( _mm_and_ps( high, _mm_mul_ps( m, vHalf ) ), _mm_andnot_ps( high, m ) );
+		exponent = _mm_add_ps( exponent, _mm_and_ps( high, vOne ) );
+		const __m128 s = _mm_div_ps( _mm_sub_ps( m, vOne ), _mm_add_ps( m, vOne ) );
+		const __m128 s2 = _mm_mul_ps( s, s );
+		__m128 p = _mm_set1_ps( 1.f / 7.f );
+		p = _mm_add_ps( _mm_mul_ps( p, s2 ), _mm_set1_ps( 1.f / 5.f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, s2 ), _mm_set1_ps( 1.f / 3.f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, s2 ), vOne );
+		const __m128 ln = _mm_mul_ps( _mm_mul_ps( p, s ), _mm_set1_ps( 2.f * decibel::INV_LN_2 ) );
+		const __m128 result = _mm_mul_ps( _mm_add_ps( exponent, ln ), _mm_set1_ps( decibel::DB_PER_OCTAVE ) );
+		_mm_storeu_ps( dB + i, _mm_or_ps( _mm_and_ps( silent, vNegInf ), _mm_andnot_ps( silent, result ) ) );
+	}
+#elif defined( U_DECIBEL_NEON )
+	const float32x4_t vZero = vdupq_n_f32( 0.f );
+	const float32x4_t vOne = vdupq_n_f32( 1.f );
+	const float32x4_t vSqrt2 = vdupq_n_f32( decibel::SQRT_2 );
+	const float32x4_t vMinNormal = vdupq_n_f32( std::numeric_limits< float >::min() );
+	const float32x4_t vNegInf = vdupq_n_f32( -std::numeric_limits< float >::infinity() );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const float32x4_t v = vld1q_f32( volume + i );
+		const uint32x4_t silent = vcleq_f32( v, vZero );
+		const uint32x4_t bits = vreinterpretq_u32_f32( vmaxq_f32( v, vMinNormal ) );
+		float32x4_t exponent = vcvtq_f32_s32( vsubq_s32( vreinterpretq_s32_u32( vshrq_n_u32( bits, 23 ) ), vdupq_n_s32( 127 ) ) );
+		float32x4_t m = vreinterpretq_f32_u32( vorrq_u32( vandq_u32( bits, vdupq_n_u32( 0x007fffff ) ), vdupq_n_u32( 0x3f800000 ) ) );
+		const uint32x4_t high = vcgtq_f32( m, vSqrt2 );
+		m = vbslq_f32( high, vmulq_f32( m, vdupq_n_f32( 0.5f ) ), m );
+		exponent = vbslq_f32( high, vaddq_f32( exponent, vOne ), exponent );
+		// Two Newton steps on the reciprocal estimate give full float precision.
+		const float32x4_t denominator = vaddq_f32( m, vOne );
+		float32x4_t reciprocal = vrecpeq_f32( denominator );
+		reciprocal = vmulq_f32( reciprocal, vrecpsq_f32( denominator, reciprocal ) );
+		reciprocal = vmulq_f32( reciprocal, vrecpsq_f32( denominator, reciprocal ) );
+		const float32x4_t s = vmulq_f32( vsubq_f32( m, vOne ), reciprocal );
+		const float32x4_t s2 = vmulq_f32( s, s );
+		float32x4_t p = vdupq_n_f32( 1.f / 7.f );
+		p = vmlaq_f32( vdupq_n_f32( 1.f / 5.f ), p, s2 );
+		p = vmlaq_f32( vdupq_n_f32( 1.f / 3.f ), p, s2 );
+		p = vmlaq_f32( vOne, p, s2 );
+		const float32x4_t ln = vmulq_f32( vmulq_f32( p, s ), vdupq_n_f32( 2.f * decibel::INV_LN_2 ) );
+		const float32x4_t result = vmulq_f32( vaddq_f32( exponent, ln ), vdupq_n_f32( decibel::DB_PER_OCTAVE ) );
+		vst1q_f32( dB + i, vbslq_f32( silent, vNegInf, result ) );
+	}
+#else
+	( void ) volume;
+	( void ) dB;
+	( void ) count;
+#endif
+	return i;
+}
+}
+
+void decibel::toVolume( std::span< const float > dB, std::span< float > volume )
+{
+	const size_t count = std::min( dB.size(), volume.size() );
+	for ( size_t i = toVolumeSimd( dB.data(), volume.data(), count ); i < count; ++i )
+	{
+		volume[i] = toVolume( dB[i] );
+	}
+}
+
+void decibel::todB( std::span< const float > volume, std::span< float > dB )
+{
+	const size_t count = std::min( volume.size(), dB.size() );
+	for ( size_t i = todBSimd( volume.data(), dB.data(), count ); i < count; ++i )
+	{
+		dB[i] = todB( volume[i] );
+	}
+}
@@ -0,0 +1,85 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UDecibel.h                                                                //
+// ========================================================================= //
+
+#ifndef U_DECIBEL_H_
+#define U_DECIBEL_H_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace univer::audio::decibel
+{
+// Polynomial replacements for std::pow( 10, dB / 20 ) and 20 * log10( v ).
+// Both work on the float bit pattern: the exponent is handled exactly and only
+// a reduced range is approximated. Between -120 and +12 dB toVolume stays
+// within 1e-6 relative error and todB within 2e-5 dB, most of which is the
+// float rounding of the input scale.
+
+constexpr float LOG2_10_OVER_20 = 0.166096404744f;
+constexpr float DB_PER_OCTAVE = 6.02059991328f;
+constexpr float SQRT_2 = 1.41421356237f;
+constexpr float INV_LN_2 = 1.44269504089f;
+
+// 2^x for x in [-126, 128).
+constexpr float exp2( const float x )
+{
+	if ( x < -126.f )
+	{
+		return 0.f;
+	}
+	const float clamped = x < 127.f ? x : 127.f;
+	// Round to nearest so the fraction stays in [-0.5, 0.5], where a degree 6
+	// Taylor series of 2^f is accurate to 1.2e-7.
+	const int i = static_cast< int >( clamped + ( clamped >= 0.f ? 0.5f : -0.5f ) );
+	const float f = clamped - float( i );
+	const float p = 1.f + f * ( 6.93147181e-1f + f * ( 2.40226507e-1f + f * ( 5.55041087e-2f +
+		f * ( 9.61812911e-3f + f * ( 1.33335581e-3f + f * 1.54035304e-4f ) ) ) ) );
+	return p * std::bit_cast< float >( static_cast< uint32_t >( i + 127 ) << 23 );
+}
+
+// log2( v ) for v > 0, with v = 0 giving -infinity as std::log2 does.
+constexpr float log2( const float v )
+{
+	if ( !( v > 0.f ) )
+	{
+		return -std::numeric_limits< float >::infinity();
+	}
+	const float normal = v < std::numeric_limits< float >::min() ? std::numeric_limits< float >::min() : v;
+	const uint32_t bits = std::bit_cast< uint32_t >( normal );
+	int exponent = static_cast< int >( bits >> 23 ) - 127;
+	float m = std::bit_cast< float >( ( bits & 0x007fffffu ) | 0x3f800000u );
+	// Centre the mantissa on 1 so s = ( m - 1 ) / ( m + 1 ) stays below 0.172.
+	if ( m > SQRT_2 )
+	{
+		m *= 0.5f;
+		++exponent;
+	}
+	const float s = ( m - 1.f ) / ( m + 1.f );
+	const float s2 = s * s;
+	const float ln = 2.f * s * ( 1.f + s2 * ( 1.f / 3.f + s2 * ( 1.f / 5.f + s2 * ( 1.f / 7.f ) ) ) );
+	return float( exponent ) + ln * INV_LN_2;
+}
+
+constexpr float toVolume( const float dB )
+{
+	return exp2( dB * LOG2_10_OVER_20 );
+}
+
+constexpr float todB( const float volume )
+{
+	return DB_PER_OCTAVE * log2( volume );
+}
+
+// Batch versions, vectorized where the target allows. Only the common prefix
+// of both spans is converted.
+void toVolume( std::span< const float > dB, std::span< float > volume );
+void todB( std::span< const float > volume, std::span< float > dB );
+}
+
+#endif // U_DECIBEL_H_
@@ -0,0 +1,151 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UDucker.cpp                                                               //
+// ========================================================================= //
+
+#include "UDucker.h"
+#include "UBus.h"
+#include "UDecibel.h"
+#include "UAUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using univer::audio::UDucker;
+
+UDucker::UDucker( ::FMOD::System* system,
+				  UBus& source,
+				  UBus& target,
+				  const int sampleRate,
+				  const float depthdB,
+				  const float thresholddB,
+				  const float attackSeconds,
+				  const float releaseSeconds ) :
+	m_source( source ),
+	m_target( target ),
+	m_inverseSampleRate( 1.f / float( std::max( sampleRate, 1 ) ) ),
+	m_duckedGain( decibel::toVolume( -std::fabs( depthdB ) ) ),
+	m_threshold( decibel::toVolume( thresholddB ) ),
+	m_attackSeconds( std::max( attackSeconds, 0.f ) ),
+	m_releaseSeconds( std::max( releaseSeconds, 0.f ) ),
+	m_envelope( 0.f ),
+	m_currentGain( 1.f ),
+	m_detector( nullptr ),
+	m_gain( nullptr )
+{
+	m_detector = createDSP( system, "univer duck detector", &UDucker::detectorRead );
+	m_gain = createDSP( system, "univer duck gain", &UDucker::gainRead );
+	if ( !isValid() )
+	{
+		return;
+	}
+	// The head is the output side of a group, after its fader and effects.
+	checkErrors( m_source.m_fmodGroup->addDSP( FMOD_CHANNELCONTROL_DSP_HEAD, m_detector ) );
+	checkErrors( m_target.m_fmodGroup->addDSP( FMOD_CHANNELCONTROL_DSP_HEAD, m_gain ) );
+}
+
+UDucker::~UDucker()
+{
+	if ( m_detector != nullptr )
+	{
+		m_source.m_fmodGroup->removeDSP( m_detector );
+		checkErrors( m_detector->release() );
+		m_detector = nullptr;
+	}
+	if ( m_gain != nullptr )
+	{
+		m_target.m_fmodGroup->removeDSP( m_gain );
+		checkErrors( m_gain->release() );
+		m_gain = nullptr;
+	}
+}
+
+::FMOD::DSP* UDucker::createDSP( ::FMOD::System* system, const char* name, FMOD_DSP_READ_CALLBACK read )
+{
+	FMOD_DSP_DESCRIPTION description;
+	std::memset( &description, 0, sizeof( description ) );
+	description.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	std::strncpy( description.name, name, sizeof( description.name ) - 1 );
+	description.version = 1;
+	description.numinputbuffers = 1;
+	description.numoutputbuffers = 1;
+	description.read = read;
+
+	::FMOD::DSP* dsp = nullptr;
+	if ( checkErrors( system->createDSP( &description, &dsp ) ) )
+	{
+		return nullptr;
+	}
+	checkErrors( dsp->setUserData( this ) );
+	return dsp;
+}
+
+FMOD_RESULT F_CALL UDucker::detectorRead( FMOD_DSP_STATE* dspState,
+										  float* inBuffer,
+										  float* outBuffer,
+										  unsigned int length,
+										  int inChannels,
+										  int* outChannels )
+{
+	void* userData = nullptr;
+	static_cast< ::FMOD::DSP* >( dspState->instance )->getUserData( &userData );
+	UDucker* ducker = static_cast< UDucker* >( userData );
+
+	const size_t count = size_t( length ) * size_t( inChannels );
+	float peak = 0.f;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		peak = std::max( peak, std::fabs( inBuffer[i] ) );
+	}
+	std::memcpy( outBuffer, inBuffer, count * sizeof( float ) );
+	*outChannels = inChannels;
+	if ( ducker != nullptr )
+	{
+		ducker->m_envelope.store( peak, std::memory_order_relaxed );
+	}
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL UDucker::gainRead( FMOD_DSP_STATE* dspState,
+									  float* inBuffer,
+									  float* outBuffer,
+									  unsigned int length,
+									  int inChannels,
+									  int* outChannels )
+{
+	void* userData = nullptr;
+	static_cast< ::FMOD::DSP* >( dspState->instance )->getUserData( &userData );
+	UDucker* ducker = static_cast< UDucker* >( userData );
+	*outChannels = inChannels;
+	if ( ducker == nullptr )
+	{
+		std::memcpy( outBuffer, inBuffer, size_t( length ) * size_t( inChannels ) * sizeof( float ) );
+		return FMOD_OK;
+	}
+
+	// One pole smoothing evaluated once per block, then ramped per sample so
+	// the gain change does not click.
+	const bool active = ducker->m_envelope.load( std::memory_order_relaxed ) >= ducker->m_threshold;
+	const float targetGain = active ? ducker->m_duckedGain : 1.f;
+	const float startGain = ducker->m_currentGain;
+	const float timeConstant = targetGain < startGain ? ducker->m_attackSeconds : ducker->m_releaseSeconds;
+	const float blockSeconds = float( length ) * ducker->m_inverseSampleRate;
+	const float coefficient = timeConstant > 0.f ? std::exp( -blockSeconds / timeConstant ) : 0.f;
+	const float endGain = targetGain + ( startGain - targetGain ) * coefficient;
+	ducker->m_currentGain = endGain;
+
+	const float step = length > 0 ? ( endGain - startGain ) / float( length ) : 0.f;
+	float gain = startGain;
+	for ( unsigned int sample = 0; sample < length; ++sample )
+	{
+		gain += step;
+		for ( int channel = 0; channel < inChannels; ++channel )
+		{
+			const size_t i = size_t( sample ) * size_t( inChannels ) + size_t( channel );
+			outBuffer[i] = inBuffer[i] * gain;
+		}
+	}
+	return FMOD_OK;
+}
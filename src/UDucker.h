@@ -0,0 +1,72 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UDucker.h                                                                 //
+// ========================================================================= //
+
+#ifndef U_DUCKER_H_
+#define U_DUCKER_H_
+
+#include <atomic>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+class UBus;
+
+// Sidechain ducking between two buses, run entirely on the mixer thread. A
+// detector DSP at the output of the source bus publishes the peak of every
+// block and a gain DSP at the output of the target bus smooths towards the
+// ducked gain while that peak is above the threshold. The target reacts on
+// its next block, at most one block after the source.
+class UDucker
+{
+public:
+	UDucker( ::FMOD::System* system,
+			 UBus& source,
+			 UBus& target,
+			 const int sampleRate,
+			 const float depthdB,
+			 const float thresholddB,
+			 const float attackSeconds,
+			 const float releaseSeconds );
+	~UDucker();
+
+	bool isValid() const { return m_detector != nullptr && m_gain != nullptr; }
+
+private:
+	static FMOD_RESULT F_CALL detectorRead( FMOD_DSP_STATE* dspState,
+											float* inBuffer,
+											float* outBuffer,
+											unsigned int length,
+											int inChannels,
+											int* outChannels );
+	static FMOD_RESULT F_CALL gainRead( FMOD_DSP_STATE* dspState,
+										float* inBuffer,
+										float* outBuffer,
+										unsigned int length,
+										int inChannels,
+										int* outChannels );
+
+	::FMOD::DSP* createDSP( ::FMOD::System* system, const char* name, FMOD_DSP_READ_CALLBACK read );
+
+	UBus& m_source;
+	UBus& m_target;
+	float m_inverseSampleRate;
+	float m_duckedGain;
+	float m_threshold;
+	float m_attackSeconds;
+	float m_releaseSeconds;
+	// Written by the detector and read by the gain stage, both on the mixer
+	// thread but possibly from different mix jobs.
+	std::atomic< float > m_envelope;
+	// Only touched by the gain stage.
+	float m_currentGain;
+
+	::FMOD::DSP* m_detector;
+	::FMOD::DSP* m_gain;
+};
+}
+
+#endif // U_DUCKER_H_
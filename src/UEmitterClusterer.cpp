@@ -0,0 +1,194 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UEmitterClusterer.cpp                                                     //
+// ========================================================================= //
+
+#include "UEmitterClusterer.h"
+#include "UAEImplementation.h"
+#include "UChannel.h"
+#include "USound.h"
+
+#include <algorithm>
+#include <cmath>
+
+using univer::audio::UEmitterClusterer;
+using univer::audio::UChannel;
+using univer::audio::USound;
+
+UEmitterClusterer::UEmitterClusterer( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation )
+{}
+
+void UEmitterClusterer::update( const std::vector< int >& channelIds )
+{
+	m_buckets.clear();
+	for ( const int channelId : channelIds )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		const UChannel& channel = *tChannelIt->second;
+		if ( channel.m_isCluster || channel.m_stopRequested || !channel.m_isSpatial ||
+			 ( channel.m_state != UChannel::State::PLAYING && channel.m_state != UChannel::State::VIRTUAL ) )
+		{
+			continue;
+		}
+		auto tSoundIt = m_implementation.sounds.find( channel.m_soundId );
+		if ( tSoundIt == m_implementation.sounds.end() )
+		{
+			continue;
+		}
+		const USound& sound = *tSoundIt->second;
+		if ( !sound.isLooping || sound.clusterDistance <= 0.f || sound.clusterSize <= 0.f ||
+			 m_implementation.distanceToListenerSquared( channel.m_position ) < sound.clusterDistance * sound.clusterDistance )
+		{
+			continue;
+		}
+		const float inverseSize = 1.f / sound.clusterSize;
+		const Key key{ channel.m_soundId,
+					   static_cast< int >( std::floor( channel.m_position[0] * inverseSize ) ),
+					   static_cast< int >( std::floor( channel.m_position[1] * inverseSize ) ),
+					   static_cast< int >( std::floor( channel.m_position[2] * inverseSize ) ) };
+		m_buckets[key].push_back( channelId );
+	}
+	for ( auto& [key, members] : m_buckets )
+	{
+		std::sort( members.begin(), members.end() );
+	}
+
+	// Members that moved away, got closer or stopped go back to being regular
+	// channels. Clusters left with fewer than two members are dissolved.
+	for ( auto tClusterIt = m_clusters.begin(); tClusterIt != m_clusters.end(); )
+	{
+		Cluster& cluster = tClusterIt->second;
+		auto tBucketIt = m_buckets.find( tClusterIt->first );
+		const bool keep = tBucketIt != m_buckets.end() && tBucketIt->second.size() >= 2;
+		for ( const int memberId : cluster.members )
+		{
+			if ( !keep || !std::binary_search( tBucketIt->second.begin(), tBucketIt->second.end(), memberId ) )
+			{
+				leaveCluster( memberId, cluster.channelId );
+			}
+		}
+		if ( keep )
+		{
+			++tClusterIt;
+			continue;
+		}
+		auto tChannelIt = m_implementation.channels.find( cluster.channelId );
+		if ( tChannelIt != m_implementation.channels.end() )
+		{
+			tChannelIt->second->stop();
+		}
+		tClusterIt = m_clusters.erase( tClusterIt );
+	}
+
+	for ( const auto& [key, members] : m_buckets )
+	{
+		if ( members.size() < 2 )
+		{
+			continue;
+		}
+		auto tSoundIt = m_implementation.sounds.find( std::get< 0 >( key ) );
+		Cluster& cluster = m_clusters[key];
+		cluster.members = members;
+		refreshCluster( key, cluster, *tSoundIt->second );
+	}
+}
+
+void UEmitterClusterer::refreshCluster( const Key& key, Cluster& cluster, const USound& sound )
+{
+	// Uncorrelated copies of a sound add up in energy, so the members are
+	// weighted by the energy they would deliver to the listener.
+	float energy = 0.f;
+	float centroid[3] = { 0.f, 0.f, 0.f };
+	float average[3] = { 0.f, 0.f, 0.f };
+	for ( const int memberId : cluster.members )
+	{
+		const UChannel& member = *m_implementation.channels.at( memberId );
+		const float audibility = m_implementation.estimateAudibility( sound, member.m_position, member.m_soundVolume );
+		const float weight = audibility * audibility;
+		energy += weight;
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			centroid[axis] += weight * member.m_position[axis];
+			average[axis] += member.m_position[axis];
+		}
+	}
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		centroid[axis] = energy > 0.f ? centroid[axis] / energy : average[axis] / float( cluster.members.size() );
+	}
+
+	// Volume that makes the cluster voice deliver the summed energy from the
+	// centroid, given the rolloff at that distance.
+	const float attenuation = m_implementation.estimateAudibility( sound, centroid, 0.f );
+	const float volume = attenuation > 0.f ? std::sqrt( energy ) / attenuation : 0.f;
+
+	UChannel* clusterChannel = nullptr;
+	auto tChannelIt = m_implementation.channels.find( cluster.channelId );
+	if ( tChannelIt != m_implementation.channels.end() && !tChannelIt->second->m_stopRequested )
+	{
+		clusterChannel = tChannelIt->second.get();
+		clusterChannel->set3DAttributes( centroid );
+		clusterChannel->setVolume( volume );
+	}
+	else
+	{
+		const int channelId = m_implementation.nextChannelId++;
+		clusterChannel = m_implementation.createChannel( channelId,
+														 std::get< 0 >( key ),
+														 sound,
+														 centroid,
+														 m_implementation.volumeTodB( volume ) );
+		if ( clusterChannel != nullptr )
+		{
+			clusterChannel->m_isCluster = true;
+			if ( clusterChannel->m_hasVoice )
+			{
+				clusterChannel->update();
+			}
+		}
+	}
+	if ( clusterChannel == nullptr )
+	{
+		// No voice for the cluster, the members keep playing on their own.
+		for ( const int memberId : cluster.members )
+		{
+			leaveCluster( memberId, cluster.channelId );
+		}
+		cluster.channelId = -1;
+		return;
+	}
+
+	cluster.channelId = clusterChannel->m_channelId;
+	for ( const int memberId : cluster.members )
+	{
+		UChannel& member = *m_implementation.channels.at( memberId );
+		if ( member.m_clusterId == cluster.channelId )
+		{
+			continue;
+		}
+		if ( member.m_state == UChannel::State::PLAYING )
+		{
+			member.virtualize();
+		}
+		member.m_clusterId = cluster.channelId;
+	}
+}
+
+void UEmitterClusterer::leaveCluster( const int memberId, const int clusterChannelId )
+{
+	auto tChannelIt = m_implementation.channels.find( memberId );
+	if ( tChannelIt == m_implementation.channels.end() || tChannelIt->second->m_clusterId != clusterChannelId )
+	{
+		return;
+	}
+	UChannel& member = *tChannelIt->second;
+	member.m_clusterId = -1;
+	// Back to a regular virtual channel, it gets a voice again if audible.
+	m_implementation.setChannelDormant( member, false );
+}
@@ -0,0 +1,53 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UEmitterClusterer.h                                                       //
+// ========================================================================= //
+
+#ifndef U_EMITTER_CLUSTERER_H_
+#define U_EMITTER_CLUSTERER_H_
+
+#include <cstddef>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace univer::audio
+{
+class UAEImplementation;
+class USound;
+
+// Merges looping emitters of the same sound that are far from the listener
+// and close to each other into a single voice. The cluster voice plays at the
+// energy weighted centroid of its members with their summed energy, while the
+// members wait as virtual channels.
+class UEmitterClusterer
+{
+public:
+	explicit UEmitterClusterer( UAEImplementation& tImplementation );
+
+	// Groups the given channels, usually the ones visited by this update.
+	void update( const std::vector< int >& channelIds );
+
+	size_t getClusterCount() const { return m_clusters.size(); }
+
+private:
+	// Sound id and cell coordinates.
+	using Key = std::tuple< int, int, int, int >;
+
+	struct Cluster
+	{
+		int channelId = -1;
+		std::vector< int > members;
+	};
+
+	void refreshCluster( const Key& key, Cluster& cluster, const USound& sound );
+	void leaveCluster( const int memberId, const int clusterChannelId );
+
+	UAEImplementation& m_implementation;
+	std::map< Key, std::vector< int > > m_buckets;
+	std::map< Key, Cluster > m_clusters;
+};
+}
+
+#endif // U_EMITTER_CLUSTERER_H_
@@ -0,0 +1,178 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UFaderBank.cpp                                                            //
+// ========================================================================= //
+
+#include "UFaderBank.h"
+
+#include <algorithm>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#define U_FADER_BANK_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define U_FADER_BANK_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define U_FADER_BANK_NEON
+#endif
+
+using univer::audio::UFaderBank;
+
+void UFaderBank::start( const int channelId, const float fromVolume, const float toVolume, const float seconds )
+{
+	auto tFoundIt = m_indices.find( channelId );
+	size_t index = 0;
+	if ( tFoundIt != m_indices.end() )
+	{
+		index = tFoundIt->second;
+	}
+	else
+	{
+		index = m_owners.size();
+		m_indices[channelId] = index;
+		m_owners.push_back( channelId );
+		m_remaining.push_back( 0.f );
+		m_inverseDuration.push_back( 0.f );
+		m_startVolume.push_back( 0.f );
+		m_endVolume.push_back( 0.f );
+		m_volume.push_back( 0.f );
+	}
+	// The inverse duration is stored so the per-frame pass has no divides.
+	m_remaining[index] = std::max( seconds, 0.f );
+	m_inverseDuration[index] = seconds > 0.f ? 1.f / seconds : 0.f;
+	m_startVolume[index] = fromVolume;
+	m_endVolume[index] = toVolume;
+	m_volume[index] = fromVolume;
+}
+
+void UFaderBank::cancel( const int channelId )
+{
+	auto tFoundIt = m_indices.find( channelId );
+	if ( tFoundIt != m_indices.end() )
+	{
+		removeAt( tFoundIt->second );
+	}
+}
+
+void UFaderBank::removeAt( const size_t index )
+{
+	const size_t last = m_owners.size() - 1;
+	m_indices.erase( m_owners[index] );
+	if ( index != last )
+	{
+		m_owners[index] = m_owners[last];
+		m_remaining[index] = m_remaining[last];
+		m_inverseDuration[index] = m_inverseDuration[last];
+		m_startVolume[index] = m_startVolume[last];
+		m_endVolume[index] = m_endVolume[last];
+		m_volume[index] = m_volume[last];
+		m_indices[m_owners[index]] = index;
+	}
+	m_owners.pop_back();
+	m_remaining.pop_back();
+	m_inverseDuration.pop_back();
+	m_startVolume.pop_back();
+	m_endVolume.pop_back();
+	m_volume.pop_back();
+}
+
+const std::vector< UFaderBank::VolumeChange >& UFaderBank::update( const float dt, const bool allowSimd )
+{
+	const size_t processed = allowSimd ? advanceSimd( dt ) : 0;
+	advanceScalar( processed, dt );
+
+	const size_t count = m_owners.size();
+	m_changes.resize( count );
+	m_finished.clear();
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const bool finished = m_remaining[i] <= 0.f;
+		m_changes[i] = { m_owners[i], m_volume[i], finished };
+		if ( finished )
+		{
+			m_finished.push_back( i );
+		}
+	}
+	// Remove from the back so that moving the last slot never skips a fade.
+	for ( auto it = m_finished.rbegin(); it != m_finished.rend(); ++it )
+	{
+		removeAt( *it );
+	}
+	return m_changes;
+}
+
+void UFaderBank::advanceScalar( const size_t begin, const float dt )
+{
+	for ( size_t i = begin; i < m_owners.size(); ++i )
+	{
+		const float remaining = std::max( m_remaining[i] - dt, 0.f );
+		const float t = 1.f - remaining * m_inverseDuration[i];
+		m_remaining[i] = remaining;
+		m_volume[i] = m_startVolume[i] + ( m_endVolume[i] - m_startVolume[i] ) * t;
+	}
+}
+
+size_t UFaderBank::advanceSimd( const float dt )
+{
+	const size_t count = m_owners.size();
+	float* remaining = m_remaining.data();
+	const float* inverseDuration = m_inverseDuration.data();
+	const float* startVolume = m_startVolume.data();
+	const float* endVolume = m_endVolume.data();
+	float* volume = m_volume.data();
+	size_t i = 0;
+
+#if defined( U_FADER_BANK_AVX )
+	const __m256 vDt = _mm256_set1_ps( dt );
+	const __m256 vZero = _mm256_setzero_ps();
+	const __m256 vOne = _mm256_set1_ps( 1.f );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		const __m256 r = _mm256_max_ps( _mm256_sub_ps( _mm256_loadu_ps( remaining + i ), vDt ), vZero );
+		const __m256 t = _mm256_sub_ps( vOne, _mm256_mul_ps( r, _mm256_loadu_ps( inverseDuration + i ) ) );
+		const __m256 a = _mm256_loadu_ps( startVolume + i );
+		const __m256 b = _mm256_loadu_ps( endVolume + i );
+		_mm256_storeu_ps( remaining + i, r );
+		_mm256_storeu_ps( volume + i, _mm256_add_ps( a, _mm256_mul_ps( _mm256_sub_ps( b, a ), t ) ) );
+	}
+#elif defined( U_FADER_BANK_SSE )
+	const __m128 vDt = _mm_set1_ps( dt );
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vOne = _mm_set1_ps( 1.f );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 r = _mm_max_ps( _mm_sub_ps( _mm_loadu_ps( remaining + i ), vDt ), vZero );
+		const __m128 t = _mm_sub_ps( vOne, _mm_mul_ps( r, _mm_loadu_ps( inverseDuration + i ) ) );
+		const __m128 a = _mm_loadu_ps( startVolume + i );
+		const __m128 b = _mm_loadu_ps( endVolume + i );
+		_mm_storeu_ps( remaining + i, r );
+		_mm_storeu_ps( volume + i, _mm_add_ps( a, _mm_mul_ps( _mm_sub_ps( b, a ), t ) ) );
+	}
+#elif defined( U_FADER_BANK_NEON )
+	const float32x4_t vDt = vdupq_n_f32( dt );
+	const float32x4_t vZero = vdupq_n_f32( 0.f );
+	const float32x4_t vOne = vdupq_n_f32( 1.f );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const float32x4_t r = vmaxq_f32( vsubq_f32( vld1q_f32( remaining + i ), vDt ), vZero );
+		const float32x4_t t = vsubq_f32( vOne, vmulq_f32( r, vld1q_f32( inverseDuration + i ) ) );
+		const float32x4_t a = vld1q_f32( startVolume + i );
+		const float32x4_t b = vld1q_f32( endVolume + i );
+		vst1q_f32( remaining + i, r );
+		vst1q_f32( volume + i, vmlaq_f32( a, vsubq_f32( b, a ), t ) );
+	}
+#else
+	( void ) dt;
+	( void ) count;
+	( void ) remaining;
+	( void ) inverseDuration;
+	( void ) startVolume;
+	( void ) endVolume;
+	( void ) volume;
+#endif
+
+	return i;
+}
@@ -0,0 +1,55 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UFaderBank.h                                                              //
+// ========================================================================= //
+
+#ifndef U_FADER_BANK_H_
+#define U_FADER_BANK_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace univer::audio
+{
+// All the active volume fades of the engine, stored as contiguous arrays so a
+// single vectorized pass advances every fade. Slots are kept dense by moving
+// the last fade into the slot of a removed one.
+class UFaderBank
+{
+public:
+	struct VolumeChange
+	{
+		int channelId;
+		float volume;
+		bool finished;
+	};
+
+	void start( const int channelId, const float fromVolume, const float toVolume, const float seconds );
+	void cancel( const int channelId );
+	bool isFading( const int channelId ) const { return m_indices.count( channelId ) != 0; }
+	size_t size() const { return m_owners.size(); }
+
+	// Advances every fade by dt and returns the volumes to push to FMOD.
+	// Finished fades are reported once with their final volume and removed.
+	const std::vector< VolumeChange >& update( const float dt, const bool allowSimd = true );
+
+private:
+	size_t advanceSimd( const float dt );
+	void advanceScalar( const size_t begin, const float dt );
+	void removeAt( const size_t index );
+
+	std::vector< float > m_remaining;
+	std::vector< float > m_inverseDuration;
+	std::vector< float > m_startVolume;
+	std::vector< float > m_endVolume;
+	std::vector< float > m_volume;
+	std::vector< int > m_owners;
+	std::unordered_map< int, size_t > m_indices;
+	std::vector< VolumeChange > m_changes;
+	std::vector< size_t > m_finished;
+};
+}
+
+#endif // U_FADER_BANK_H_
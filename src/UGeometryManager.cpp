@@ -0,0 +1,323 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UGeometryManager.cpp                                                      //
+// ========================================================================= //
+
+#include "UGeometryManager.h"
+#include "UAEImplementation.h"
+#include "UAUtils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+using univer::audio::UGeometryManager;
+using univer::audio::UGeometryPolygon;
+
+namespace
+{
+// Chunks built per update at most, building is the expensive part of
+// streaming and the nearest chunks go first.
+constexpr size_t MAX_LOADS_PER_UPDATE = 4;
+// Chunks unload this much further than they load, so the listener walking
+// along the edge does not rebuild them every update.
+constexpr float UNLOAD_SCALE = 1.25f;
+// Fraction of the radius the listener moves before bounds are tested again.
+constexpr float RESTREAM_FRACTION = 0.125f;
+
+void resetBounds( float boundsMin[3], float boundsMax[3] )
+{
+	std::fill( boundsMin, boundsMin + 3, std::numeric_limits< float >::max() );
+	std::fill( boundsMax, boundsMax + 3, std::numeric_limits< float >::lowest() );
+}
+
+void growBounds( float boundsMin[3], float boundsMax[3], const FMOD_VECTOR& vertex )
+{
+	const float point[3] = { vertex.x, vertex.y, vertex.z };
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		boundsMin[axis] = std::min( boundsMin[axis], point[axis] );
+		boundsMax[axis] = std::max( boundsMax[axis], point[axis] );
+	}
+}
+}
+
+UGeometryManager::UGeometryManager( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_streamingRadius( 100.f ),
+	m_streamedPositions{},
+	m_streamedListeners( 1 ),
+	m_isDirty( false ),
+	m_loadedCount( 0 ),
+	m_nextChunkId( 0 )
+{}
+
+UGeometryManager::~UGeometryManager()
+{
+	for ( auto& [chunkId, chunk] : m_chunks )
+	{
+		release( chunk );
+	}
+}
+
+int UGeometryManager::addChunk( std::span< const float > vertices, std::span< const UGeometryPolygon > polygons )
+{
+	size_t vertexCount = 0;
+	for ( const UGeometryPolygon& polygon : polygons )
+	{
+		if ( polygon.vertexCount < 3 )
+		{
+			return -1;
+		}
+		vertexCount += size_t( polygon.vertexCount );
+	}
+	if ( polygons.empty() || vertices.size() != vertexCount * 3 )
+	{
+		return -1;
+	}
+
+	Chunk chunk;
+	if ( checkErrors( m_implementation.system->createGeometry( int( polygons.size() ), int( vertexCount ), &chunk.geometry ) ) )
+	{
+		return -1;
+	}
+	resetBounds( chunk.boundsMin, chunk.boundsMax );
+	std::vector< FMOD_VECTOR > polygonVertices;
+	size_t offset = 0;
+	for ( const UGeometryPolygon& polygon : polygons )
+	{
+		polygonVertices.resize( size_t( polygon.vertexCount ) );
+		for ( FMOD_VECTOR& vertex : polygonVertices )
+		{
+			vertex = { vertices[offset], vertices[offset + 1], vertices[offset + 2] };
+			growBounds( chunk.boundsMin, chunk.boundsMax, vertex );
+			offset += 3;
+		}
+		int polygonIndex = 0;
+		if ( checkErrors( chunk.geometry->addPolygon( polygon.directOcclusion,
+													  polygon.reverbOcclusion,
+													  polygon.doubleSided,
+													  polygon.vertexCount,
+													  polygonVertices.data(),
+													  &polygonIndex ) ) )
+		{
+			checkErrors( chunk.geometry->release() );
+			return -1;
+		}
+	}
+
+	// The cooked blob is what stays in memory while the chunk is far away.
+	int size = 0;
+	if ( checkErrors( chunk.geometry->save( nullptr, &size ) ) )
+	{
+		checkErrors( chunk.geometry->release() );
+		return -1;
+	}
+	chunk.blob.resize( size_t( size ) );
+	if ( checkErrors( chunk.geometry->save( chunk.blob.data(), &size ) ) )
+	{
+		checkErrors( chunk.geometry->release() );
+		return -1;
+	}
+
+	const int chunkId = m_nextChunkId++;
+	m_chunks[chunkId] = std::move( chunk );
+	++m_loadedCount;
+	m_isDirty = true;
+	return chunkId;
+}
+
+int UGeometryManager::loadChunk( const std::string& path )
+{
+	Chunk chunk;
+	chunk.path = path;
+	chunk.geometry = build( chunk );
+	if ( chunk.geometry == nullptr )
+	{
+		return -1;
+	}
+
+	// Cooked blobs carry no bounds, they are taken from the polygons once.
+	resetBounds( chunk.boundsMin, chunk.boundsMax );
+	int polygonCount = 0;
+	checkErrors( chunk.geometry->getNumPolygons( &polygonCount ) );
+	for ( int polygon = 0; polygon < polygonCount; ++polygon )
+	{
+		int vertexCount = 0;
+		checkErrors( chunk.geometry->getPolygonNumVertices( polygon, &vertexCount ) );
+		for ( int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex )
+		{
+			FMOD_VECTOR vertex = {};
+			checkErrors( chunk.geometry->getPolygonVertex( polygon, vertexIndex, &vertex ) );
+			growBounds( chunk.boundsMin, chunk.boundsMax, vertex );
+		}
+	}
+	if ( polygonCount == 0 )
+	{
+		checkErrors( chunk.geometry->release() );
+		return -1;
+	}
+
+	const int chunkId = m_nextChunkId++;
+	m_chunks[chunkId] = std::move( chunk );
+	++m_loadedCount;
+	m_isDirty = true;
+	return chunkId;
+}
+
+bool UGeometryManager::saveChunk( const int chunkId, const std::string& path )
+{
+	auto tChunkIt = m_chunks.find( chunkId );
+	std::vector< char > blob;
+	if ( tChunkIt == m_chunks.end() || !readBlob( tChunkIt->second, blob ) )
+	{
+		return false;
+	}
+	std::ofstream file( path, std::ios::binary );
+	return static_cast< bool >( file.write( blob.data(), std::streamsize( blob.size() ) ) );
+}
+
+void UGeometryManager::removeChunk( const int chunkId )
+{
+	auto tChunkIt = m_chunks.find( chunkId );
+	if ( tChunkIt == m_chunks.end() )
+	{
+		return;
+	}
+	release( tChunkIt->second );
+	m_chunks.erase( tChunkIt );
+}
+
+void UGeometryManager::setStreamingRadius( const float radius )
+{
+	m_streamingRadius = std::max( radius, 0.f );
+	m_isDirty = true;
+}
+
+bool UGeometryManager::isLoaded( const int chunkId ) const
+{
+	auto tChunkIt = m_chunks.find( chunkId );
+	return tChunkIt != m_chunks.end() && tChunkIt->second.geometry != nullptr;
+}
+
+void UGeometryManager::update()
+{
+	// Chunks stream around every listener, bounds are tested again once any
+	// of them moved far enough.
+	const int listenerCount = m_implementation.numListeners;
+	const float restreamDistance = m_streamingRadius * RESTREAM_FRACTION;
+	bool moved = listenerCount != m_streamedListeners;
+	for ( int index = 0; index < listenerCount && !moved; ++index )
+	{
+		const float* listener = m_implementation.listeners[index].position;
+		const float dx = listener[0] - m_streamedPositions[index][0];
+		const float dy = listener[1] - m_streamedPositions[index][1];
+		const float dz = listener[2] - m_streamedPositions[index][2];
+		moved = dx * dx + dy * dy + dz * dz >= restreamDistance * restreamDistance;
+	}
+	if ( !m_isDirty && !moved )
+	{
+		return;
+	}
+	for ( int index = 0; index < listenerCount; ++index )
+	{
+		const float* listener = m_implementation.listeners[index].position;
+		std::copy( listener, listener + 3, m_streamedPositions[index] );
+	}
+	m_streamedListeners = listenerCount;
+
+	const float loadRadiusSquared = m_streamingRadius * m_streamingRadius;
+	const float unloadRadiusSquared = loadRadiusSquared * UNLOAD_SCALE * UNLOAD_SCALE;
+	m_toLoad.clear();
+	for ( auto& [chunkId, chunk] : m_chunks )
+	{
+		const float distance = distanceSquared( chunk );
+		if ( chunk.geometry != nullptr && distance > unloadRadiusSquared )
+		{
+			release( chunk );
+		}
+		else if ( chunk.geometry == nullptr && distance <= loadRadiusSquared )
+		{
+			m_toLoad.emplace_back( distance, chunkId );
+		}
+	}
+	std::sort( m_toLoad.begin(), m_toLoad.end() );
+	const size_t loads = std::min( m_toLoad.size(), MAX_LOADS_PER_UPDATE );
+	for ( size_t i = 0; i < loads; ++i )
+	{
+		Chunk& chunk = m_chunks[m_toLoad[i].second];
+		chunk.geometry = build( chunk );
+		if ( chunk.geometry != nullptr )
+		{
+			++m_loadedCount;
+		}
+	}
+	// Chunks over the load budget are picked up by the next update.
+	m_isDirty = m_toLoad.size() > loads;
+}
+
+bool UGeometryManager::readBlob( const Chunk& chunk, std::vector< char >& blob ) const
+{
+	if ( chunk.path.empty() )
+	{
+		blob = chunk.blob;
+		return !blob.empty();
+	}
+	std::ifstream file( chunk.path, std::ios::binary );
+	if ( !file )
+	{
+		return false;
+	}
+	blob.assign( std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() );
+	return !blob.empty();
+}
+
+::FMOD::Geometry* UGeometryManager::build( const Chunk& chunk ) const
+{
+	std::vector< char > fileBlob;
+	const std::vector< char >* blob = &chunk.blob;
+	if ( !chunk.path.empty() )
+	{
+		if ( !readBlob( chunk, fileBlob ) )
+		{
+			return nullptr;
+		}
+		blob = &fileBlob;
+	}
+	::FMOD::Geometry* geometry = nullptr;
+	if ( checkErrors( m_implementation.system->loadGeometry( blob->data(), int( blob->size() ), &geometry ) ) )
+	{
+		return nullptr;
+	}
+	return geometry;
+}
+
+void UGeometryManager::release( Chunk& chunk )
+{
+	if ( chunk.geometry == nullptr )
+	{
+		return;
+	}
+	checkErrors( chunk.geometry->release() );
+	chunk.geometry = nullptr;
+	--m_loadedCount;
+}
+
+float UGeometryManager::distanceSquared( const Chunk& chunk ) const
+{
+	float closest = std::numeric_limits< float >::max();
+	for ( int index = 0; index < m_implementation.numListeners; ++index )
+	{
+		float distance = 0.f;
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const float p = m_implementation.listeners[index].position[axis];
+			const float outside = std::max( { chunk.boundsMin[axis] - p, p - chunk.boundsMax[axis], 0.f } );
+			distance += outside * outside;
+		}
+		closest = std::min( closest, distance );
+	}
+	return closest;
+}
@@ -0,0 +1,74 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UGeometryManager.h                                                        //
+// ========================================================================= //
+
+#ifndef U_GEOMETRY_MANAGER_H_
+#define U_GEOMETRY_MANAGER_H_
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <map>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+class UAEImplementation;
+
+// Owns the FMOD geometry of the level, split in chunks with an axis aligned
+// bounding box each. Only chunks near the listener exist as FMOD geometry,
+// the others are kept as cooked blobs, or just as a path for chunks loaded
+// from disk.
+class UGeometryManager
+{
+public:
+	explicit UGeometryManager( UAEImplementation& tImplementation );
+	~UGeometryManager();
+
+	int addChunk( std::span< const float > vertices, std::span< const UGeometryPolygon > polygons );
+	int loadChunk( const std::string& path );
+	bool saveChunk( const int chunkId, const std::string& path );
+	void removeChunk( const int chunkId );
+	void setStreamingRadius( const float radius );
+	bool isLoaded( const int chunkId ) const;
+	size_t getLoadedCount() const { return m_loadedCount; }
+
+	// Streams chunks in and out around the listener. Bounds are only tested
+	// again once the listener has moved a fraction of the radius.
+	void update();
+
+private:
+	struct Chunk
+	{
+		::FMOD::Geometry* geometry = nullptr;
+		std::vector< char > blob;
+		std::string path;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	bool readBlob( const Chunk& chunk, std::vector< char >& blob ) const;
+	::FMOD::Geometry* build( const Chunk& chunk ) const;
+	void release( Chunk& chunk );
+	float distanceSquared( const Chunk& chunk ) const;
+
+	UAEImplementation& m_implementation;
+	std::map< int, Chunk > m_chunks;
+	std::vector< std::pair< float, int > > m_toLoad;
+	float m_streamingRadius;
+	// Listener positions at the last bounds test.
+	float m_streamedPositions[MAX_LISTENERS][3];
+	int m_streamedListeners;
+	bool m_isDirty;
+	size_t m_loadedCount;
+	int m_nextChunkId;
+};
+}
+
+#endif // U_GEOMETRY_MANAGER_H_
@@ -0,0 +1,131 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UHdrMixer.cpp                                                             //
+// ========================================================================= //
+
+#include "UHdrMixer.h"
+#include "UAEImplementation.h"
+#include "UChannel.h"
+
+#include <algorithm>
+#include <limits>
+
+using univer::audio::UHdrMixer;
+using univer::audio::USound;
+using univer::audio::UChannel;
+
+namespace
+{
+// Playing voices are only evicted this far below the bottom of the window,
+// the same -6 dB margin virtual channels get, so a voice right at the bottom
+// does not go virtual and resume every update.
+constexpr float EVICT_MARGIN_DB = 6.f;
+}
+
+UHdrMixer::UHdrMixer( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_windowTop( 0.f )
+{}
+
+void UHdrMixer::setSettings( const UHdrSettings& settings )
+{
+	m_settings = settings;
+	m_settings.windowSizedB = std::max( m_settings.windowSizedB, 0.f );
+	m_settings.fadeRangedB = std::clamp( m_settings.fadeRangedB, 0.f, m_settings.windowSizedB );
+	m_settings.releasedBPerSecond = std::max( m_settings.releasedBPerSecond, 0.f );
+	m_windowTop = std::max( m_windowTop, m_settings.referenceLoudnessdB );
+	if ( m_settings.enabled )
+	{
+		return;
+	}
+	// Virtual channels too, they would resume with a stale gain.
+	for ( auto& [channelId, channel] : m_implementation.channels )
+	{
+		channel->setHdrGain( 1.f );
+	}
+	m_windowTop = m_settings.referenceLoudnessdB;
+}
+
+bool UHdrMixer::isInScope( const USound& sound ) const
+{
+	const UBus* scope = m_implementation.findBus( m_settings.busId );
+	const UBus* bus = m_implementation.findBus( sound.busId );
+	return scope != nullptr && bus != nullptr && bus->isWithin( *scope );
+}
+
+bool UHdrMixer::isBelowWindow( const USound& sound, const float audibility ) const
+{
+	if ( !m_settings.enabled || !isInScope( sound ) )
+	{
+		return false;
+	}
+	return m_implementation.volumeTodB( audibility ) + sound.loudnessdB < m_windowTop - m_settings.windowSizedB;
+}
+
+void UHdrMixer::update( const float dt, const std::vector< int >& channelIds )
+{
+	if ( !m_settings.enabled )
+	{
+		return;
+	}
+
+	m_voices.clear();
+	m_levels.clear();
+	m_offsets.clear();
+	for ( const int channelId : channelIds )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		const UChannel& channel = *tChannelIt->second;
+		if ( channel.m_state != UChannel::State::PLAYING || channel.m_stopRequested || channel.m_fmodChannel == nullptr )
+		{
+			continue;
+		}
+		auto tSoundIt = m_implementation.sounds.find( channel.m_soundId );
+		if ( tSoundIt == m_implementation.sounds.end() || !isInScope( *tSoundIt->second ) )
+		{
+			continue;
+		}
+		m_voices.push_back( channelId );
+		m_offsets.push_back( tSoundIt->second->loudnessdB );
+		// The level resuming is judged by, see isBelowWindow.
+		m_levels.push_back( m_implementation.estimateAudibility( *tSoundIt->second, channel ) );
+	}
+	// One vectorized pass turns every level into decibels.
+	m_loudness.resize( m_levels.size() );
+	decibel::todB( m_levels, m_loudness );
+
+	float loudest = -std::numeric_limits< float >::infinity();
+	for ( size_t i = 0; i < m_voices.size(); ++i )
+	{
+		m_loudness[i] += m_offsets[i];
+		loudest = std::max( loudest, m_loudness[i] );
+	}
+	const float target = std::max( loudest, m_settings.referenceLoudnessdB );
+	m_windowTop = target >= m_windowTop ? target : std::max( target, m_windowTop - m_settings.releasedBPerSecond * dt );
+
+	const float bottom = m_windowTop - m_settings.windowSizedB;
+	const float mixGain = m_implementation.dBToVolume( m_settings.referenceLoudnessdB - m_windowTop );
+	for ( size_t i = 0; i < m_voices.size(); ++i )
+	{
+		UChannel& channel = *m_implementation.channels.at( m_voices[i] );
+		if ( m_loudness[i] < bottom - EVICT_MARGIN_DB )
+		{
+			// Loops go virtual and come back once the window drops to them,
+			// one-shots below the window are over.
+			channel.evict();
+			continue;
+		}
+		// Voices in the margin below the window are kept silent.
+		float fade = m_loudness[i] < bottom ? 0.f : 1.f;
+		if ( m_settings.fadeRangedB > 0.f )
+		{
+			fade = std::clamp( ( m_loudness[i] - bottom ) / m_settings.fadeRangedB, 0.f, 1.f );
+		}
+		channel.setHdrGain( mixGain * fade );
+	}
+}
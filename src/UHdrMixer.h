@@ -0,0 +1,52 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UHdrMixer.h                                                               //
+// ========================================================================= //
+
+#ifndef U_HDR_MIXER_H_
+#define U_HDR_MIXER_H_
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <vector>
+
+namespace univer::audio
+{
+class UAEImplementation;
+class USound;
+
+// HDR audio. The loudness of every playing voice on the HDR bus is its
+// estimated level plus the authored loudness of its sound. The loudest voice
+// sets the top of a window of fixed size: the mix is turned down by how far
+// the top is above the reference loudness, voices near the bottom fade out
+// and voices below it lose their FMOD voice. The top rises at once and falls
+// back at the release rate, so a loud event keeps the window up for a while.
+class UHdrMixer
+{
+public:
+	explicit UHdrMixer( UAEImplementation& tImplementation );
+
+	void setSettings( const UHdrSettings& settings );
+	float getWindowTop() const { return m_windowTop; }
+
+	void update( const float dt, const std::vector< int >& channelIds );
+	// Whether a sound heard at this level would start below the window. The
+	// level is the channel one of UAEImplementation::estimateAudibility, the
+	// same update measures playing voices with.
+	bool isBelowWindow( const USound& sound, const float audibility ) const;
+
+private:
+	bool isInScope( const USound& sound ) const;
+
+	UAEImplementation& m_implementation;
+	UHdrSettings m_settings;
+	float m_windowTop;
+	std::vector< int > m_voices;
+	std::vector< float > m_levels;
+	std::vector< float > m_loudness;
+	std::vector< float > m_offsets;
+};
+}
+
+#endif // U_HDR_MIXER_H_
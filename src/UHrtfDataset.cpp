@@ -0,0 +1,216 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UHrtfDataset.cpp                                                          //
+// ========================================================================= //
+
+#include "UHrtfDataset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+using univer::audio::UHrtfDataset;
+
+namespace
+{
+constexpr float DEGREES_TO_RADIANS = 3.14159265358979f / 180.f;
+constexpr size_t SIMD_WIDTH = 8;
+// Resolution of the direction table, interpolation weights are precomputed
+// for every cell so the mixer never searches the measurements.
+constexpr int AZIMUTH_STEPS = 72;
+constexpr int ELEVATION_STEPS = 37;
+constexpr float AZIMUTH_STEP = 360.f / AZIMUTH_STEPS;
+constexpr float ELEVATION_STEP = 180.f / ( ELEVATION_STEPS - 1 );
+
+void toUnitVector( const float azimuth, const float elevation, float vDirection[3] )
+{
+	const float cosElevation = std::cos( elevation * DEGREES_TO_RADIANS );
+	vDirection[0] = -std::sin( azimuth * DEGREES_TO_RADIANS ) * cosElevation;
+	vDirection[1] = std::sin( elevation * DEGREES_TO_RADIANS );
+	vDirection[2] = std::cos( azimuth * DEGREES_TO_RADIANS ) * cosElevation;
+}
+
+template< typename T >
+bool readValue( std::ifstream& file, T& value )
+{
+	return static_cast< bool >( file.read( reinterpret_cast< char* >( &value ), sizeof( T ) ) );
+}
+}
+
+UHrtfDataset::UHrtfDataset( std::span< const float > directions, std::span< const float > hrirs, const size_t hrirLength ) :
+	m_count( std::min( directions.size() / 2, hrirLength > 0 ? hrirs.size() / ( 2 * hrirLength ) : 0 ) ),
+	m_length( hrirLength ),
+	m_stride( ( hrirLength + SIMD_WIDTH - 1 ) / SIMD_WIDTH * SIMD_WIDTH ),
+	m_left( m_count * m_stride, 0.f ),
+	m_right( m_count * m_stride, 0.f )
+{
+	// Stored reversed and front padded, the layout interpolate hands out.
+	const size_t padding = m_stride - m_length;
+	for ( size_t measurement = 0; measurement < m_count; ++measurement )
+	{
+		const float* left = hrirs.data() + measurement * 2 * m_length;
+		const float* right = left + m_length;
+		for ( size_t tap = 0; tap < m_length; ++tap )
+		{
+			m_left[measurement * m_stride + padding + m_length - 1 - tap] = left[tap];
+			m_right[measurement * m_stride + padding + m_length - 1 - tap] = right[tap];
+		}
+	}
+	buildTable( directions );
+}
+
+void UHrtfDataset::buildTable( std::span< const float > directions )
+{
+	std::vector< float > unitVectors( m_count * 3 );
+	for ( size_t measurement = 0; measurement < m_count; ++measurement )
+	{
+		toUnitVector( directions[2 * measurement], directions[2 * measurement + 1], &unitVectors[3 * measurement] );
+	}
+
+	m_table.resize( size_t( AZIMUTH_STEPS ) * ELEVATION_STEPS );
+	for ( int elevationStep = 0; elevationStep < ELEVATION_STEPS; ++elevationStep )
+	{
+		for ( int azimuthStep = 0; azimuthStep < AZIMUTH_STEPS; ++azimuthStep )
+		{
+			float vCell[3];
+			toUnitVector( azimuthStep * AZIMUTH_STEP - 180.f, elevationStep * ELEVATION_STEP - 90.f, vCell );
+
+			// The three closest measurements, weighted by inverse angle.
+			uint32_t best[3] = { 0, 0, 0 };
+			float bestDot[3] = { -2.f, -2.f, -2.f };
+			for ( size_t measurement = 0; measurement < m_count; ++measurement )
+			{
+				const float* vMeasurement = &unitVectors[3 * measurement];
+				const float dot = vCell[0] * vMeasurement[0] + vCell[1] * vMeasurement[1] + vCell[2] * vMeasurement[2];
+				for ( int slot = 0; slot < 3; ++slot )
+				{
+					if ( dot > bestDot[slot] )
+					{
+						for ( int shifted = 2; shifted > slot; --shifted )
+						{
+							best[shifted] = best[shifted - 1];
+							bestDot[shifted] = bestDot[shifted - 1];
+						}
+						best[slot] = uint32_t( measurement );
+						bestDot[slot] = dot;
+						break;
+					}
+				}
+			}
+
+			Blend& blend = m_table[size_t( elevationStep ) * AZIMUTH_STEPS + size_t( azimuthStep )];
+			float total = 0.f;
+			for ( int slot = 0; slot < 3; ++slot )
+			{
+				blend.index[slot] = best[slot];
+				const float angle = std::acos( std::clamp( bestDot[slot], -1.f, 1.f ) );
+				blend.weight[slot] = bestDot[slot] < -1.5f ? 0.f : 1.f / ( angle + 1.0e-3f );
+				total += blend.weight[slot];
+			}
+			for ( int slot = 0; slot < 3; ++slot )
+			{
+				blend.weight[slot] = total > 0.f ? blend.weight[slot] / total : 0.f;
+			}
+		}
+	}
+}
+
+const UHrtfDataset::Blend& UHrtfDataset::lookup( const float azimuth, const float elevation ) const
+{
+	float wrapped = std::fmod( azimuth + 180.f, 360.f );
+	if ( wrapped < 0.f )
+	{
+		wrapped += 360.f;
+	}
+	const int azimuthStep = int( wrapped / AZIMUTH_STEP + 0.5f ) % AZIMUTH_STEPS;
+	const int elevationStep = std::clamp( int( ( elevation + 90.f ) / ELEVATION_STEP + 0.5f ), 0, ELEVATION_STEPS - 1 );
+	return m_table[size_t( elevationStep ) * AZIMUTH_STEPS + size_t( azimuthStep )];
+}
+
+void UHrtfDataset::interpolate( const float azimuth, const float elevation, float* left, float* right ) const
+{
+	if ( m_count == 0 )
+	{
+		std::fill( left, left + m_stride, 0.f );
+		std::fill( right, right + m_stride, 0.f );
+		return;
+	}
+	const Blend& blend = lookup( azimuth, elevation );
+	const float* left0 = &m_left[blend.index[0] * m_stride];
+	const float* left1 = &m_left[blend.index[1] * m_stride];
+	const float* left2 = &m_left[blend.index[2] * m_stride];
+	const float* right0 = &m_right[blend.index[0] * m_stride];
+	const float* right1 = &m_right[blend.index[1] * m_stride];
+	const float* right2 = &m_right[blend.index[2] * m_stride];
+	for ( size_t tap = 0; tap < m_stride; ++tap )
+	{
+		left[tap] = blend.weight[0] * left0[tap] + blend.weight[1] * left1[tap] + blend.weight[2] * left2[tap];
+		right[tap] = blend.weight[0] * right0[tap] + blend.weight[1] * right1[tap] + blend.weight[2] * right2[tap];
+	}
+}
+
+std::shared_ptr< const UHrtfDataset > UHrtfDataset::load( const std::string& path, const int sampleRate )
+{
+	std::ifstream file( path, std::ios::binary );
+	char magic[4] = {};
+	uint32_t version = 0;
+	uint32_t fileSampleRate = 0;
+	uint32_t length = 0;
+	uint32_t count = 0;
+	if ( !file.read( magic, sizeof( magic ) ) || std::memcmp( magic, "UHRT", sizeof( magic ) ) != 0 ||
+		 !readValue( file, version ) || version != 1 || !readValue( file, fileSampleRate ) ||
+		 !readValue( file, length ) || !readValue( file, count ) || length == 0 || count == 0 )
+	{
+		return nullptr;
+	}
+	// Sizes come from the file, they are checked against what is left of it
+	// before allocating. Each measurement is two angles and two responses.
+	const std::streampos dataStart = file.tellg();
+	file.seekg( 0, std::ios::end );
+	const std::streamoff remaining = file.tellg() - dataStart;
+	file.seekg( dataStart );
+	const uint64_t measurementBytes = 2 * sizeof( float ) + 2 * sizeof( float ) * uint64_t( length );
+	if ( !file || remaining < 0 || uint64_t( count ) > uint64_t( remaining ) / measurementBytes )
+	{
+		return nullptr;
+	}
+
+	std::vector< float > directions( size_t( count ) * 2 );
+	std::vector< float > hrirs( size_t( count ) * 2 * length );
+	for ( size_t measurement = 0; measurement < count; ++measurement )
+	{
+		if ( !readValue( file, directions[2 * measurement] ) || !readValue( file, directions[2 * measurement + 1] ) ||
+			 !file.read( reinterpret_cast< char* >( &hrirs[measurement * 2 * length] ), std::streamsize( 2 * length * sizeof( float ) ) ) )
+		{
+			return nullptr;
+		}
+	}
+
+	if ( fileSampleRate == 0 || int( fileSampleRate ) == sampleRate )
+	{
+		return std::make_shared< const UHrtfDataset >( directions, hrirs, length );
+	}
+
+	// Linear resampling is enough for responses this short. Taps are scaled
+	// so the response keeps its gain with the new tap count.
+	const double ratio = double( sampleRate ) / double( fileSampleRate );
+	const float scale = float( 1.0 / ratio );
+	const size_t resampledLength = std::max< size_t >( size_t( double( length ) * ratio ), 1 );
+	std::vector< float > resampled( size_t( count ) * 2 * resampledLength );
+	for ( size_t response = 0; response < size_t( count ) * 2; ++response )
+	{
+		const float* source = &hrirs[response * length];
+		float* target = &resampled[response * resampledLength];
+		for ( size_t tap = 0; tap < resampledLength; ++tap )
+		{
+			const double position = double( tap ) / ratio;
+			const size_t index = std::min< size_t >( size_t( position ), length - 1 );
+			const size_t next = std::min< size_t >( index + 1, length - 1 );
+			const float t = float( position - double( index ) );
+			target[tap] = ( source[index] + ( source[next] - source[index] ) * t ) * scale;
+		}
+	}
+	return std::make_shared< const UHrtfDataset >( directions, resampled, resampledLength );
+}
@@ -0,0 +1,67 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UHrtfDataset.h                                                            //
+// ========================================================================= //
+
+#ifndef U_HRTF_DATASET_H_
+#define U_HRTF_DATASET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace univer::audio
+{
+// Head related impulse responses measured on a sphere of directions, in the
+// spirit of a SOFA SimpleFreeFieldHRIR file. Directions follow SOFA: azimuth
+// in degrees counterclockwise from the front (positive to the left) and
+// elevation in degrees up from the horizontal plane.
+//
+// The file form is a little endian blob:
+//   char magic[4] = "UHRT", uint32 version = 1, uint32 sampleRate,
+//   uint32 hrirLength, uint32 measurementCount,
+//   then per measurement: float azimuth, float elevation,
+//   float left[hrirLength], float right[hrirLength].
+class UHrtfDataset
+{
+public:
+	// hrirs holds the left then the right response of every direction.
+	UHrtfDataset( std::span< const float > directions, std::span< const float > hrirs, const size_t hrirLength );
+
+	// Returns nullptr if the file is missing or malformed. Responses are
+	// resampled to sampleRate when the file was measured at another rate.
+	static std::shared_ptr< const UHrtfDataset > load( const std::string& path, const int sampleRate );
+
+	size_t getMeasurementCount() const { return m_count; }
+	// Taps of the responses written by interpolate, padded for SIMD.
+	size_t getStride() const { return m_stride; }
+
+	// Blends the closest measurements of the direction. The responses are
+	// written reversed and front padded with zeros to getStride() taps, so
+	// the output sample is a plain dot product with the input history.
+	void interpolate( const float azimuth, const float elevation, float* left, float* right ) const;
+
+private:
+	struct Blend
+	{
+		uint32_t index[3];
+		float weight[3];
+	};
+
+	void buildTable( std::span< const float > directions );
+	const Blend& lookup( const float azimuth, const float elevation ) const;
+
+	size_t m_count;
+	size_t m_length;
+	size_t m_stride;
+	std::vector< float > m_left;
+	std::vector< float > m_right;
+	std::vector< Blend > m_table;
+};
+}
+
+#endif // U_HRTF_DATASET_H_
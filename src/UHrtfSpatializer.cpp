@@ -0,0 +1,576 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UHrtfSpatializer.cpp                                                      //
+// ========================================================================= //
+
+#include "UHrtfSpatializer.h"
+#include "UAEImplementation.h"
+#include "UChannel.h"
+#include "UAUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#define U_HRTF_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define U_HRTF_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define U_HRTF_NEON
+#endif
+
+using univer::audio::UHrtfSpatializer;
+using univer::audio::UHrtfDataset;
+using univer::audio::UChannel;
+
+namespace
+{
+constexpr float RADIANS_TO_DEGREES = 180.f / 3.14159265358979f;
+constexpr size_t MAX_BLOCK = 1024;
+// Voices already rendered binaurally rank this much higher, so two voices of
+// similar audibility do not swap their DSP every update.
+constexpr float HOLDER_BONUS = 1.25f;
+
+// Both ears in one pass so every history load is shared. count is a multiple
+// of 8.
+void dot2( const float* left, const float* right, const float* history, const size_t count, float& outLeft, float& outRight )
+{
+	size_t i = 0;
+	float sumLeft = 0.f;
+	float sumRight = 0.f;
+#if defined( U_HRTF_AVX )
+	__m256 accLeft = _mm256_setzero_ps();
+	__m256 accRight = _mm256_setzero_ps();
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		const __m256 x = _mm256_loadu_ps( history + i );
+		accLeft = _mm256_add_ps( accLeft, _mm256_mul_ps( x, _mm256_loadu_ps( left + i ) ) );
+		accRight = _mm256_add_ps( accRight, _mm256_mul_ps( x, _mm256_loadu_ps( right + i ) ) );
+	}
+	alignas( 32 ) float lanes[8];
+	_mm256_store_ps( lanes, accLeft );
+	sumLeft = lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+	_mm256_store_ps( lanes, accRight );
+	sumRight = lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+#elif defined( U_HRTF_SSE )
+	__m128 accLeft = _mm_setzero_ps();
+	__m128 accRight = _mm_setzero_ps();
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const __m128 x = _mm_loadu_ps( history + i );
+		accLeft = _mm_add_ps( accLeft, _mm_mul_ps( x, _mm_loadu_ps( left + i ) ) );
+		accRight = _mm_add_ps( accRight, _mm_mul_ps( x, _mm_loadu_ps( right + i ) ) );
+	}
+	alignas( 16 ) float lanes[4];
+	_mm_store_ps( lanes, accLeft );
+	sumLeft = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm_store_ps( lanes, accRight );
+	sumRight = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined( U_HRTF_NEON )
+	float32x4_t accLeft = vdupq_n_f32( 0.f );
+	float32x4_t accRight = vdupq_n_f32( 0.f );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		const float32x4_t x = vld1q_f32( history + i );
+		accLeft = vmlaq_f32( accLeft, x, vld1q_f32( left + i ) );
+		accRight = vmlaq_f32( accRight, x, vld1q_f32( right + i ) );
+	}
+	float lanes[4];
+	vst1q_f32( lanes, accLeft );
+	sumLeft = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	vst1q_f32( lanes, accRight );
+	sumRight = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for ( ; i < count; ++i )
+	{
+		sumLeft += history[i] * left[i];
+		sumRight += history[i] * right[i];
+	}
+	outLeft = sumLeft;
+	outRight = sumRight;
+}
+
+struct Instance
+{
+	std::atomic< float > azimuth{ 0.f };
+	std::atomic< float > elevation{ 0.f };
+	std::atomic< float > gain{ 1.f };
+	std::shared_ptr< const UHrtfDataset > dataset;
+
+	float appliedAzimuth = 0.f;
+	float appliedElevation = 0.f;
+	float appliedGain = 0.f;
+	bool hasResponse = false;
+	size_t stride = 0;
+	// Interpolated responses, the previous pair is faded out over the block
+	// following a direction change.
+	std::vector< float > left;
+	std::vector< float > right;
+	std::vector< float > previousLeft;
+	std::vector< float > previousRight;
+	// stride - 1 past samples followed by the current block.
+	std::vector< float > history;
+};
+
+Instance* getInstance( FMOD_DSP_STATE* dspState )
+{
+	return static_cast< Instance* >( dspState->plugindata );
+}
+
+FMOD_RESULT F_CALL create( FMOD_DSP_STATE* dspState )
+{
+	dspState->plugindata = new Instance();
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL release( FMOD_DSP_STATE* dspState )
+{
+	delete getInstance( dspState );
+	dspState->plugindata = nullptr;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL reset( FMOD_DSP_STATE* dspState )
+{
+	Instance* instance = getInstance( dspState );
+	std::fill( instance->history.begin(), instance->history.end(), 0.f );
+	instance->hasResponse = false;
+	instance->appliedGain = instance->gain;
+	return FMOD_OK;
+}
+
+void processChunk( Instance& instance, const float* inBuffer, float* outBuffer, const size_t length, const int inChannels, const int outChannels )
+{
+	const size_t stride = instance.stride;
+	float* history = instance.history.data();
+	for ( size_t sample = 0; sample < length; ++sample )
+	{
+		float mono = 0.f;
+		for ( int channel = 0; channel < inChannels; ++channel )
+		{
+			mono += inBuffer[sample * size_t( inChannels ) + size_t( channel )];
+		}
+		history[stride - 1 + sample] = mono / float( inChannels );
+	}
+
+	const float azimuth = instance.azimuth.load( std::memory_order_relaxed );
+	const float elevation = instance.elevation.load( std::memory_order_relaxed );
+	const bool crossfade = instance.hasResponse && ( azimuth != instance.appliedAzimuth || elevation != instance.appliedElevation );
+	if ( crossfade )
+	{
+		instance.previousLeft.swap( instance.left );
+		instance.previousRight.swap( instance.right );
+	}
+	if ( crossfade || !instance.hasResponse )
+	{
+		instance.dataset->interpolate( azimuth, elevation, instance.left.data(), instance.right.data() );
+		instance.appliedAzimuth = azimuth;
+		instance.appliedElevation = elevation;
+		instance.hasResponse = true;
+	}
+
+	const float targetGain = instance.gain.load( std::memory_order_relaxed );
+	const float gainStep = ( targetGain - instance.appliedGain ) / float( length );
+	const float fadeStep = 1.f / float( length );
+	float gain = instance.appliedGain;
+	for ( size_t sample = 0; sample < length; ++sample )
+	{
+		gain += gainStep;
+		float left = 0.f;
+		float right = 0.f;
+		dot2( instance.left.data(), instance.right.data(), history + sample, stride, left, right );
+		if ( crossfade )
+		{
+			float previousLeft = 0.f;
+			float previousRight = 0.f;
+			dot2( instance.previousLeft.data(), instance.previousRight.data(), history + sample, stride, previousLeft, previousRight );
+			const float t = float( sample + 1 ) * fadeStep;
+			left = previousLeft + ( left - previousLeft ) * t;
+			right = previousRight + ( right - previousRight ) * t;
+		}
+		float* out = outBuffer + sample * size_t( outChannels );
+		if ( outChannels == 1 )
+		{
+			out[0] = 0.5f * ( left + right ) * gain;
+			continue;
+		}
+		out[0] = left * gain;
+		out[1] = right * gain;
+		for ( int channel = 2; channel < outChannels; ++channel )
+		{
+			out[channel] = 0.f;
+		}
+	}
+	instance.appliedGain = targetGain;
+	std::copy( history + length, history + length + stride - 1, history );
+}
+
+FMOD_RESULT F_CALL read( FMOD_DSP_STATE* dspState,
+						 float* inBuffer,
+						 float* outBuffer,
+						 unsigned int length,
+						 int inChannels,
+						 int* outChannels )
+{
+	Instance* instance = getInstance( dspState );
+	*outChannels = inChannels;
+	if ( instance->dataset == nullptr || instance->stride == 0 || inChannels <= 0 )
+	{
+		std::memcpy( outBuffer, inBuffer, size_t( length ) * size_t( inChannels ) * sizeof( float ) );
+		return FMOD_OK;
+	}
+	size_t done = 0;
+	while ( done < length )
+	{
+		const size_t chunk = std::min( size_t( length ) - done, MAX_BLOCK );
+		processChunk( *instance,
+					  inBuffer + done * size_t( inChannels ),
+					  outBuffer + done * size_t( inChannels ),
+					  chunk,
+					  inChannels,
+					  inChannels );
+		done += chunk;
+	}
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL setParameterFloat( FMOD_DSP_STATE* dspState, int index, float value )
+{
+	Instance* instance = getInstance( dspState );
+	switch ( index )
+	{
+		case UHrtfSpatializer::AZIMUTH:
+			instance->azimuth = value;
+			return FMOD_OK;
+		case UHrtfSpatializer::ELEVATION:
+			instance->elevation = value;
+			return FMOD_OK;
+		case UHrtfSpatializer::GAIN:
+			instance->gain = value;
+			return FMOD_OK;
+	}
+	return FMOD_ERR_INVALID_PARAM;
+}
+
+FMOD_RESULT F_CALL getParameterFloat( FMOD_DSP_STATE* dspState, int index, float* value, char* )
+{
+	Instance* instance = getInstance( dspState );
+	switch ( index )
+	{
+		case UHrtfSpatializer::AZIMUTH:
+			*value = instance->azimuth;
+			return FMOD_OK;
+		case UHrtfSpatializer::ELEVATION:
+			*value = instance->elevation;
+			return FMOD_OK;
+		case UHrtfSpatializer::GAIN:
+			*value = instance->gain;
+			return FMOD_OK;
+	}
+	return FMOD_ERR_INVALID_PARAM;
+}
+
+// Only called on instances outside the DSP graph, see UHrtfSpatializer::setDataset.
+FMOD_RESULT F_CALL setParameterData( FMOD_DSP_STATE* dspState, int index, void* data, unsigned int length )
+{
+	if ( index != UHrtfSpatializer::DATASET || data == nullptr || length != sizeof( std::shared_ptr< const UHrtfDataset > ) )
+	{
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	Instance* instance = getInstance( dspState );
+	instance->dataset = *static_cast< const std::shared_ptr< const UHrtfDataset >* >( data );
+	instance->stride = instance->dataset != nullptr ? instance->dataset->getStride() : 0;
+	instance->left.assign( instance->stride, 0.f );
+	instance->right.assign( instance->stride, 0.f );
+	instance->previousLeft.assign( instance->stride, 0.f );
+	instance->previousRight.assign( instance->stride, 0.f );
+	instance->history.assign( instance->stride + MAX_BLOCK, 0.f );
+	instance->hasResponse = false;
+	return FMOD_OK;
+}
+
+FMOD_RESULT F_CALL getParameterData( FMOD_DSP_STATE* dspState, int index, void** data, unsigned int* length, char* )
+{
+	if ( index != UHrtfSpatializer::DATASET )
+	{
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	Instance* instance = getInstance( dspState );
+	*data = &instance->dataset;
+	*length = sizeof( instance->dataset );
+	return FMOD_OK;
+}
+
+FMOD_DSP_DESCRIPTION makeDescription()
+{
+	static FMOD_DSP_PARAMETER_DESC azimuth;
+	static FMOD_DSP_PARAMETER_DESC elevation;
+	static FMOD_DSP_PARAMETER_DESC gain;
+	static FMOD_DSP_PARAMETER_DESC dataset;
+	static FMOD_DSP_PARAMETER_DESC* parameters[UHrtfSpatializer::PARAMETER_COUNT] = { &azimuth, &elevation, &gain, &dataset };
+	FMOD_DSP_INIT_PARAMDESC_FLOAT( azimuth, "Azimuth", "deg", "Counterclockwise from the front", -180.f, 180.f, 0.f );
+	FMOD_DSP_INIT_PARAMDESC_FLOAT( elevation, "Elevation", "deg", "Up from the horizontal plane", -90.f, 90.f, 0.f );
+	FMOD_DSP_INIT_PARAMDESC_FLOAT( gain, "Gain", "", "Distance attenuation", 0.f, 1.f, 1.f );
+	FMOD_DSP_INIT_PARAMDESC_DATA( dataset, "Dataset", "", "HRIR dataset", FMOD_DSP_PARAMETER_DATA_TYPE_USER );
+
+	FMOD_DSP_DESCRIPTION description;
+	std::memset( &description, 0, sizeof( description ) );
+	description.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+	std::strncpy( description.name, "univer hrtf", sizeof( description.name ) - 1 );
+	description.version = 1;
+	description.numinputbuffers = 1;
+	description.numoutputbuffers = 1;
+	description.create = &create;
+	description.release = &release;
+	description.reset = &reset;
+	description.read = &read;
+	description.numparameters = UHrtfSpatializer::PARAMETER_COUNT;
+	description.paramdesc = parameters;
+	description.setparameterfloat = &setParameterFloat;
+	description.getparameterfloat = &getParameterFloat;
+	description.setparameterdata = &setParameterData;
+	description.getparameterdata = &getParameterData;
+	return description;
+}
+}
+
+const FMOD_DSP_DESCRIPTION* UHrtfSpatializer::getDescription()
+{
+	static const FMOD_DSP_DESCRIPTION description = makeDescription();
+	return &description;
+}
+
+UHrtfSpatializer::UHrtfSpatializer( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_voiceBudget( 16 ),
+	m_pluginHandle( 0 )
+{
+	checkErrors( m_implementation.system->registerDSP( getDescription(), &m_pluginHandle ) );
+}
+
+UHrtfSpatializer::~UHrtfSpatializer()
+{
+	resizePool( 0 );
+}
+
+void UHrtfSpatializer::setDataset( std::shared_ptr< const UHrtfDataset > dataset )
+{
+	// Instances only take a dataset while detached, so the mixer never sees
+	// the swap.
+	resizePool( 0 );
+	m_dataset = std::move( dataset );
+	if ( isEnabled() )
+	{
+		resizePool( size_t( m_voiceBudget ) );
+	}
+}
+
+void UHrtfSpatializer::setVoiceBudget( const int voices )
+{
+	m_voiceBudget = std::max( voices, 0 );
+	resizePool( isEnabled() ? size_t( m_voiceBudget ) : 0 );
+}
+
+void UHrtfSpatializer::resizePool( const size_t size )
+{
+	while ( m_slots.size() > size )
+	{
+		Slot& slot = m_slots.back();
+		detach( slot );
+		checkErrors( slot.dsp->release() );
+		m_slots.pop_back();
+	}
+	while ( m_slots.size() < size )
+	{
+		Slot slot;
+		if ( checkErrors( m_implementation.system->createDSPByPlugin( m_pluginHandle, &slot.dsp ) ) )
+		{
+			return;
+		}
+		// Mono sources would otherwise keep a single output channel and lose
+		// the interaural difference when FMOD downmixes them.
+		checkErrors( slot.dsp->setChannelFormat( 0, 0, FMOD_SPEAKERMODE_STEREO ) );
+		checkErrors( slot.dsp->setParameterData( DATASET, &m_dataset, sizeof( m_dataset ) ) );
+		m_slots.push_back( slot );
+	}
+}
+
+void UHrtfSpatializer::attach( Slot& slot, UChannel& channel )
+{
+	// Parameters and state are set while the DSP is still out of the graph,
+	// so its first block already renders the right direction.
+	pushParameters( slot, channel );
+	checkErrors( slot.dsp->reset() );
+	if ( checkErrors( channel.m_fmodChannel->addDSP( FMOD_CHANNELCONTROL_DSP_HEAD, slot.dsp ) ) )
+	{
+		return;
+	}
+	// The DSP applies the distance rolloff itself, a 3D level of 0 turns off
+	// FMOD panning and attenuation for the channel.
+	checkErrors( channel.m_fmodChannel->set3DLevel( 0.f ) );
+	slot.fmodChannel = channel.m_fmodChannel;
+	slot.channelId = channel.m_channelId;
+	channel.m_isBinaural = true;
+}
+
+void UHrtfSpatializer::detach( Slot& slot )
+{
+	if ( slot.channelId < 0 )
+	{
+		return;
+	}
+	// The FMOD channel may be gone already, in which case FMOD dropped the
+	// DSP from it and both calls fail harmlessly.
+	slot.fmodChannel->removeDSP( slot.dsp );
+	slot.fmodChannel->set3DLevel( 1.f );
+	auto tChannelIt = m_implementation.channels.find( slot.channelId );
+	if ( tChannelIt != m_implementation.channels.end() )
+	{
+		tChannelIt->second->m_isBinaural = false;
+	}
+	slot.fmodChannel = nullptr;
+	slot.channelId = -1;
+}
+
+void UHrtfSpatializer::rebind( UChannel& channel, ::FMOD::Channel* previousChannel )
+{
+	auto tSlotIt = std::find_if( m_slots.begin(),
+								 m_slots.end(),
+								 [&]( const Slot& slot ) { return slot.channelId == channel.m_channelId && slot.fmodChannel == previousChannel; } );
+	if ( tSlotIt == m_slots.end() )
+	{
+		return;
+	}
+	// The previous channel fades out with FMOD panning for the few ms left.
+	previousChannel->removeDSP( tSlotIt->dsp );
+	previousChannel->set3DLevel( 1.f );
+	pushParameters( *tSlotIt, channel );
+	if ( checkErrors( channel.m_fmodChannel->addDSP( FMOD_CHANNELCONTROL_DSP_HEAD, tSlotIt->dsp ) ) )
+	{
+		tSlotIt->fmodChannel = nullptr;
+		tSlotIt->channelId = -1;
+		channel.m_isBinaural = false;
+		return;
+	}
+	checkErrors( channel.m_fmodChannel->set3DLevel( 0.f ) );
+	tSlotIt->fmodChannel = channel.m_fmodChannel;
+}
+
+void UHrtfSpatializer::pushParameters( Slot& slot, const UChannel& channel )
+{
+	const float* listener = m_implementation.listeners[0].position;
+	const float* forward = m_implementation.listeners[0].forward;
+	const float* up = m_implementation.listeners[0].up;
+	// FMOD is left handed by default, up x forward points right.
+	const float right[3] = { up[1] * forward[2] - up[2] * forward[1],
+							 up[2] * forward[0] - up[0] * forward[2],
+							 up[0] * forward[1] - up[1] * forward[0] };
+	const float offset[3] = { channel.m_apparentPosition[0] - listener[0],
+							  channel.m_apparentPosition[1] - listener[1],
+							  channel.m_apparentPosition[2] - listener[2] };
+	const float x = offset[0] * right[0] + offset[1] * right[1] + offset[2] * right[2];
+	const float y = offset[0] * up[0] + offset[1] * up[1] + offset[2] * up[2];
+	const float z = offset[0] * forward[0] + offset[1] * forward[1] + offset[2] * forward[2];
+	const float horizontal = std::sqrt( x * x + z * z );
+
+	float gain = 1.f;
+	auto tSoundIt = m_implementation.sounds.find( channel.m_soundId );
+	if ( tSoundIt != m_implementation.sounds.end() )
+	{
+		gain = m_implementation.distanceGain( *tSoundIt->second, channel.m_apparentPosition );
+	}
+	checkErrors( slot.dsp->setParameterFloat( AZIMUTH, std::atan2( -x, z ) * RADIANS_TO_DEGREES ) );
+	checkErrors( slot.dsp->setParameterFloat( ELEVATION, std::atan2( y, horizontal ) * RADIANS_TO_DEGREES ) );
+	checkErrors( slot.dsp->setParameterFloat( GAIN, gain ) );
+}
+
+void UHrtfSpatializer::update()
+{
+	if ( m_slots.empty() )
+	{
+		return;
+	}
+
+	m_candidates.clear();
+	for ( const int channelId : m_implementation.awakeChannels )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		const UChannel& channel = *tChannelIt->second;
+		if ( !channel.m_isSpatial || channel.m_state != UChannel::State::PLAYING || channel.m_stopRequested ||
+			 channel.m_fmodChannel == nullptr )
+		{
+			continue;
+		}
+		auto tSoundIt = m_implementation.sounds.find( channel.m_soundId );
+		if ( tSoundIt == m_implementation.sounds.end() ||
+			 m_implementation.isBeyondEffectsLod( *tSoundIt->second, channel.m_position ) )
+		{
+			continue;
+		}
+		float score = m_implementation.estimateAudibility( *tSoundIt->second, channel.m_apparentPosition, channel.m_soundVolume ) *
+					  channel.m_propagationGain;
+		if ( channel.m_isBinaural )
+		{
+			score *= HOLDER_BONUS;
+		}
+		m_candidates.push_back( { channelId, score } );
+	}
+	// With several listeners there is no single head to render for, every
+	// voice goes back to FMOD panning.
+	if ( m_implementation.numListeners > 1 )
+	{
+		m_candidates.clear();
+	}
+	const size_t selected = std::min( m_candidates.size(), m_slots.size() );
+	std::partial_sort( m_candidates.begin(),
+					   m_candidates.begin() + selected,
+					   m_candidates.end(),
+					   []( const Candidate& a, const Candidate& b ) { return a.score > b.score; } );
+
+	// Free the slots of voices that dropped out or lost their FMOD channel.
+	for ( Slot& slot : m_slots )
+	{
+		if ( slot.channelId < 0 )
+		{
+			continue;
+		}
+		auto tCandidateIt = std::find_if( m_candidates.begin(),
+										  m_candidates.begin() + selected,
+										  [&]( const Candidate& candidate ) { return candidate.channelId == slot.channelId; } );
+		auto tChannelIt = m_implementation.channels.find( slot.channelId );
+		if ( tCandidateIt == m_candidates.begin() + selected || tChannelIt == m_implementation.channels.end() ||
+			 tChannelIt->second->m_fmodChannel != slot.fmodChannel )
+		{
+			detach( slot );
+		}
+	}
+
+	for ( size_t i = 0; i < selected; ++i )
+	{
+		UChannel& channel = *m_implementation.channels.at( m_candidates[i].channelId );
+		auto tSlotIt = std::find_if( m_slots.begin(),
+									 m_slots.end(),
+									 [&]( const Slot& slot ) { return slot.channelId == channel.m_channelId; } );
+		if ( tSlotIt == m_slots.end() )
+		{
+			tSlotIt = std::find_if( m_slots.begin(), m_slots.end(), []( const Slot& slot ) { return slot.channelId < 0; } );
+			if ( tSlotIt == m_slots.end() )
+			{
+				break;
+			}
+			attach( *tSlotIt, channel );
+			continue;
+		}
+		pushParameters( *tSlotIt, channel );
+	}
+}
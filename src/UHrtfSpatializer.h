@@ -0,0 +1,83 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UHrtfSpatializer.h                                                        //
+// ========================================================================= //
+
+#ifndef U_HRTF_SPATIALIZER_H_
+#define U_HRTF_SPATIALIZER_H_
+
+#include "UHrtfDataset.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+class UAEImplementation;
+struct UChannel;
+
+// Binaural rendering of the most audible 3D voices. Each of them gets an HRTF
+// DSP from a fixed pool at the head of its FMOD channel, with FMOD 3D panning
+// turned off. Voices past the budget keep standard panning, which bounds the
+// mixer cost to the budget whatever the number of voices.
+class UHrtfSpatializer
+{
+public:
+	enum Parameter
+	{
+		AZIMUTH,
+		ELEVATION,
+		GAIN,
+		DATASET,
+		PARAMETER_COUNT
+	};
+
+	explicit UHrtfSpatializer( UAEImplementation& tImplementation );
+	~UHrtfSpatializer();
+
+	void setDataset( std::shared_ptr< const UHrtfDataset > dataset );
+	void setVoiceBudget( const int voices );
+	bool isEnabled() const { return m_dataset != nullptr && m_voiceBudget > 0; }
+
+	// Reassigns the pool to the most audible voices and pushes their
+	// direction and distance gain. Called once per engine update.
+	void update();
+	// Moves the slot of a channel to its new FMOD channel, keeping the filter
+	// history since the new channel continues the same signal.
+	void rebind( UChannel& channel, ::FMOD::Channel* previousChannel );
+
+	static const FMOD_DSP_DESCRIPTION* getDescription();
+
+private:
+	struct Slot
+	{
+		::FMOD::DSP* dsp = nullptr;
+		::FMOD::Channel* fmodChannel = nullptr;
+		int channelId = -1;
+	};
+
+	struct Candidate
+	{
+		int channelId;
+		float score;
+	};
+
+	void resizePool( const size_t size );
+	void attach( Slot& slot, UChannel& channel );
+	void detach( Slot& slot );
+	void pushParameters( Slot& slot, const UChannel& channel );
+
+	UAEImplementation& m_implementation;
+	std::shared_ptr< const UHrtfDataset > m_dataset;
+	int m_voiceBudget;
+	unsigned int m_pluginHandle;
+	std::vector< Slot > m_slots;
+	std::vector< Candidate > m_candidates;
+};
+}
+
+#endif // U_HRTF_SPATIALIZER_H_
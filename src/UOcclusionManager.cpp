@@ -0,0 +1,300 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UOcclusionManager.cpp                                                     //
+// ========================================================================= //
+
+#include "UOcclusionManager.h"
+#include "UAEImplementation.h"
+#include "UChannel.h"
+#include "UAUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using univer::audio::UOcclusionManager;
+using univer::audio::UOcclusion;
+using univer::audio::UChannel;
+
+namespace
+{
+// Changes under this are not worth an FMOD call.
+constexpr float APPLY_EPSILON = 0.001f;
+
+bool passesHysteresis( const float cached, const float result, const float hysteresis )
+{
+	// Fully clear and fully blocked are always reached, otherwise a path that
+	// opens slowly could stay slightly occluded forever.
+	return std::abs( result - cached ) > hysteresis ||
+		   ( result != cached && ( result == 0.f || result == 1.f ) );
+}
+}
+
+UOcclusionManager::UOcclusionManager( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_frame( 0 )
+{}
+
+void UOcclusionManager::setCallback( URaycastCallback callback )
+{
+	m_callback = std::move( callback );
+	if ( !isEnabled() )
+	{
+		clear();
+	}
+}
+
+void UOcclusionManager::setProbeGrid( std::shared_ptr< const UAcousticProbeGrid > probeGrid )
+{
+	m_probeGrid = std::move( probeGrid );
+	if ( !isEnabled() )
+	{
+		clear();
+		return;
+	}
+	if ( m_probeGrid == nullptr )
+	{
+		// The callback takes over, sends ease back to the FMOD default.
+		for ( auto& [channelId, entry] : m_entries )
+		{
+			entry.reverbSend = 1.f;
+		}
+	}
+}
+
+void UOcclusionManager::clear()
+{
+	for ( auto& [channelId, entry] : m_entries )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt != m_implementation.channels.end() && tChannelIt->second->m_fmodChannel == entry.fmodChannel )
+		{
+			entry.smoothedDirect = 0.f;
+			entry.smoothedReverb = 0.f;
+			entry.smoothedReverbSend = 1.f;
+			apply( entry );
+		}
+	}
+	m_entries.clear();
+}
+
+void UOcclusionManager::update( const float dt, const std::vector< int >& channelIds )
+{
+	if ( !isEnabled() )
+	{
+		return;
+	}
+	++m_frame;
+
+	const unsigned int interval = unsigned( std::max( m_settings.updateInterval, 1 ) );
+	m_due.clear();
+	for ( const int channelId : channelIds )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		const UChannel& channel = *tChannelIt->second;
+		if ( !channel.m_isSpatial || channel.m_fmodChannel == nullptr ||
+			 ( channel.m_state != UChannel::State::PLAYING && channel.m_state != UChannel::State::STOPPING ) )
+		{
+			continue;
+		}
+		Entry& entry = m_entries[channelId];
+		// A channel coming back from virtual has a fresh FMOD channel without
+		// any occlusion set.
+		if ( entry.fmodChannel != channel.m_fmodChannel )
+		{
+			entry = Entry();
+			entry.fmodChannel = channel.m_fmodChannel;
+		}
+		entry.seenFrame = m_frame;
+		// The room graph already routes propagated channels around the walls,
+		// a ray through them would count the same wall twice.
+		if ( channel.m_isPropagated )
+		{
+			store( entry, UOcclusion() );
+			continue;
+		}
+		auto tSoundIt = m_implementation.sounds.find( channel.m_soundId );
+		entry.effectsCulled = tSoundIt != m_implementation.sounds.end() &&
+							  m_implementation.isBeyondEffectsLod( *tSoundIt->second, channel.m_position );
+		if ( entry.effectsCulled && entry.hasResult )
+		{
+			continue;
+		}
+		if ( !entry.hasResult || m_frame - entry.lastCastFrame >= interval )
+		{
+			m_due.push_back( { channelId, entry.hasResult, entry.lastCastFrame } );
+		}
+	}
+
+	m_stale.clear();
+	for ( const auto& [channelId, entry] : m_entries )
+	{
+		if ( entry.seenFrame != m_frame )
+		{
+			m_stale.push_back( channelId );
+		}
+	}
+	for ( const int channelId : m_stale )
+	{
+		m_entries.erase( channelId );
+	}
+
+	if ( m_probeGrid != nullptr )
+	{
+		sampleProbes();
+	}
+	else
+	{
+		castRays();
+	}
+
+	const float blend = m_settings.smoothingSeconds > 0.f ? 1.f - std::exp( -dt / m_settings.smoothingSeconds ) : 1.f;
+	for ( auto& [channelId, entry] : m_entries )
+	{
+		entry.smoothedDirect += ( entry.direct - entry.smoothedDirect ) * blend;
+		entry.smoothedReverb += ( entry.reverb - entry.smoothedReverb ) * blend;
+		if ( std::abs( entry.direct - entry.smoothedDirect ) < APPLY_EPSILON )
+		{
+			entry.smoothedDirect = entry.direct;
+		}
+		if ( std::abs( entry.reverb - entry.smoothedReverb ) < APPLY_EPSILON )
+		{
+			entry.smoothedReverb = entry.reverb;
+		}
+		entry.smoothedReverbSend += ( entry.reverbSend - entry.smoothedReverbSend ) * blend;
+		if ( std::abs( entry.reverbSend - entry.smoothedReverbSend ) < APPLY_EPSILON )
+		{
+			entry.smoothedReverbSend = entry.reverbSend;
+		}
+		if ( entry.smoothedDirect != entry.appliedDirect || entry.smoothedReverb != entry.appliedReverb ||
+			 entry.smoothedReverbSend != entry.appliedReverbSend || entry.effectsCulled != entry.appliedEffectsCulled )
+		{
+			apply( entry );
+		}
+	}
+}
+
+void UOcclusionManager::rebind( const int channelId, ::FMOD::Channel* fmodChannel )
+{
+	auto tEntryIt = m_entries.find( channelId );
+	if ( tEntryIt == m_entries.end() )
+	{
+		return;
+	}
+	Entry& entry = tEntryIt->second;
+	entry.fmodChannel = fmodChannel;
+	// The new channel has the FMOD defaults, a full reverb send included.
+	entry.appliedReverbSend = 1.f;
+	apply( entry );
+}
+
+void UOcclusionManager::castRays()
+{
+	// Channels that never got a result go first, then the ones that waited
+	// the longest, so a starved channel is never starved twice in a row.
+	std::sort( m_due.begin(), m_due.end(), []( const Due& a, const Due& b )
+	{
+		if ( a.hasResult != b.hasResult )
+		{
+			return !a.hasResult;
+		}
+		return a.lastCastFrame < b.lastCastFrame;
+	} );
+
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	const auto timeBudget = std::chrono::duration< float, std::milli >( m_settings.maxMillisecondsPerUpdate );
+	const size_t rayBudget = size_t( std::max( m_settings.maxRaysPerUpdate, 0 ) );
+	size_t rays = 0;
+	for ( const Due& item : m_due )
+	{
+		if ( rays >= rayBudget ||
+			 ( m_settings.maxMillisecondsPerUpdate > 0.f && rays > 0 && Clock::now() - start >= timeBudget ) )
+		{
+			break;
+		}
+		auto tEntryIt = m_entries.find( item.channelId );
+		auto tChannelIt = m_implementation.channels.find( item.channelId );
+		if ( tEntryIt == m_entries.end() || tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		const float* position = tChannelIt->second->m_position;
+		store( tEntryIt->second, m_callback( m_implementation.closestListener( position ), position ) );
+		++rays;
+	}
+}
+
+void UOcclusionManager::sampleProbes()
+{
+	// A probe lookup is a few byte reads, so every channel is sampled on every
+	// update and the budget only applies to callback rays.
+	for ( auto& [channelId, entry] : m_entries )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		const float* position = tChannelIt->second->m_position;
+		const bool isFirst = !entry.hasResult;
+		if ( !tChannelIt->second->m_isPropagated )
+		{
+			store( entry, m_probeGrid->sampleOcclusion( m_implementation.closestListener( position ), position ) );
+		}
+		entry.reverbSend = m_probeGrid->sampleReverbSend( position );
+		if ( isFirst )
+		{
+			entry.smoothedReverbSend = entry.reverbSend;
+		}
+	}
+}
+
+void UOcclusionManager::store( Entry& entry, const UOcclusion& result )
+{
+	// Obstruction blocks the direct path only, occlusion blocks both.
+	const float occlusion = std::clamp( result.occlusion, 0.f, 1.f );
+	const float direct = std::max( std::clamp( result.obstruction, 0.f, 1.f ), occlusion );
+	entry.lastCastFrame = m_frame;
+	if ( !entry.hasResult )
+	{
+		// The first result is applied at once, a channel starting behind a
+		// wall must not be heard through it while the filter settles.
+		entry.hasResult = true;
+		entry.direct = entry.smoothedDirect = direct;
+		entry.reverb = entry.smoothedReverb = occlusion;
+		return;
+	}
+	if ( passesHysteresis( entry.direct, direct, m_settings.hysteresis ) )
+	{
+		entry.direct = direct;
+	}
+	if ( passesHysteresis( entry.reverb, occlusion, m_settings.hysteresis ) )
+	{
+		entry.reverb = occlusion;
+	}
+}
+
+void UOcclusionManager::apply( Entry& entry )
+{
+	// FMOD occlusion scales the path volume by 1 - occlusion, so a blocked
+	// path ends at the blocked volume rather than at silence.
+	const float attenuation = 1.f - m_implementation.dBToVolume( m_settings.blockedVolumedB );
+	const float lowPassGain = 1.f - entry.smoothedDirect * ( 1.f - m_settings.blockedLowPassGain );
+	checkErrors( entry.fmodChannel->set3DOcclusion( entry.smoothedDirect * attenuation, entry.smoothedReverb * attenuation ) );
+	// A low pass gain of 1 takes the filter out of the channel DSP chain.
+	checkErrors( entry.fmodChannel->setLowPassGain( entry.effectsCulled ? 1.f : std::clamp( lowPassGain, 0.f, 1.f ) ) );
+	if ( entry.smoothedReverbSend != entry.appliedReverbSend )
+	{
+		checkErrors( entry.fmodChannel->setReverbProperties( 0, entry.smoothedReverbSend ) );
+	}
+	entry.appliedDirect = entry.smoothedDirect;
+	entry.appliedReverb = entry.smoothedReverb;
+	entry.appliedReverbSend = entry.smoothedReverbSend;
+	entry.appliedEffectsCulled = entry.effectsCulled;
+}
@@ -0,0 +1,97 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UOcclusionManager.h                                                       //
+// ========================================================================= //
+
+#ifndef U_OCCLUSION_MANAGER_H_
+#define U_OCCLUSION_MANAGER_H_
+
+#include "UAcousticProbeGrid.h"
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+class UAEImplementation;
+
+// Raycasts from the listener to the playing 3D channels through a user
+// callback. Rays are spread over updates under a ray and time budget, the
+// last result of every channel is cached, and the FMOD occlusion and low pass
+// of the channel ease towards it. A baked probe grid replaces the callback
+// when set: it is cheap enough to sample every channel on every update, and
+// also drives the reverb send of the channels.
+class UOcclusionManager
+{
+public:
+	explicit UOcclusionManager( UAEImplementation& tImplementation );
+
+	void setCallback( URaycastCallback callback );
+	void setSettings( const UOcclusionSettings& settings ) { m_settings = settings; }
+	void setProbeGrid( std::shared_ptr< const UAcousticProbeGrid > probeGrid );
+	bool isEnabled() const { return m_callback || m_probeGrid != nullptr; }
+
+	// Casts the rays due within the budget and smooths every tracked channel.
+	// Channels not in the list, or without a voice, stop being tracked.
+	void update( const float dt, const std::vector< int >& channelIds );
+
+	// Moves the cached result of a channel to the FMOD channel that replaces
+	// it, such as the variant after a LOD switch, and applies it at once.
+	void rebind( const int channelId, ::FMOD::Channel* fmodChannel );
+
+	size_t getTrackedCount() const { return m_entries.size(); }
+
+private:
+	struct Entry
+	{
+		::FMOD::Channel* fmodChannel = nullptr;
+		unsigned int lastCastFrame = 0;
+		unsigned int seenFrame = 0;
+		bool hasResult = false;
+		// Cached ray result and the smoothed value applied to FMOD.
+		float direct = 0.f;
+		float reverb = 0.f;
+		float smoothedDirect = 0.f;
+		float smoothedReverb = 0.f;
+		float appliedDirect = 0.f;
+		float appliedReverb = 0.f;
+		float reverbSend = 1.f;
+		float smoothedReverbSend = 1.f;
+		float appliedReverbSend = 1.f;
+		// Past the effects LOD distance the last result is kept and only
+		// applied as a volume, without the low pass.
+		bool effectsCulled = false;
+		bool appliedEffectsCulled = false;
+	};
+
+	struct Due
+	{
+		int channelId;
+		bool hasResult;
+		unsigned int lastCastFrame;
+	};
+
+	void castRays();
+	void sampleProbes();
+	void clear();
+	void store( Entry& entry, const UOcclusion& result );
+	void apply( Entry& entry );
+
+	UAEImplementation& m_implementation;
+	URaycastCallback m_callback;
+	std::shared_ptr< const UAcousticProbeGrid > m_probeGrid;
+	UOcclusionSettings m_settings;
+	std::unordered_map< int, Entry > m_entries;
+	std::vector< Due > m_due;
+	std::vector< int > m_stale;
+	unsigned int m_frame;
+};
+}
+
+#endif // U_OCCLUSION_MANAGER_H_
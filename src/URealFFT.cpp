@@ -0,0 +1,154 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// URealFFT.cpp                                                              //
+// ========================================================================= //
+
+#include "URealFFT.h"
+
+#include <cmath>
+#include <utility>
+
+using univer::audio::URealFFT;
+
+URealFFT::URealFFT( const size_t size ) :
+	m_size( size ),
+	m_half( size / 2 ),
+	m_bitReverse( size / 2 ),
+	m_cos( size / 4 ),
+	m_sin( size / 4 ),
+	m_splitCos( size / 2 + 1 ),
+	m_splitSin( size / 2 + 1 ),
+	m_workRe( size / 2 ),
+	m_workIm( size / 2 )
+{
+	const double pi = 3.14159265358979323846;
+	size_t bits = 0;
+	while ( ( size_t( 1 ) << bits ) < m_half )
+	{
+		++bits;
+	}
+	for ( size_t i = 0; i < m_half; ++i )
+	{
+		size_t reversed = 0;
+		for ( size_t bit = 0; bit < bits; ++bit )
+		{
+			reversed |= ( ( i >> bit ) & 1 ) << ( bits - 1 - bit );
+		}
+		m_bitReverse[i] = reversed;
+	}
+	for ( size_t k = 0; k < m_cos.size(); ++k )
+	{
+		const double angle = -2.0 * pi * double( k ) / double( m_half );
+		m_cos[k] = float( std::cos( angle ) );
+		m_sin[k] = float( std::sin( angle ) );
+	}
+	for ( size_t k = 0; k <= m_half; ++k )
+	{
+		const double angle = -2.0 * pi * double( k ) / double( m_size );
+		m_splitCos[k] = float( std::cos( angle ) );
+		m_splitSin[k] = float( std::sin( angle ) );
+	}
+}
+
+void URealFFT::transform( const bool inverse )
+{
+	float* re = m_workRe.data();
+	float* im = m_workIm.data();
+	for ( size_t i = 0; i < m_half; ++i )
+	{
+		const size_t j = m_bitReverse[i];
+		if ( j > i )
+		{
+			std::swap( re[i], re[j] );
+			std::swap( im[i], im[j] );
+		}
+	}
+	// Iterative radix 2 decimation in time, the inverse uses the conjugate
+	// twiddles.
+	const float sign = inverse ? -1.f : 1.f;
+	for ( size_t length = 2; length <= m_half; length <<= 1 )
+	{
+		const size_t halfLength = length >> 1;
+		const size_t stride = m_half / length;
+		for ( size_t start = 0; start < m_half; start += length )
+		{
+			for ( size_t k = 0; k < halfLength; ++k )
+			{
+				const float wr = m_cos[k * stride];
+				const float wi = sign * m_sin[k * stride];
+				const size_t a = start + k;
+				const size_t b = a + halfLength;
+				const float tr = re[b] * wr - im[b] * wi;
+				const float ti = re[b] * wi + im[b] * wr;
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+void URealFFT::forward( const float* input, float* re, float* im )
+{
+	// Even samples go to the real part and odd samples to the imaginary part.
+	for ( size_t n = 0; n < m_half; ++n )
+	{
+		m_workRe[n] = input[2 * n];
+		m_workIm[n] = input[2 * n + 1];
+	}
+	transform( false );
+
+	// X[k] = E[k] + W^k O[k], with E and O recovered from Z[k] and Z[N/2 - k].
+	for ( size_t k = 0; k <= m_half; ++k )
+	{
+		const size_t a = k == m_half ? 0 : k;
+		const size_t b = k == 0 ? 0 : m_half - k;
+		const float zr = m_workRe[a];
+		const float zi = m_workIm[a];
+		const float cr = m_workRe[b];
+		const float ci = -m_workIm[b];
+		const float er = 0.5f * ( zr + cr );
+		const float ei = 0.5f * ( zi + ci );
+		// O = -i / 2 * ( Z - conj( Z' ) )
+		const float orr = 0.5f * ( zi - ci );
+		const float oi = -0.5f * ( zr - cr );
+		const float wr = m_splitCos[k];
+		const float wi = m_splitSin[k];
+		re[k] = er + orr * wr - oi * wi;
+		im[k] = ei + orr * wi + oi * wr;
+	}
+}
+
+void URealFFT::inverse( const float* re, const float* im, float* output )
+{
+	// E[k] = ( X[k] + conj( X[N/2 - k] ) ) / 2 and
+	// O[k] = ( X[k] - conj( X[N/2 - k] ) ) / 2 * W^-k, then Z = E + i O.
+	for ( size_t k = 0; k < m_half; ++k )
+	{
+		const size_t b = m_half - k;
+		const float xr = re[k];
+		const float xi = im[k];
+		const float cr = re[b];
+		const float ci = -im[b];
+		const float er = 0.5f * ( xr + cr );
+		const float ei = 0.5f * ( xi + ci );
+		const float dr = 0.5f * ( xr - cr );
+		const float di = 0.5f * ( xi - ci );
+		const float wr = m_splitCos[k];
+		const float wi = -m_splitSin[k];
+		const float orr = dr * wr - di * wi;
+		const float oi = dr * wi + di * wr;
+		m_workRe[k] = er - oi;
+		m_workIm[k] = ei + orr;
+	}
+	transform( true );
+
+	const float scale = 1.f / float( m_half );
+	for ( size_t n = 0; n < m_half; ++n )
+	{
+		output[2 * n] = m_workRe[n] * scale;
+		output[2 * n + 1] = m_workIm[n] * scale;
+	}
+}
@@ -0,0 +1,47 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// URealFFT.h                                                                //
+// ========================================================================= //
+
+#ifndef U_REAL_FFT_H_
+#define U_REAL_FFT_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace univer::audio
+{
+// FFT of real signals of a power of two size, computed through a complex FFT
+// of half the size. Spectra hold size / 2 + 1 bins as separate real and
+// imaginary arrays, which is the layout the convolution kernels multiply.
+class URealFFT
+{
+public:
+	explicit URealFFT( const size_t size );
+
+	size_t getSize() const { return m_size; }
+	size_t getBinCount() const { return m_size / 2 + 1; }
+
+	void forward( const float* input, float* re, float* im );
+	// Includes the 1 / size scale, so inverse( forward( x ) ) == x.
+	void inverse( const float* re, const float* im, float* output );
+
+private:
+	void transform( const bool inverse );
+
+	size_t m_size;
+	size_t m_half;
+	std::vector< size_t > m_bitReverse;
+	// Twiddles of the half size complex FFT.
+	std::vector< float > m_cos;
+	std::vector< float > m_sin;
+	// Twiddles of the split between the half size FFT and the real spectrum.
+	std::vector< float > m_splitCos;
+	std::vector< float > m_splitSin;
+	std::vector< float > m_workRe;
+	std::vector< float > m_workIm;
+};
+}
+
+#endif // U_REAL_FFT_H_
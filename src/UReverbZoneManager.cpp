@@ -0,0 +1,238 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UReverbZoneManager.cpp                                                    //
+// ========================================================================= //
+
+#include "UReverbZoneManager.h"
+#include "UAEImplementation.h"
+#include "UAUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+using univer::audio::UReverbZoneManager;
+using univer::audio::UReverbPreset;
+
+namespace
+{
+// Zones blended at most, the weakest ones past this are ignored.
+constexpr size_t MAX_BLENDED_ZONES = 4;
+// The listener moves this far before the blend is computed again.
+constexpr float REBLEND_DISTANCE = 0.25f;
+// The Reverb3D is centered on the listener with a reach far beyond the
+// reblend distance, so FMOD always sees the listener fully inside it.
+constexpr float REVERB_REACH = 1000.f;
+// FMOD presets go down to -80 dB, which is treated as no reverb at all.
+constexpr float SILENT_WET_LEVEL = -80.f;
+
+const FMOD_REVERB_PROPERTIES PRESETS[] = {
+	FMOD_PRESET_OFF,
+	FMOD_PRESET_GENERIC,
+	FMOD_PRESET_PADDEDCELL,
+	FMOD_PRESET_ROOM,
+	FMOD_PRESET_BATHROOM,
+	FMOD_PRESET_LIVINGROOM,
+	FMOD_PRESET_STONEROOM,
+	FMOD_PRESET_AUDITORIUM,
+	FMOD_PRESET_CONCERTHALL,
+	FMOD_PRESET_CAVE,
+	FMOD_PRESET_ARENA,
+	FMOD_PRESET_HANGAR,
+	FMOD_PRESET_CARPETTEDHALLWAY,
+	FMOD_PRESET_HALLWAY,
+	FMOD_PRESET_STONECORRIDOR,
+	FMOD_PRESET_ALLEY,
+	FMOD_PRESET_FOREST,
+	FMOD_PRESET_CITY,
+	FMOD_PRESET_MOUNTAINS,
+	FMOD_PRESET_QUARRY,
+	FMOD_PRESET_PLAIN,
+	FMOD_PRESET_PARKINGLOT,
+	FMOD_PRESET_SEWERPIPE,
+	FMOD_PRESET_UNDERWATER
+};
+}
+
+UReverbZoneManager::UReverbZoneManager( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_reverb( nullptr ),
+	m_grid( 32.f ),
+	m_ambient( FMOD_PRESET_OFF ),
+	m_largestRadius( 0.f ),
+	m_blendedPosition{ 0.f, 0.f, 0.f },
+	m_isDirty( false ),
+	m_isActive( false ),
+	m_nextZoneId( 0 )
+{}
+
+UReverbZoneManager::~UReverbZoneManager()
+{
+	if ( m_reverb != nullptr )
+	{
+		checkErrors( m_reverb->release() );
+	}
+}
+
+FMOD_REVERB_PROPERTIES UReverbZoneManager::getPresetProperties( const UReverbPreset preset )
+{
+	const size_t index = size_t( preset );
+	return index < std::size( PRESETS ) ? PRESETS[index] : PRESETS[0];
+}
+
+int UReverbZoneManager::addZone( const float vCenter[3], const float minDistance, const float maxDistance, const UReverbPreset preset )
+{
+	if ( minDistance < 0.f || maxDistance <= 0.f || maxDistance < minDistance || !ensureReverb() )
+	{
+		return -1;
+	}
+	const int zoneId = m_nextZoneId++;
+	Zone& zone = m_zones[zoneId];
+	std::copy( vCenter, vCenter + 3, zone.center );
+	zone.minDistance = minDistance;
+	zone.maxDistance = maxDistance;
+	zone.properties = getPresetProperties( preset );
+	m_grid.insert( zoneId, vCenter );
+	m_largestRadius = std::max( m_largestRadius, maxDistance );
+	m_isDirty = true;
+	return zoneId;
+}
+
+void UReverbZoneManager::setZonePreset( const int zoneId, const UReverbPreset preset )
+{
+	auto tZoneIt = m_zones.find( zoneId );
+	if ( tZoneIt == m_zones.end() )
+	{
+		return;
+	}
+	tZoneIt->second.properties = getPresetProperties( preset );
+	m_isDirty = true;
+}
+
+void UReverbZoneManager::removeZone( const int zoneId )
+{
+	if ( m_zones.erase( zoneId ) == 0 )
+	{
+		return;
+	}
+	m_grid.remove( zoneId );
+	m_largestRadius = 0.f;
+	for ( const auto& [id, zone] : m_zones )
+	{
+		m_largestRadius = std::max( m_largestRadius, zone.maxDistance );
+	}
+	m_isDirty = true;
+}
+
+void UReverbZoneManager::setAmbient( const UReverbPreset preset )
+{
+	m_ambient = getPresetProperties( preset );
+	if ( preset != UReverbPreset::OFF )
+	{
+		ensureReverb();
+	}
+	m_isDirty = true;
+}
+
+bool UReverbZoneManager::ensureReverb()
+{
+	// FMOD only creates its reverb DSP once a Reverb3D exists, so engines
+	// without zones pay nothing for it.
+	if ( m_reverb == nullptr && checkErrors( m_implementation.system->createReverb3D( &m_reverb ) ) )
+	{
+		m_reverb = nullptr;
+		return false;
+	}
+	if ( !m_isActive )
+	{
+		checkErrors( m_reverb->setActive( false ) );
+	}
+	return true;
+}
+
+void UReverbZoneManager::update()
+{
+	if ( m_reverb == nullptr )
+	{
+		return;
+	}
+	const float* listener = m_implementation.listeners[0].position;
+	const float dx = listener[0] - m_blendedPosition[0];
+	const float dy = listener[1] - m_blendedPosition[1];
+	const float dz = listener[2] - m_blendedPosition[2];
+	if ( !m_isDirty && dx * dx + dy * dy + dz * dz < REBLEND_DISTANCE * REBLEND_DISTANCE )
+	{
+		return;
+	}
+	std::copy( listener, listener + 3, m_blendedPosition );
+	m_isDirty = false;
+
+	m_nearby.clear();
+	m_grid.query( listener, m_largestRadius, m_nearby );
+	m_contributions.clear();
+	for ( const int zoneId : m_nearby )
+	{
+		const Zone& zone = m_zones[zoneId];
+		const float zoneDx = zone.center[0] - listener[0];
+		const float zoneDy = zone.center[1] - listener[1];
+		const float zoneDz = zone.center[2] - listener[2];
+		const float distance = std::sqrt( zoneDx * zoneDx + zoneDy * zoneDy + zoneDz * zoneDz );
+		if ( distance >= zone.maxDistance )
+		{
+			continue;
+		}
+		const float weight = distance <= zone.minDistance ? 1.f : ( zone.maxDistance - distance ) / ( zone.maxDistance - zone.minDistance );
+		m_contributions.push_back( { weight, &zone.properties } );
+	}
+	if ( m_contributions.size() > MAX_BLENDED_ZONES )
+	{
+		std::partial_sort( m_contributions.begin(),
+						   m_contributions.begin() + MAX_BLENDED_ZONES,
+						   m_contributions.end(),
+						   []( const Contribution& a, const Contribution& b ) { return a.weight > b.weight; } );
+		m_contributions.resize( MAX_BLENDED_ZONES );
+	}
+
+	// Overlapping zones share the blend, the ambient reverb fills whatever
+	// weight the zones leave.
+	float total = 0.f;
+	for ( const Contribution& contribution : m_contributions )
+	{
+		total += contribution.weight;
+	}
+	const float scale = total > 1.f ? 1.f / total : 1.f;
+	m_contributions.push_back( { std::max( 1.f - total, 0.f ), &m_ambient } );
+
+	FMOD_REVERB_PROPERTIES blended = {};
+	float* blendedFields = &blended.DecayTime;
+	float wetVolume = 0.f;
+	for ( const Contribution& contribution : m_contributions )
+	{
+		const float weight = contribution.properties == &m_ambient ? contribution.weight : contribution.weight * scale;
+		const float* fields = &contribution.properties->DecayTime;
+		for ( size_t field = 0; field < sizeof( FMOD_REVERB_PROPERTIES ) / sizeof( float ); ++field )
+		{
+			blendedFields[field] += fields[field] * weight;
+		}
+		// The wet level blends as a gain, a dB average would let a silent
+		// zone drag its neighbours down by tens of dB.
+		if ( contribution.properties->WetLevel > SILENT_WET_LEVEL )
+		{
+			wetVolume += m_implementation.dBToVolume( contribution.properties->WetLevel ) * weight;
+		}
+	}
+	blended.WetLevel = std::max( m_implementation.volumeTodB( wetVolume ), SILENT_WET_LEVEL );
+
+	const bool active = blended.WetLevel > SILENT_WET_LEVEL;
+	if ( active )
+	{
+		const FMOD_VECTOR position = { listener[0], listener[1], listener[2] };
+		checkErrors( m_reverb->set3DAttributes( &position, REVERB_REACH, 2.f * REVERB_REACH ) );
+		checkErrors( m_reverb->setProperties( &blended ) );
+	}
+	if ( active != m_isActive )
+	{
+		checkErrors( m_reverb->setActive( active ) );
+		m_isActive = active;
+	}
+}
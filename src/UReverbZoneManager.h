@@ -0,0 +1,75 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UReverbZoneManager.h                                                      //
+// ========================================================================= //
+
+#ifndef U_REVERB_ZONE_MANAGER_H_
+#define U_REVERB_ZONE_MANAGER_H_
+
+#include "USpatialGrid.h"
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <map>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+class UAEImplementation;
+
+// Reverb zones indexed by a spatial grid. Instead of one FMOD Reverb3D per
+// zone, the few zones around the listener are blended on the engine side and
+// the result drives a single Reverb3D that follows the listener, so FMOD only
+// ever evaluates one 3D reverb.
+class UReverbZoneManager
+{
+public:
+	explicit UReverbZoneManager( UAEImplementation& tImplementation );
+	~UReverbZoneManager();
+
+	int addZone( const float vCenter[3], const float minDistance, const float maxDistance, const UReverbPreset preset );
+	void setZonePreset( const int zoneId, const UReverbPreset preset );
+	void removeZone( const int zoneId );
+	void setAmbient( const UReverbPreset preset );
+
+	// Blends the zones around the listener into the reverb properties.
+	void update();
+
+	static FMOD_REVERB_PROPERTIES getPresetProperties( const UReverbPreset preset );
+
+private:
+	struct Zone
+	{
+		float center[3];
+		float minDistance;
+		float maxDistance;
+		FMOD_REVERB_PROPERTIES properties;
+	};
+
+	struct Contribution
+	{
+		float weight;
+		const FMOD_REVERB_PROPERTIES* properties;
+	};
+
+	bool ensureReverb();
+
+	UAEImplementation& m_implementation;
+	::FMOD::Reverb3D* m_reverb;
+	std::map< int, Zone > m_zones;
+	USpatialGrid m_grid;
+	std::vector< int > m_nearby;
+	std::vector< Contribution > m_contributions;
+	FMOD_REVERB_PROPERTIES m_ambient;
+	float m_largestRadius;
+	float m_blendedPosition[3];
+	bool m_isDirty;
+	bool m_isActive;
+	int m_nextZoneId;
+};
+}
+
+#endif // U_REVERB_ZONE_MANAGER_H_
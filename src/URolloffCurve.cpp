@@ -0,0 +1,108 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// URolloffCurve.cpp                                                         //
+// ========================================================================= //
+
+#include "URolloffCurve.h"
+
+#include <algorithm>
+#include <cmath>
+
+using univer::audio::URolloffCurve;
+using univer::audio::URolloffPoint;
+
+std::shared_ptr< const URolloffCurve > URolloffCurve::bake( std::span< const URolloffPoint > points )
+{
+	if ( points.size() < 2 || points.front().distance < 0.f )
+	{
+		return nullptr;
+	}
+	const size_t count = points.size();
+	std::vector< float > secants( count - 1 );
+	for ( size_t i = 0; i + 1 < count; ++i )
+	{
+		const float width = points[i + 1].distance - points[i].distance;
+		if ( !( width > 0.f ) )
+		{
+			return nullptr;
+		}
+		secants[i] = ( std::clamp( points[i + 1].gain, 0.f, 1.f ) - std::clamp( points[i].gain, 0.f, 1.f ) ) / width;
+	}
+
+	// Fritsch-Carlson tangents: flat at local extrema and limited so every
+	// segment stays monotone.
+	std::vector< float > tangents( count );
+	tangents.front() = secants.front();
+	tangents.back() = secants.back();
+	for ( size_t i = 1; i + 1 < count; ++i )
+	{
+		tangents[i] = secants[i - 1] * secants[i] <= 0.f ? 0.f : 0.5f * ( secants[i - 1] + secants[i] );
+	}
+	for ( size_t i = 0; i + 1 < count; ++i )
+	{
+		if ( secants[i] == 0.f )
+		{
+			tangents[i] = tangents[i + 1] = 0.f;
+			continue;
+		}
+		const float a = tangents[i] / secants[i];
+		const float b = tangents[i + 1] / secants[i];
+		const float length = a * a + b * b;
+		if ( length > 9.f )
+		{
+			const float tau = 3.f / std::sqrt( length );
+			tangents[i] = tau * a * secants[i];
+			tangents[i + 1] = tau * b * secants[i];
+		}
+	}
+
+	auto curve = std::make_shared< URolloffCurve >();
+	curve->m_range = points.back().distance;
+	const float step = curve->m_range / float( TABLE_SIZE - 1 );
+	curve->m_inverseStep = 1.f / step;
+	curve->m_gains.resize( TABLE_SIZE );
+	curve->m_fmodPoints.resize( TABLE_SIZE );
+	size_t segment = 0;
+	for ( size_t sample = 0; sample < TABLE_SIZE; ++sample )
+	{
+		const float distance = sample + 1 == TABLE_SIZE ? curve->m_range : float( sample ) * step;
+		float gain = std::clamp( points.front().gain, 0.f, 1.f );
+		if ( distance > points.front().distance )
+		{
+			while ( segment + 2 < count && distance > points[segment + 1].distance )
+			{
+				++segment;
+			}
+			const float x0 = points[segment].distance;
+			const float width = points[segment + 1].distance - x0;
+			const float t = std::clamp( ( distance - x0 ) / width, 0.f, 1.f );
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			const float y0 = std::clamp( points[segment].gain, 0.f, 1.f );
+			const float y1 = std::clamp( points[segment + 1].gain, 0.f, 1.f );
+			gain = ( 2.f * t3 - 3.f * t2 + 1.f ) * y0 + ( t3 - 2.f * t2 + t ) * width * tangents[segment] +
+				   ( -2.f * t3 + 3.f * t2 ) * y1 + ( t3 - t2 ) * width * tangents[segment + 1];
+		}
+		curve->m_gains[sample] = std::clamp( gain, 0.f, 1.f );
+		curve->m_fmodPoints[sample] = { distance, curve->m_gains[sample], 0.f };
+	}
+	return curve;
+}
+
+float URolloffCurve::getGain( const float distance ) const
+{
+	// The same piecewise linear reading FMOD does of the custom rolloff.
+	const float position = distance * m_inverseStep;
+	if ( !( position > 0.f ) )
+	{
+		return m_gains.front();
+	}
+	if ( position >= float( TABLE_SIZE - 1 ) )
+	{
+		return m_gains.back();
+	}
+	const size_t index = size_t( position );
+	const float t = position - float( index );
+	return m_gains[index] + ( m_gains[index + 1] - m_gains[index] ) * t;
+}
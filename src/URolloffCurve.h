@@ -0,0 +1,50 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// URolloffCurve.h                                                           //
+// ========================================================================= //
+
+#ifndef U_ROLLOFF_CURVE_H_
+#define U_ROLLOFF_CURVE_H_
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <fmod/fmod.hpp>
+
+namespace univer::audio
+{
+// A distance rolloff authored as points, smoothed with a monotone cubic so it
+// never overshoots between them, and baked into TABLE_SIZE evenly spaced
+// samples. FMOD gets the samples as its custom rolloff and interpolates them
+// linearly, getGain does the same, so audibility estimates match the mixer.
+class URolloffCurve
+{
+public:
+	static constexpr size_t TABLE_SIZE = 64;
+
+	// Returns nullptr unless there are at least two points with increasing
+	// distances.
+	static std::shared_ptr< const URolloffCurve > bake( std::span< const URolloffPoint > points );
+
+	float getGain( const float distance ) const;
+	// Distance of the last point, past it the gain stays at the last value.
+	float getRange() const { return m_range; }
+	// FMOD reads the points in place, they must outlive every sound and
+	// channel using them.
+	FMOD_VECTOR* getFmodPoints() const { return const_cast< FMOD_VECTOR* >( m_fmodPoints.data() ); }
+	int getFmodPointCount() const { return int( m_fmodPoints.size() ); }
+
+private:
+	float m_range = 0.f;
+	float m_inverseStep = 0.f;
+	std::vector< float > m_gains;
+	std::vector< FMOD_VECTOR > m_fmodPoints;
+};
+}
+
+#endif // U_ROLLOFF_CURVE_H_
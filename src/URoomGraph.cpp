@@ -0,0 +1,303 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// URoomGraph.cpp                                                            //
+// ========================================================================= //
+
+#include "URoomGraph.h"
+#include "UAEImplementation.h"
+#include "UChannel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+using univer::audio::URoomGraph;
+using univer::audio::UChannel;
+
+namespace
+{
+float distance( const float a[3], const float b[3] )
+{
+	const float dx = a[0] - b[0];
+	const float dy = a[1] - b[1];
+	const float dz = a[2] - b[2];
+	return std::sqrt( dx * dx + dy * dy + dz * dz );
+}
+}
+
+URoomGraph::URoomGraph( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_wallTransmission( 0.0316f ),
+	m_listenerRoom( univer::audio::OUTSIDE_ROOM ),
+	m_isDirty( false ),
+	m_nextRoomId( 0 ),
+	m_nextPortalId( 0 )
+{}
+
+int URoomGraph::addRoom( const float vMin[3], const float vMax[3] )
+{
+	Room room;
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		if ( vMax[axis] < vMin[axis] )
+		{
+			return -1;
+		}
+		room.min[axis] = vMin[axis];
+		room.max[axis] = vMax[axis];
+	}
+	const int roomId = m_nextRoomId++;
+	m_rooms[roomId] = room;
+	m_isDirty = true;
+	return roomId;
+}
+
+void URoomGraph::removeRoom( const int roomId )
+{
+	if ( m_rooms.erase( roomId ) == 0 )
+	{
+		return;
+	}
+	// Portals need both sides, the ones of the room go with it.
+	for ( auto it = m_portals.begin(); it != m_portals.end(); )
+	{
+		if ( it->second.rooms[0] == roomId || it->second.rooms[1] == roomId )
+		{
+			it = m_portals.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+	}
+	m_isDirty = true;
+}
+
+int URoomGraph::addPortal( const int roomA, const int roomB, const float vPosition[3], const float openness )
+{
+	const bool validA = roomA == OUTSIDE_ROOM || m_rooms.count( roomA ) != 0;
+	const bool validB = roomB == OUTSIDE_ROOM || m_rooms.count( roomB ) != 0;
+	if ( !validA || !validB || roomA == roomB )
+	{
+		return -1;
+	}
+	const int portalId = m_nextPortalId++;
+	m_portals[portalId] = { { roomA, roomB }, { vPosition[0], vPosition[1], vPosition[2] }, std::clamp( openness, 0.f, 1.f ) };
+	m_isDirty = true;
+	return portalId;
+}
+
+void URoomGraph::removePortal( const int portalId )
+{
+	if ( m_portals.erase( portalId ) != 0 )
+	{
+		m_isDirty = true;
+	}
+}
+
+void URoomGraph::setPortalOpenness( const int portalId, const float openness )
+{
+	auto tPortalIt = m_portals.find( portalId );
+	if ( tPortalIt == m_portals.end() )
+	{
+		return;
+	}
+	const float clamped = std::clamp( openness, 0.f, 1.f );
+	if ( tPortalIt->second.openness != clamped )
+	{
+		tPortalIt->second.openness = clamped;
+		m_isDirty = true;
+	}
+}
+
+int URoomGraph::findRoom( const float vPosition[3], const int hintRoomId ) const
+{
+	auto contains = [&]( const Room& room )
+	{
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			if ( vPosition[axis] < room.min[axis] || vPosition[axis] > room.max[axis] )
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+	// Emitters rarely change room, so the last one is checked first.
+	auto tHintIt = m_rooms.find( hintRoomId );
+	if ( tHintIt != m_rooms.end() && contains( tHintIt->second ) )
+	{
+		return hintRoomId;
+	}
+	for ( const auto& [roomId, room] : m_rooms )
+	{
+		if ( contains( room ) )
+		{
+			return roomId;
+		}
+	}
+	return OUTSIDE_ROOM;
+}
+
+void URoomGraph::update( const std::vector< int >& channelIds )
+{
+	// An emptied graph still runs once so channels get their real position.
+	if ( !isEnabled() && !m_isDirty )
+	{
+		return;
+	}
+	const int listenerRoom = findRoom( m_implementation.listeners[0].position, m_listenerRoom );
+	if ( m_isDirty || listenerRoom != m_listenerRoom )
+	{
+		m_listenerRoom = listenerRoom;
+		rebuild();
+		m_isDirty = false;
+	}
+
+	for ( const int channelId : channelIds )
+	{
+		auto tChannelIt = m_implementation.channels.find( channelId );
+		if ( tChannelIt == m_implementation.channels.end() )
+		{
+			continue;
+		}
+		UChannel& channel = *tChannelIt->second;
+		if ( channel.m_isSpatial && channel.m_fmodChannel != nullptr )
+		{
+			propagate( channel );
+		}
+	}
+}
+
+void URoomGraph::rebuild()
+{
+	m_roomPortals.clear();
+	for ( const auto& [portalId, portal] : m_portals )
+	{
+		m_roomPortals[portal.rooms[0]].push_back( portalId );
+		m_roomPortals[portal.rooms[1]].push_back( portalId );
+	}
+	m_sources.clear();
+	for ( const int portalId : m_roomPortals[m_listenerRoom] )
+	{
+		if ( m_portals[portalId].openness > 0.f )
+		{
+			m_sources.push_back( { portalId, {}, {} } );
+			search( m_sources.back() );
+		}
+	}
+}
+
+void URoomGraph::search( Source& source ) const
+{
+	// Dijkstra over portals, two portals are linked when they share a room.
+	// Closed portals are not crossed, the gain of a path is the product of the
+	// openness of its portals.
+	using Item = std::pair< float, int >;
+	std::priority_queue< Item, std::vector< Item >, std::greater< Item > > queue;
+	source.distance[source.portalId] = 0.f;
+	source.gain[source.portalId] = m_portals.at( source.portalId ).openness;
+	queue.push( { 0.f, source.portalId } );
+	while ( !queue.empty() )
+	{
+		const auto [pathLength, portalId] = queue.top();
+		queue.pop();
+		if ( pathLength > source.distance[portalId] )
+		{
+			continue;
+		}
+		const Portal& portal = m_portals.at( portalId );
+		for ( const int roomId : portal.rooms )
+		{
+			auto tRoomIt = m_roomPortals.find( roomId );
+			if ( tRoomIt == m_roomPortals.end() )
+			{
+				continue;
+			}
+			for ( const int nextId : tRoomIt->second )
+			{
+				const Portal& next = m_portals.at( nextId );
+				if ( nextId == portalId || next.openness <= 0.f )
+				{
+					continue;
+				}
+				const float nextLength = pathLength + distance( portal.position, next.position );
+				auto tDistanceIt = source.distance.find( nextId );
+				if ( tDistanceIt != source.distance.end() && tDistanceIt->second <= nextLength )
+				{
+					continue;
+				}
+				source.distance[nextId] = nextLength;
+				source.gain[nextId] = source.gain[portalId] * next.openness;
+				queue.push( { nextLength, nextId } );
+			}
+		}
+	}
+}
+
+void URoomGraph::propagate( UChannel& channel ) const
+{
+	channel.m_roomId = findRoom( channel.m_position, channel.m_roomId );
+	if ( channel.m_roomId == m_listenerRoom )
+	{
+		channel.setPropagation( channel.m_position, 1.f );
+		return;
+	}
+
+	const float* listener = m_implementation.listeners[0].position;
+	float bestLength = std::numeric_limits< float >::max();
+	float bestGain = 0.f;
+	const float* firstPortal = nullptr;
+	auto tRoomIt = m_roomPortals.find( channel.m_roomId );
+	if ( tRoomIt != m_roomPortals.end() )
+	{
+		for ( const Source& source : m_sources )
+		{
+			const float* sourcePosition = m_portals.at( source.portalId ).position;
+			const float toSource = distance( listener, sourcePosition );
+			for ( const int portalId : tRoomIt->second )
+			{
+				auto tDistanceIt = source.distance.find( portalId );
+				if ( tDistanceIt == source.distance.end() )
+				{
+					continue;
+				}
+				const float length = toSource + tDistanceIt->second + distance( m_portals.at( portalId ).position, channel.m_position );
+				if ( length < bestLength )
+				{
+					bestLength = length;
+					bestGain = source.gain.at( portalId );
+					firstPortal = sourcePosition;
+				}
+			}
+		}
+	}
+	if ( firstPortal == nullptr )
+	{
+		channel.setPropagation( channel.m_position, m_wallTransmission );
+		return;
+	}
+
+	// The sound arrives from the first portal on the path, as far away as the
+	// whole path, so FMOD rolloff and panning stay right without changes.
+	float direction[3] = { firstPortal[0] - listener[0], firstPortal[1] - listener[1], firstPortal[2] - listener[2] };
+	float length = std::sqrt( direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2] );
+	if ( length < 1e-4f )
+	{
+		// Standing in the portal, the sound comes from the emitter side.
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			direction[axis] = channel.m_position[axis] - listener[axis];
+		}
+		length = std::max( std::sqrt( direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2] ), 1e-4f );
+	}
+	const float scale = bestLength / length;
+	const float apparent[3] = { listener[0] + direction[0] * scale,
+								listener[1] + direction[1] * scale,
+								listener[2] + direction[2] * scale };
+	channel.setPropagation( apparent, bestGain );
+}
@@ -0,0 +1,83 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// URoomGraph.h                                                              //
+// ========================================================================= //
+
+#ifndef U_ROOM_GRAPH_H_
+#define U_ROOM_GRAPH_H_
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace univer::audio
+{
+class UAEImplementation;
+struct UChannel;
+
+// Rooms connected by portals. Shortest paths from the portals of the
+// listener room to every other portal are cached and only searched again
+// when a portal changes or the listener enters another room. Per channel,
+// joining a cached path to the emitter is a handful of distance checks.
+class URoomGraph
+{
+public:
+	explicit URoomGraph( UAEImplementation& tImplementation );
+
+	int addRoom( const float vMin[3], const float vMax[3] );
+	void removeRoom( const int roomId );
+	int addPortal( const int roomA, const int roomB, const float vPosition[3], const float openness );
+	void removePortal( const int portalId );
+	void setPortalOpenness( const int portalId, const float openness );
+	void setWallTransmission( const float gain ) { m_wallTransmission = gain; }
+	bool isEnabled() const { return !m_rooms.empty(); }
+
+	// Moves the apparent position and propagation gain of the given channels.
+	void update( const std::vector< int >& channelIds );
+	// Same for one channel, such as a virtual one about to resume, which
+	// update skips.
+	void propagate( UChannel& channel ) const;
+
+	// OUTSIDE_ROOM when the point is in no room.
+	int findRoom( const float vPosition[3], const int hintRoomId ) const;
+
+private:
+	struct Room
+	{
+		float min[3];
+		float max[3];
+	};
+
+	struct Portal
+	{
+		int rooms[2];
+		float position[3];
+		float openness;
+	};
+
+	// Shortest paths from one portal of the listener room.
+	struct Source
+	{
+		int portalId;
+		std::unordered_map< int, float > distance;
+		std::unordered_map< int, float > gain;
+	};
+
+	void rebuild();
+	void search( Source& source ) const;
+
+	UAEImplementation& m_implementation;
+	std::map< int, Room > m_rooms;
+	std::map< int, Portal > m_portals;
+	std::unordered_map< int, std::vector< int > > m_roomPortals;
+	std::vector< Source > m_sources;
+	float m_wallTransmission;
+	int m_listenerRoom;
+	bool m_isDirty;
+	int m_nextRoomId;
+	int m_nextPortalId;
+};
+}
+
+#endif // U_ROOM_GRAPH_H_
@@ -6,8 +6,17 @@
 
 #include "USound.h"
 
+#include <algorithm>
+
 using univer::audio::USound;
 
+namespace
+{
+// A channel moving closer keeps its level until it is this much inside the
+// boundary.
+constexpr float LOD_HYSTERESIS = 0.9f;
+}
+
 USound::USound( const std::string& _name,
 				const float _defaultVolumeDB,
 				const float _minDistance,
@@ -24,6 +33,20 @@ USound::USound( const std::string& _name,
 	isLooping( _isLooping ),
 	isStreaming( _isStreaming ),
 	useBinaryData( _useBinaryData ),
+	priority( 128 ),
+	maxInstances( 0 ),
+	stealPolicy( UStealPolicy::OLDEST ),
+	clusterDistance( 0.f ),
+	clusterSize( 0.f ),
+	coalesceRadius( 0.f ),
+	retriggerCooldown( 0.f ),
+	busId( SFX_BUS ),
+	rolloff( nullptr ),
+	effectsLodDistance( 0.f ),
+	loudnessdB( 0.f ),
+	m_lastPlayTime( -1.0e9 ),
+	m_lengthMs( 0 ),
+	m_rolloff( nullptr ),
 	m_fmodSound( nullptr )
 {}
 
@@ -31,3 +54,30 @@ USound::~USound()
 {
 	m_fmodSound = nullptr;
 }
+
+::FMOD::Sound* USound::getLodSound( const int level ) const
+{
+	for ( int index = std::min( level, int( lods.size() ) ); index > 0; --index )
+	{
+		if ( lods[size_t( index - 1 )].fmodSound != nullptr )
+		{
+			return lods[size_t( index - 1 )].fmodSound;
+		}
+	}
+	return m_fmodSound;
+}
+
+int USound::selectLod( const float distance, const int currentLevel ) const
+{
+	int level = 0;
+	for ( size_t index = 0; index < lods.size(); ++index )
+	{
+		const bool isCurrentOrBelow = int( index ) < currentLevel;
+		const float threshold = lods[index].distance * ( isCurrentOrBelow ? LOD_HYSTERESIS : 1.f );
+		if ( distance >= threshold )
+		{
+			level = int( index ) + 1;
+		}
+	}
+	return level;
+}
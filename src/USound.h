@@ -7,7 +7,12 @@
 #ifndef U_SOUND_H_
 #define U_SOUND_H_
 
+#include <univer_audio/UAudioEngine.h>
+#include "URolloffCurve.h"
+
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include <fmod/fmod.hpp>
 
@@ -27,6 +32,20 @@ public:
 
 	~USound();
 
+	// An authored variant played from distance on, level 0 is the sound
+	// itself.
+	struct Lod
+	{
+		float distance;
+		std::string path;
+		::FMOD::Sound* fmodSound;
+	};
+
+	// The variant of the level, or of the closest lower level that is loaded.
+	::FMOD::Sound* getLodSound( const int level ) const;
+	// Hysteresis keeps a channel from switching back and forth at a boundary.
+	int selectLod( const float distance, const int currentLevel ) const;
+
 	std::string name;
 	float defaultVolumedB;
 	float minDistance;
@@ -35,6 +54,30 @@ public:
 	bool isLooping;
 	bool isStreaming;
 	bool useBinaryData;
+	int priority;
+	int maxInstances;
+	UStealPolicy stealPolicy;
+	float clusterDistance;
+	float clusterSize;
+	float coalesceRadius;
+	float retriggerCooldown;
+	int busId;
+	const URolloffCurve* rolloff;
+	// Sorted by distance.
+	std::vector< Lod > lods;
+	// Past this distance channels lose their per channel DSP, 0 disables it.
+	float effectsLodDistance;
+	// Added to the estimated level for the HDR window.
+	float loudnessdB;
+
+	double m_lastPlayTime;
+	unsigned int m_lengthMs;
+	// The rolloff in use, the own one or the one of the closest bus.
+	const URolloffCurve* m_rolloff;
+
+	// Data of an ADPCM sound kept compressed in memory, m_fmodSound and every
+	// channel stream read it in place.
+	std::vector< uint8_t > m_encoded;
 
 	::FMOD::Sound* m_fmodSound;
 };
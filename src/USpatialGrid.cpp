@@ -0,0 +1,204 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// USpatialGrid.cpp                                                          //
+// ========================================================================= //
+
+#include "USpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using univer::audio::USpatialGrid;
+
+namespace
+{
+constexpr int CELL_BITS = 21;
+constexpr int CELL_OFFSET = 1 << ( CELL_BITS - 1 );
+constexpr uint64_t CELL_MASK = ( uint64_t( 1 ) << CELL_BITS ) - 1;
+}
+
+USpatialGrid::USpatialGrid( const float cellSize ) :
+	m_cellSize( cellSize ),
+	m_inverseCellSize( 1.f / cellSize )
+{}
+
+void USpatialGrid::setCellSize( const float cellSize )
+{
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.f / cellSize;
+	m_cells.clear();
+	for ( auto& [id, entry] : m_entries )
+	{
+		addToCell( id, entry );
+	}
+}
+
+int USpatialGrid::toCell( const float coordinate ) const
+{
+	// Clamped as a float, converting a value out of the int range (or NaN) is
+	// undefined.
+	const float cell = std::floor( coordinate * m_inverseCellSize );
+	if ( !( cell > float( -CELL_OFFSET ) ) )
+	{
+		return -CELL_OFFSET;
+	}
+	if ( cell >= float( CELL_OFFSET - 1 ) )
+	{
+		return CELL_OFFSET - 1;
+	}
+	return static_cast< int >( cell );
+}
+
+uint64_t USpatialGrid::packCell( const int x, const int y, const int z )
+{
+	return ( uint64_t( x + CELL_OFFSET ) & CELL_MASK ) |
+		( ( uint64_t( y + CELL_OFFSET ) & CELL_MASK ) << CELL_BITS ) |
+		( ( uint64_t( z + CELL_OFFSET ) & CELL_MASK ) << ( 2 * CELL_BITS ) );
+}
+
+void USpatialGrid::addToCell( const int id, Entry& entry )
+{
+	entry.cell = packCell( toCell( entry.position[0] ), toCell( entry.position[1] ), toCell( entry.position[2] ) );
+	auto& ids = m_cells[entry.cell];
+	entry.index = static_cast< uint32_t >( ids.size() );
+	ids.push_back( id );
+}
+
+void USpatialGrid::removeFromCell( const Entry& entry )
+{
+	auto tCellIt = m_cells.find( entry.cell );
+	if ( tCellIt == m_cells.end() )
+	{
+		return;
+	}
+	auto& ids = tCellIt->second;
+	// Swap with the last id of the cell so removal stays O(1).
+	const int lastId = ids.back();
+	ids[entry.index] = lastId;
+	m_entries[lastId].index = entry.index;
+	ids.pop_back();
+	if ( ids.empty() )
+	{
+		m_cells.erase( tCellIt );
+	}
+}
+
+void USpatialGrid::insert( const int id, const float vPosition[3] )
+{
+	if ( m_entries.count( id ) != 0 )
+	{
+		move( id, vPosition );
+		return;
+	}
+	Entry& entry = m_entries[id];
+	std::copy( vPosition, vPosition + 3, entry.position );
+	addToCell( id, entry );
+}
+
+void USpatialGrid::move( const int id, const float vPosition[3] )
+{
+	auto tEntryIt = m_entries.find( id );
+	if ( tEntryIt == m_entries.end() )
+	{
+		return;
+	}
+	Entry& entry = tEntryIt->second;
+	std::copy( vPosition, vPosition + 3, entry.position );
+	const uint64_t cell = packCell( toCell( vPosition[0] ), toCell( vPosition[1] ), toCell( vPosition[2] ) );
+	if ( cell == entry.cell )
+	{
+		return;
+	}
+	removeFromCell( entry );
+	addToCell( id, entry );
+}
+
+void USpatialGrid::remove( const int id )
+{
+	auto tEntryIt = m_entries.find( id );
+	if ( tEntryIt == m_entries.end() )
+	{
+		return;
+	}
+	removeFromCell( tEntryIt->second );
+	m_entries.erase( tEntryIt );
+}
+
+void USpatialGrid::clear()
+{
+	m_cells.clear();
+	m_entries.clear();
+}
+
+void USpatialGrid::query( const float vCenter[3], const float radius, std::vector< int >& ids ) const
+{
+	const float radiusSquared = radius * radius;
+	auto testCell = [&]( const std::vector< int >& cellIds )
+	{
+		for ( const int id : cellIds )
+		{
+			const float* position = m_entries.at( id ).position;
+			const float dx = position[0] - vCenter[0];
+			const float dy = position[1] - vCenter[1];
+			const float dz = position[2] - vCenter[2];
+			if ( dx * dx + dy * dy + dz * dz <= radiusSquared )
+			{
+				ids.push_back( id );
+			}
+		}
+	};
+
+	int minCell[3];
+	int maxCell[3];
+	uint64_t cellCount = 1;
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		minCell[axis] = toCell( vCenter[axis] - radius );
+		maxCell[axis] = toCell( vCenter[axis] + radius );
+		cellCount *= uint64_t( maxCell[axis] - minCell[axis] + 1 );
+	}
+
+	// A sphere much larger than the cells would visit mostly empty cells, in
+	// that case walking the occupied cells is cheaper. Cells away from the
+	// sphere are still skipped without looking at their emitters.
+	if ( cellCount > m_cells.size() )
+	{
+		for ( const auto& [cell, cellIds] : m_cells )
+		{
+			float distanceSquared = 0.f;
+			bool outside = false;
+			for ( int axis = 0; axis < 3 && !outside; ++axis )
+			{
+				const int index = int( ( cell >> ( axis * CELL_BITS ) ) & CELL_MASK ) - CELL_OFFSET;
+				outside = index < minCell[axis] || index > maxCell[axis];
+				// The border cells also hold everything clamped into them, they
+				// have no bounds on the outer side.
+				const float low = index == -CELL_OFFSET ? vCenter[axis] : float( index ) * m_cellSize;
+				const float high = index == CELL_OFFSET - 1 ? vCenter[axis] : float( index + 1 ) * m_cellSize;
+				const float gap = std::max( { low - vCenter[axis], vCenter[axis] - high, 0.f } );
+				distanceSquared += gap * gap;
+			}
+			if ( !outside && distanceSquared <= radiusSquared )
+			{
+				testCell( cellIds );
+			}
+		}
+		return;
+	}
+
+	for ( int z = minCell[2]; z <= maxCell[2]; ++z )
+	{
+		for ( int y = minCell[1]; y <= maxCell[1]; ++y )
+		{
+			for ( int x = minCell[0]; x <= maxCell[0]; ++x )
+			{
+				auto tCellIt = m_cells.find( packCell( x, y, z ) );
+				if ( tCellIt != m_cells.end() )
+				{
+					testCell( tCellIt->second );
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,57 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// USpatialGrid.h                                                            //
+// ========================================================================= //
+
+#ifndef U_SPATIAL_GRID_H_
+#define U_SPATIAL_GRID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace univer::audio
+{
+// Sparse uniform grid over emitter positions. Only occupied cells are stored,
+// so moving an emitter inside its cell is free and a radius query only visits
+// the cells overlapping the query sphere.
+class USpatialGrid
+{
+public:
+	explicit USpatialGrid( const float cellSize );
+
+	void setCellSize( const float cellSize );
+	float getCellSize() const { return m_cellSize; }
+
+	void insert( const int id, const float vPosition[3] );
+	void move( const int id, const float vPosition[3] );
+	void remove( const int id );
+	void clear();
+	size_t size() const { return m_entries.size(); }
+
+	// Appends to ids every emitter within radius of the center.
+	void query( const float vCenter[3], const float radius, std::vector< int >& ids ) const;
+
+private:
+	struct Entry
+	{
+		uint64_t cell;
+		uint32_t index;
+		float position[3];
+	};
+
+	int toCell( const float coordinate ) const;
+	static uint64_t packCell( const int x, const int y, const int z );
+	void addToCell( const int id, Entry& entry );
+	void removeFromCell( const Entry& entry );
+
+	float m_cellSize;
+	float m_inverseCellSize;
+	std::unordered_map< uint64_t, std::vector< int > > m_cells;
+	std::unordered_map< int, Entry > m_entries;
+};
+}
+
+#endif // U_SPATIAL_GRID_H_
@@ -0,0 +1,271 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UVelocityTracker.cpp                                                      //
+// ========================================================================= //
+
+#include "UVelocityTracker.h"
+
+#include <algorithm>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#define U_VELOCITY_TRACKER_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define U_VELOCITY_TRACKER_SSE
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define U_VELOCITY_TRACKER_NEON
+#endif
+
+using univer::audio::UVelocityTracker;
+
+namespace
+{
+// Below 1 cm/s a channel that stopped moving is considered at rest.
+constexpr float SETTLED_SPEED_SQUARED = 1e-4f;
+}
+
+void UVelocityTracker::move( const int channelId, const float vFrom[3], const float vTo[3] )
+{
+	auto tFoundIt = m_indices.find( channelId );
+	size_t index = 0;
+	if ( tFoundIt != m_indices.end() )
+	{
+		index = tFoundIt->second;
+	}
+	else
+	{
+		index = m_owners.size();
+		m_indices[channelId] = index;
+		m_owners.push_back( channelId );
+		m_moved.push_back( 0 );
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			m_previous[axis].push_back( vFrom[axis] );
+			m_current[axis].push_back( vFrom[axis] );
+			m_velocity[axis].push_back( 0.f );
+		}
+	}
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		m_current[axis][index] = vTo[axis];
+	}
+	m_moved[index] = 1;
+}
+
+void UVelocityTracker::remove( const int channelId )
+{
+	auto tFoundIt = m_indices.find( channelId );
+	if ( tFoundIt != m_indices.end() )
+	{
+		removeAt( tFoundIt->second );
+	}
+}
+
+void UVelocityTracker::removeAt( const size_t index )
+{
+	const size_t last = m_owners.size() - 1;
+	m_indices.erase( m_owners[index] );
+	if ( index != last )
+	{
+		m_owners[index] = m_owners[last];
+		m_moved[index] = m_moved[last];
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			m_previous[axis][index] = m_previous[axis][last];
+			m_current[axis][index] = m_current[axis][last];
+			m_velocity[axis][index] = m_velocity[axis][last];
+		}
+		m_indices[m_owners[index]] = index;
+	}
+	m_owners.pop_back();
+	m_moved.pop_back();
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		m_previous[axis].pop_back();
+		m_current[axis].pop_back();
+		m_velocity[axis].pop_back();
+	}
+}
+
+const std::vector< UVelocityTracker::Motion >& UVelocityTracker::update( const float dt,
+																		  const float blend,
+																		  const float teleportSpeed,
+																		  const bool allowSimd )
+{
+	// Without elapsed time there is no velocity to derive, the last ones are
+	// reported as they are.
+	if ( dt > 0.f )
+	{
+		const float inverseDt = 1.f / dt;
+		const float teleportSpeedSquared = teleportSpeed * teleportSpeed;
+		const size_t processed = allowSimd ? deriveSimd( inverseDt, blend, teleportSpeedSquared ) : 0;
+		deriveScalar( processed, inverseDt, blend, teleportSpeedSquared );
+	}
+
+	const size_t count = m_owners.size();
+	m_motions.resize( count );
+	m_settled.clear();
+	for ( size_t i = 0; i < count; ++i )
+	{
+		float* velocity = m_motions[i].velocity;
+		m_motions[i].channelId = m_owners[i];
+		velocity[0] = m_velocity[0][i];
+		velocity[1] = m_velocity[1][i];
+		velocity[2] = m_velocity[2][i];
+		const float speedSquared = velocity[0] * velocity[0] + velocity[1] * velocity[1] + velocity[2] * velocity[2];
+		if ( m_moved[i] == 0 && speedSquared < SETTLED_SPEED_SQUARED )
+		{
+			velocity[0] = velocity[1] = velocity[2] = 0.f;
+			m_settled.push_back( i );
+		}
+		m_moved[i] = 0;
+	}
+	// Remove from the back so that moving the last slot never skips a channel.
+	for ( auto it = m_settled.rbegin(); it != m_settled.rend(); ++it )
+	{
+		removeAt( *it );
+	}
+	return m_motions;
+}
+
+void UVelocityTracker::derive( const float vFrom[3],
+							   const float vTo[3],
+							   const float dt,
+							   const float blend,
+							   const float teleportSpeed,
+							   float vVelocity[3] )
+{
+	if ( dt <= 0.f )
+	{
+		return;
+	}
+	float raw[3];
+	float speedSquared = 0.f;
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		raw[axis] = ( vTo[axis] - vFrom[axis] ) / dt;
+		speedSquared += raw[axis] * raw[axis];
+	}
+	const bool teleported = speedSquared > teleportSpeed * teleportSpeed;
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		vVelocity[axis] = teleported ? 0.f : vVelocity[axis] + ( raw[axis] - vVelocity[axis] ) * blend;
+	}
+}
+
+void UVelocityTracker::deriveScalar( const size_t begin, const float inverseDt, const float blend, const float teleportSpeedSquared )
+{
+	for ( size_t i = begin; i < m_owners.size(); ++i )
+	{
+		float raw[3];
+		float speedSquared = 0.f;
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			raw[axis] = ( m_current[axis][i] - m_previous[axis][i] ) * inverseDt;
+			speedSquared += raw[axis] * raw[axis];
+			m_previous[axis][i] = m_current[axis][i];
+		}
+		const bool teleported = speedSquared > teleportSpeedSquared;
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const float velocity = m_velocity[axis][i];
+			m_velocity[axis][i] = teleported ? 0.f : velocity + ( raw[axis] - velocity ) * blend;
+		}
+	}
+}
+
+size_t UVelocityTracker::deriveSimd( const float inverseDt, const float blend, const float teleportSpeedSquared )
+{
+	const size_t count = m_owners.size();
+	float* previous[3] = { m_previous[0].data(), m_previous[1].data(), m_previous[2].data() };
+	const float* current[3] = { m_current[0].data(), m_current[1].data(), m_current[2].data() };
+	float* velocity[3] = { m_velocity[0].data(), m_velocity[1].data(), m_velocity[2].data() };
+	size_t i = 0;
+
+#if defined( U_VELOCITY_TRACKER_AVX )
+	const __m256 vInverseDt = _mm256_set1_ps( inverseDt );
+	const __m256 vBlend = _mm256_set1_ps( blend );
+	const __m256 vLimit = _mm256_set1_ps( teleportSpeedSquared );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m256 raw[3];
+		__m256 speedSquared = _mm256_setzero_ps();
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const __m256 c = _mm256_loadu_ps( current[axis] + i );
+			raw[axis] = _mm256_mul_ps( _mm256_sub_ps( c, _mm256_loadu_ps( previous[axis] + i ) ), vInverseDt );
+			speedSquared = _mm256_add_ps( speedSquared, _mm256_mul_ps( raw[axis], raw[axis] ) );
+			_mm256_storeu_ps( previous[axis] + i, c );
+		}
+		// All ones where the speed is plausible, zero lanes reset on a jump.
+		const __m256 keep = _mm256_cmp_ps( speedSquared, vLimit, _CMP_LE_OQ );
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const __m256 v = _mm256_loadu_ps( velocity[axis] + i );
+			const __m256 smoothed = _mm256_add_ps( v, _mm256_mul_ps( _mm256_sub_ps( raw[axis], v ), vBlend ) );
+			_mm256_storeu_ps( velocity[axis] + i, _mm256_and_ps( smoothed, keep ) );
+		}
+	}
+#elif defined( U_VELOCITY_TRACKER_SSE )
+	const __m128 vInverseDt = _mm_set1_ps( inverseDt );
+	const __m128 vBlend = _mm_set1_ps( blend );
+	const __m128 vLimit = _mm_set1_ps( teleportSpeedSquared );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128 raw[3];
+		__m128 speedSquared = _mm_setzero_ps();
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const __m128 c = _mm_loadu_ps( current[axis] + i );
+			raw[axis] = _mm_mul_ps( _mm_sub_ps( c, _mm_loadu_ps( previous[axis] + i ) ), vInverseDt );
+			speedSquared = _mm_add_ps( speedSquared, _mm_mul_ps( raw[axis], raw[axis] ) );
+			_mm_storeu_ps( previous[axis] + i, c );
+		}
+		// All ones where the speed is plausible, zero lanes reset on a jump.
+		const __m128 keep = _mm_cmple_ps( speedSquared, vLimit );
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const __m128 v = _mm_loadu_ps( velocity[axis] + i );
+			const __m128 smoothed = _mm_add_ps( v, _mm_mul_ps( _mm_sub_ps( raw[axis], v ), vBlend ) );
+			_mm_storeu_ps( velocity[axis] + i, _mm_and_ps( smoothed, keep ) );
+		}
+	}
+#elif defined( U_VELOCITY_TRACKER_NEON )
+	const float32x4_t vInverseDt = vdupq_n_f32( inverseDt );
+	const float32x4_t vBlend = vdupq_n_f32( blend );
+	const float32x4_t vLimit = vdupq_n_f32( teleportSpeedSquared );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		float32x4_t raw[3];
+		float32x4_t speedSquared = vdupq_n_f32( 0.f );
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const float32x4_t c = vld1q_f32( current[axis] + i );
+			raw[axis] = vmulq_f32( vsubq_f32( c, vld1q_f32( previous[axis] + i ) ), vInverseDt );
+			speedSquared = vmlaq_f32( speedSquared, raw[axis], raw[axis] );
+			vst1q_f32( previous[axis] + i, c );
+		}
+		// All ones where the speed is plausible, zero lanes reset on a jump.
+		const uint32x4_t keep = vcleq_f32( speedSquared, vLimit );
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const float32x4_t v = vld1q_f32( velocity[axis] + i );
+			const float32x4_t smoothed = vmlaq_f32( v, vsubq_f32( raw[axis], v ), vBlend );
+			vst1q_f32( velocity[axis] + i, vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( smoothed ), keep ) ) );
+		}
+	}
+#else
+	( void ) inverseDt;
+	( void ) blend;
+	( void ) teleportSpeedSquared;
+	( void ) count;
+	( void ) previous;
+	( void ) current;
+	( void ) velocity;
+#endif
+
+	return i;
+}
@@ -0,0 +1,62 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UVelocityTracker.h                                                        //
+// ========================================================================= //
+
+#ifndef U_VELOCITY_TRACKER_H_
+#define U_VELOCITY_TRACKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace univer::audio
+{
+// Velocities of the moving channels, derived from their positions between
+// two updates. Like the fader bank the state is kept in contiguous arrays so
+// a single vectorized pass derives and smooths every velocity. A channel is
+// only tracked while it moves, once its velocity settles to zero it is
+// reported a last time and dropped.
+class UVelocityTracker
+{
+public:
+	struct Motion
+	{
+		int channelId;
+		float velocity[3];
+	};
+
+	// vFrom is where the channel was before this move, used when the channel
+	// is not tracked yet. Moving to the same position only asks for the
+	// channel to be reported on the next update.
+	void move( const int channelId, const float vFrom[3], const float vTo[3] );
+	void remove( const int channelId );
+	size_t size() const { return m_owners.size(); }
+
+	// Derives the velocities over dt and returns every tracked channel. Speeds
+	// above teleportSpeed are taken as a jump and reset the velocity to zero,
+	// blend is the exponential smoothing factor, 1 for none.
+	const std::vector< Motion >& update( const float dt, const float blend, const float teleportSpeed, const bool allowSimd = true );
+
+	// Velocity of a single point, for the listener.
+	static void derive( const float vFrom[3], const float vTo[3], const float dt, const float blend, const float teleportSpeed, float vVelocity[3] );
+
+private:
+	size_t deriveSimd( const float inverseDt, const float blend, const float teleportSpeedSquared );
+	void deriveScalar( const size_t begin, const float inverseDt, const float blend, const float teleportSpeedSquared );
+	void removeAt( const size_t index );
+
+	std::vector< float > m_previous[3];
+	std::vector< float > m_current[3];
+	std::vector< float > m_velocity[3];
+	std::vector< uint8_t > m_moved;
+	std::vector< int > m_owners;
+	std::unordered_map< int, size_t > m_indices;
+	std::vector< Motion > m_motions;
+	std::vector< size_t > m_settled;
+};
+}
+
+#endif // U_VELOCITY_TRACKER_H_
@@ -0,0 +1,227 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UVoiceManager.cpp                                                         //
+// ========================================================================= //
+
+#include "UVoiceManager.h"
+#include "UAEImplementation.h"
+#include "UChannel.h"
+#include "USound.h"
+
+#include <algorithm>
+
+using univer::audio::UVoiceManager;
+using univer::audio::UChannel;
+using univer::audio::USound;
+using univer::audio::UStealPolicy;
+
+UVoiceManager::UVoiceManager( UAEImplementation& tImplementation ) :
+	m_implementation( tImplementation ),
+	m_stealPolicy( UStealPolicy::OLDEST ),
+	m_maxVoices( 0 ),
+	m_voiceCount( 0 )
+{}
+
+bool UVoiceManager::isBetterVictim( const Candidate& a, const Candidate& b )
+{
+	if ( a.isStopping != b.isStopping )
+	{
+		return a.isStopping;
+	}
+	if ( a.priority != b.priority )
+	{
+		return a.priority > b.priority;
+	}
+	if ( a.score != b.score )
+	{
+		return a.score > b.score;
+	}
+	return a.channelId < b.channelId;
+}
+
+bool UVoiceManager::heapOrder( const Candidate& a, const Candidate& b )
+{
+	// std heaps keep the greatest element on top, so the comparison is flipped.
+	return isBetterVictim( b, a );
+}
+
+float UVoiceManager::computeScore( const UStealPolicy policy, const int channelId, const float vPosition[3], const float audibility ) const
+{
+	switch ( policy )
+	{
+		case UStealPolicy::QUIETEST:
+			return -audibility;
+		case UStealPolicy::FURTHEST:
+			return m_implementation.distanceToListenerSquared( vPosition );
+		case UStealPolicy::OLDEST:
+			[[fallthrough]];
+		case UStealPolicy::REJECT_NEW:
+			break;
+	}
+	// Channel ids grow monotonically, so the smallest one is the oldest voice.
+	return -static_cast< float >( channelId );
+}
+
+float UVoiceManager::computeScore( const UStealPolicy policy, const int channelId, const UChannel& channel ) const
+{
+	float audibility = 0.f;
+	if ( policy == UStealPolicy::QUIETEST )
+	{
+		audibility = channel.getAudibility();
+	}
+	return computeScore( policy, channelId, channel.m_position, audibility );
+}
+
+UVoiceManager::Candidate UVoiceManager::makeCandidate( const UChannel& channel ) const
+{
+	return { channel.m_channelId, channel.m_soundId, channel.m_priority, channel.m_voiceSerial,
+		computeScore( m_stealPolicy, channel.m_channelId, channel ), channel.m_stopRequested };
+}
+
+UChannel* UVoiceManager::findVoice( const Candidate& candidate ) const
+{
+	auto tFoundIt = m_implementation.channels.find( candidate.channelId );
+	if ( tFoundIt == m_implementation.channels.end() ||
+		 !tFoundIt->second->m_hasVoice ||
+		 tFoundIt->second->m_voiceSerial != candidate.serial )
+	{
+		return nullptr;
+	}
+	return tFoundIt->second.get();
+}
+
+bool UVoiceManager::requestVoice( const USound& sound, const int soundId, const bool canStealEqual )
+{
+	if ( sound.maxInstances > 0 )
+	{
+		auto tCountIt = m_instanceCounts.find( soundId );
+		if ( tCountIt != m_instanceCounts.end() && tCountIt->second >= sound.maxInstances &&
+			 ( !canStealEqual || !stealFromSound( sound, soundId ) ) )
+		{
+			return false;
+		}
+	}
+	if ( m_voiceCount >= m_maxVoices && !stealFromAll( sound.priority, canStealEqual ) )
+	{
+		return false;
+	}
+	return true;
+}
+
+bool UVoiceManager::stealFromSound( const USound& sound, const int soundId )
+{
+	// The per-sound limit is small, a scan of the heap storage is enough here.
+	// Voices already fading out are taken even when new ones are rejected.
+	const bool onlyStopping = sound.stealPolicy == UStealPolicy::REJECT_NEW;
+	UChannel* victim = nullptr;
+	Candidate best{ -1, soundId, 0, 0, 0.f, false };
+	for ( const Candidate& candidate : m_heap )
+	{
+		if ( candidate.soundId != soundId )
+		{
+			continue;
+		}
+		UChannel* channel = findVoice( candidate );
+		if ( channel == nullptr || ( onlyStopping && !channel->m_stopRequested ) )
+		{
+			continue;
+		}
+		Candidate current{ candidate.channelId, soundId, channel->m_priority, candidate.serial,
+			computeScore( sound.stealPolicy, candidate.channelId, *channel ), channel->m_stopRequested };
+		if ( victim == nullptr || isBetterVictim( current, best ) )
+		{
+			victim = channel;
+			best = current;
+		}
+	}
+	if ( victim == nullptr )
+	{
+		return false;
+	}
+	victim->evict();
+	return true;
+}
+
+bool UVoiceManager::stealFromAll( const int priority, const bool canStealEqual )
+{
+	while ( !m_heap.empty() )
+	{
+		const Candidate& top = m_heap.front();
+		UChannel* channel = findVoice( top );
+		if ( channel != nullptr )
+		{
+			if ( !top.isStopping && ( top.priority < priority ||
+				 ( top.priority == priority && ( !canStealEqual || m_stealPolicy == UStealPolicy::REJECT_NEW ) ) ) )
+			{
+				return false;
+			}
+			channel->evict();
+		}
+		std::pop_heap( m_heap.begin(), m_heap.end(), heapOrder );
+		m_heap.pop_back();
+		if ( channel != nullptr )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void UVoiceManager::addVoice( UChannel& channel )
+{
+	channel.m_hasVoice = true;
+	++channel.m_voiceSerial;
+	++m_voiceCount;
+	++m_instanceCounts[channel.m_soundId];
+
+	m_heap.push_back( makeCandidate( channel ) );
+	std::push_heap( m_heap.begin(), m_heap.end(), heapOrder );
+}
+
+void UVoiceManager::markStopping( UChannel& channel )
+{
+	if ( !channel.m_hasVoice )
+	{
+		return;
+	}
+	// A new serial leaves the entry pushed by addVoice stale, the heap does
+	// not have to be searched for it.
+	++channel.m_voiceSerial;
+	m_heap.push_back( makeCandidate( channel ) );
+	std::push_heap( m_heap.begin(), m_heap.end(), heapOrder );
+}
+
+void UVoiceManager::releaseVoice( UChannel& channel )
+{
+	if ( !channel.m_hasVoice )
+	{
+		return;
+	}
+	channel.m_hasVoice = false;
+	--m_voiceCount;
+	auto tCountIt = m_instanceCounts.find( channel.m_soundId );
+	if ( tCountIt != m_instanceCounts.end() && --tCountIt->second <= 0 )
+	{
+		m_instanceCounts.erase( tCountIt );
+	}
+}
+
+void UVoiceManager::update()
+{
+	// Scores such as audibility or distance change every frame, so the heap is
+	// rebuilt here instead of being kept sorted on every change. Every voice
+	// was pushed when it was added, so only the heap itself is walked and
+	// virtual channels are never visited.
+	size_t liveCount = 0;
+	for ( const Candidate& candidate : m_heap )
+	{
+		UChannel* channel = findVoice( candidate );
+		if ( channel != nullptr )
+		{
+			m_heap[liveCount++] = makeCandidate( *channel );
+		}
+	}
+	m_heap.resize( liveCount );
+	std::make_heap( m_heap.begin(), m_heap.end(), heapOrder );
+}
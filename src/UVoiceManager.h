@@ -0,0 +1,79 @@
+// ========================================================================= //
+// Copyright (c) 2023 Agustin Jesus Durand Diaz.                             //
+// This code is licensed under the Apache License 2.0.                       //
+// UVoiceManager.h                                                           //
+// ========================================================================= //
+
+#ifndef U_VOICE_MANAGER_H_
+#define U_VOICE_MANAGER_H_
+
+#include <univer_audio/UAudioEngine.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace univer::audio
+{
+class UAEImplementation;
+class USound;
+struct UChannel;
+
+// Keeps the number of live voices bounded and decides which one is dropped
+// when a new voice does not fit. The least important voice is kept on top of
+// a heap, which is rebuilt once per update and grows lazily in between.
+class UVoiceManager
+{
+public:
+	explicit UVoiceManager( UAEImplementation& tImplementation );
+
+	void setMaxVoices( const int maxVoices ) { m_maxVoices = maxVoices; }
+	int getMaxVoices() const { return m_maxVoices; }
+	void setStealPolicy( const UStealPolicy policy ) { m_stealPolicy = policy; }
+	int getVoiceCount() const { return m_voiceCount; }
+	int getFreeVoices() const { return std::max( m_maxVoices - m_voiceCount, 0 ); }
+	void reserve( const size_t count ) { m_heap.reserve( m_heap.size() + count ); }
+
+	// Makes room for a new voice of the given sound, evicting other voices if
+	// needed. Returns false when the new voice has to be rejected. Virtual
+	// channels coming back pass canStealEqual = false so that two loops of
+	// the same priority do not keep evicting each other.
+	bool requestVoice( const USound& sound, const int soundId, const bool canStealEqual = true );
+	void addVoice( UChannel& channel );
+	// Fading voices keep counting against the budget until their FMOD channel
+	// stops, but they are the first ones to be stolen.
+	void markStopping( UChannel& channel );
+	void releaseVoice( UChannel& channel );
+
+	void update();
+
+private:
+	struct Candidate
+	{
+		int channelId;
+		int soundId;
+		int priority;
+		unsigned int serial; // Tells apart voices a channel held and lost before.
+		float score; // Higher score means a better victim.
+		bool isStopping; // Fading out, stolen before any other voice.
+	};
+
+	static bool isBetterVictim( const Candidate& a, const Candidate& b );
+	static bool heapOrder( const Candidate& a, const Candidate& b );
+	float computeScore( const UStealPolicy policy, const int channelId, const float vPosition[3], const float audibility ) const;
+	float computeScore( const UStealPolicy policy, const int channelId, const UChannel& channel ) const;
+	Candidate makeCandidate( const UChannel& channel ) const;
+	UChannel* findVoice( const Candidate& candidate ) const;
+	bool stealFromSound( const USound& sound, const int soundId );
+	bool stealFromAll( const int priority, const bool canStealEqual );
+
+	UAEImplementation& m_implementation;
+	std::vector< Candidate > m_heap;
+	std::unordered_map< int, int > m_instanceCounts;
+	UStealPolicy m_stealPolicy;
+	int m_maxVoices;
+	int m_voiceCount;
+};
+}
+
+#endif // U_VOICE_MANAGER_H_